@@ -0,0 +1,200 @@
+/** @file AttitudeEstimator.cpp
+ *  @brief Implementation of the complementary, Mahony and Madgwick attitude filters.
+ */
+
+#include "AttitudeEstimator.h"
+
+#include <math.h>
+
+static const float DEG_TO_RAD = 0.0174532925f;
+static const float RAD_TO_DEG = 57.2957795f;
+
+AttitudeParams AttitudeParams::defaults() {
+    AttitudeParams p;
+    p.filter = ATTITUDE_MAHONY;
+    p.complementaryTau = 0.5f;
+    p.mahonyKp = 1.0f;
+    p.mahonyKi = 0.05f;
+    p.madgwickBeta = 0.1f;
+    return p;
+}
+
+AttitudeEstimator::AttitudeEstimator(const AttitudeParams &params) : params(params) {
+    reset();
+}
+
+void AttitudeEstimator::reset() {
+    initialized = false;
+    q[0] = 1.0f;
+    q[1] = q[2] = q[3] = 0.0f;
+    bias[0] = bias[1] = bias[2] = 0.0f;
+    pitch = 0.0f;
+    pitchRate = 0.0f;
+}
+
+void AttitudeEstimator::update(const InertialSample &sample, float dt) {
+    float gyro[3] = {sample.gyro[0] * DEG_TO_RAD, sample.gyro[1] * DEG_TO_RAD, sample.gyro[2] * DEG_TO_RAD};
+    if (!initialized) {
+        initialize(sample.accel);
+        pitchRate = gyro[1];
+        return;
+    }
+    switch (params.filter) {
+        case ATTITUDE_COMPLEMENTARY:
+            updateComplementary(gyro, sample.accel, dt);
+            break;
+        case ATTITUDE_MAHONY:
+            updateMahony(gyro, sample.accel, dt);
+            break;
+        case ATTITUDE_MADGWICK:
+            updateMadgwick(gyro, sample.accel, dt);
+            break;
+    }
+}
+
+float AttitudeEstimator::getPitch() const {
+    return pitch * RAD_TO_DEG;
+}
+
+float AttitudeEstimator::getPitchRate() const {
+    return pitchRate * RAD_TO_DEG;
+}
+
+const float *AttitudeEstimator::getQuaternion() const {
+    return q;
+}
+
+void AttitudeEstimator::initialize(const float accel[3]) {
+    float norm = sqrtf(accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2]);
+    if (norm <= 0.0f) {
+        return;
+    }
+    float ax = accel[0] / norm, ay = accel[1] / norm, az = accel[2] / norm;
+
+    // Shortest rotation taking the measured gravity direction onto the world z axis
+    if (az > -0.999999f) {
+        q[0] = 1.0f + az;
+        q[1] = ay;
+        q[2] = -ax;
+        q[3] = 0.0f;
+    } else {
+        q[0] = 0.0f;
+        q[1] = 1.0f;
+        q[2] = q[3] = 0.0f;
+    }
+    float qNorm = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) {
+        q[i] *= qNorm;
+    }
+    pitch = atan2f(-ax, az);
+    initialized = true;
+}
+
+void AttitudeEstimator::updateComplementary(const float gyro[3], const float accel[3], float dt) {
+    pitchRate = gyro[1];
+    float alpha = params.complementaryTau / (params.complementaryTau + dt);
+    float predicted = pitch + gyro[1] * dt;
+    if (accel[0] != 0.0f || accel[2] != 0.0f) {
+        pitch = alpha * predicted + (1.0f - alpha) * atan2f(-accel[0], accel[2]);
+    } else {
+        pitch = predicted;
+    }
+    q[0] = cosf(0.5f * pitch);
+    q[1] = 0.0f;
+    q[2] = sinf(0.5f * pitch);
+    q[3] = 0.0f;
+}
+
+void AttitudeEstimator::updateMahony(const float gyro[3], const float accel[3], float dt) {
+    float gx = gyro[0], gy = gyro[1], gz = gyro[2];
+    float norm = accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2];
+    if (norm > 0.0f) {
+        norm = 1.0f / sqrtf(norm);
+        float ax = accel[0] * norm, ay = accel[1] * norm, az = accel[2] * norm;
+
+        // Half the gravity direction predicted by the quaternion, and its error against the measurement
+        float halfVx = q[1] * q[3] - q[0] * q[2];
+        float halfVy = q[0] * q[1] + q[2] * q[3];
+        float halfVz = q[0] * q[0] - 0.5f + q[3] * q[3];
+        float halfEx = ay * halfVz - az * halfVy;
+        float halfEy = az * halfVx - ax * halfVz;
+        float halfEz = ax * halfVy - ay * halfVx;
+
+        if (params.mahonyKi > 0.0f) {
+            bias[0] += 2.0f * params.mahonyKi * halfEx * dt;
+            bias[1] += 2.0f * params.mahonyKi * halfEy * dt;
+            bias[2] += 2.0f * params.mahonyKi * halfEz * dt;
+        }
+        gx += bias[0] + 2.0f * params.mahonyKp * halfEx;
+        gy += bias[1] + 2.0f * params.mahonyKp * halfEy;
+        gz += bias[2] + 2.0f * params.mahonyKp * halfEz;
+    }
+    pitchRate = gyro[1] + bias[1];
+
+    gx *= 0.5f * dt;
+    gy *= 0.5f * dt;
+    gz *= 0.5f * dt;
+    float qa = q[0], qb = q[1], qc = q[2];
+    q[0] += -qb * gx - qc * gy - q[3] * gz;
+    q[1] += qa * gx + qc * gz - q[3] * gy;
+    q[2] += qa * gy - qb * gz + q[3] * gx;
+    q[3] += qa * gz + qb * gy - qc * gx;
+
+    float qNorm = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) {
+        q[i] *= qNorm;
+    }
+    pitchFromQuaternion();
+}
+
+void AttitudeEstimator::updateMadgwick(const float gyro[3], const float accel[3], float dt) {
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+
+    // Rate of change of the quaternion from the gyro
+    float dq0 = 0.5f * (-q1 * gyro[0] - q2 * gyro[1] - q3 * gyro[2]);
+    float dq1 = 0.5f * (q0 * gyro[0] + q2 * gyro[2] - q3 * gyro[1]);
+    float dq2 = 0.5f * (q0 * gyro[1] - q1 * gyro[2] + q3 * gyro[0]);
+    float dq3 = 0.5f * (q0 * gyro[2] + q1 * gyro[1] - q2 * gyro[0]);
+
+    float norm = accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2];
+    if (norm > 0.0f) {
+        norm = 1.0f / sqrtf(norm);
+        float ax = accel[0] * norm, ay = accel[1] * norm, az = accel[2] * norm;
+
+        // Gradient of the gravity direction error, the objective function's Jacobian times its value
+        float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+        float s0 = 4.0f * q0 * q2q2 + 2.0f * q2 * ax + 4.0f * q0 * q1q1 - 2.0f * q1 * ay;
+        float s1 = 4.0f * q1 * q3q3 - 2.0f * q3 * ax + 4.0f * q0q0 * q1 - 2.0f * q0 * ay - 4.0f * q1 +
+                   8.0f * q1 * q1q1 + 8.0f * q1 * q2q2 + 4.0f * q1 * az;
+        float s2 = 4.0f * q0q0 * q2 + 2.0f * q0 * ax + 4.0f * q2 * q3q3 - 2.0f * q3 * ay - 4.0f * q2 +
+                   8.0f * q2 * q1q1 + 8.0f * q2 * q2q2 + 4.0f * q2 * az;
+        float s3 = 4.0f * q1q1 * q3 - 2.0f * q1 * ax + 4.0f * q2q2 * q3 - 2.0f * q2 * ay;
+        float sNorm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if (sNorm > 0.0f) {
+            sNorm = params.madgwickBeta / sqrtf(sNorm);
+            dq0 -= sNorm * s0;
+            dq1 -= sNorm * s1;
+            dq2 -= sNorm * s2;
+            dq3 -= sNorm * s3;
+        }
+    }
+    pitchRate = gyro[1];
+
+    q0 += dq0 * dt;
+    q1 += dq1 * dt;
+    q2 += dq2 * dt;
+    q3 += dq3 * dt;
+    float qNorm = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q[0] = q0 * qNorm;
+    q[1] = q1 * qNorm;
+    q[2] = q2 * qNorm;
+    q[3] = q3 * qNorm;
+    pitchFromQuaternion();
+}
+
+void AttitudeEstimator::pitchFromQuaternion() {
+    // Gravity direction in sensor axes; pitch is its angle from z in the x-z plane, whatever the heading
+    float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+    float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+    pitch = atan2f(-vx, vz);
+}
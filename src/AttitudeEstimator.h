@@ -0,0 +1,129 @@
+/** @file AttitudeEstimator.h
+ *  @brief Pitch estimation from raw gyro and accelerometer samples.
+ */
+
+#ifndef ATTITUDE_ESTIMATOR_H
+#define ATTITUDE_ESTIMATOR_H
+
+#include <stdint.h>
+
+/**
+ *  @brief Attitude filter algorithms.
+ */
+enum AttitudeFilter {
+    ATTITUDE_COMPLEMENTARY,  /**< Integrated pitch rate blended with the accelerometer pitch. */
+    ATTITUDE_MAHONY,         /**< Quaternion with PI correction towards the measured gravity. */
+    ATTITUDE_MADGWICK        /**< Quaternion with gradient-descent correction towards the measured gravity. */
+};
+
+/**
+ *  @brief Tuning of the attitude estimator.
+ */
+struct AttitudeParams {
+    AttitudeFilter filter;      /**< Which algorithm to run. */
+    float complementaryTau;     /**< Complementary filter crossover time constant in s. */
+    float mahonyKp;             /**< Mahony proportional gain in rad/s per unit gravity error. */
+    float mahonyKi;             /**< Mahony integral gain, estimating the gyro bias. */
+    float madgwickBeta;         /**< Madgwick gradient step in rad/s. */
+
+    /**
+     *  @brief Gets parameters suited to a balancing robot sampled at 1 kHz.
+     */
+    static AttitudeParams defaults();
+};
+
+/**
+ *  @brief One raw inertial sample in robot axes.
+ *
+ *  The x axis points forward, the y axis is along the wheel axle, so
+ *  rotation about y is pitch, and the accelerometer reads +1 g along z when
+ *  the robot stands upright. IMU maps the sensor's axes onto these.
+ */
+typedef struct {
+    float gyro[3];   /**< Angular rate about x, y and z in degrees per second. */
+    float accel[3];  /**< Specific force along x, y and z in m/s^2, gravity included. */
+} InertialSample;
+
+/**
+ *  @class AttitudeEstimator
+ *  @brief Fuses raw gyro and accelerometer samples into pitch and pitch rate.
+ *
+ *  The gyro gives a low-latency, low-noise angle that drifts; the
+ *  accelerometer gives a drift-free angle that is noisy and disturbed by
+ *  the robot's own acceleration. Each filter trusts the gyro at short time
+ *  scales and the accelerometer at long ones. The quaternion filters track
+ *  the full attitude and take pitch from the estimated gravity direction,
+ *  so the result does not depend on heading and has no Euler singularity
+ *  while the robot is upright. update() takes a fixed number of operations
+ *  and does no allocation.
+ */
+class AttitudeEstimator {
+public:
+    /**
+     *  @brief Constructor for the AttitudeEstimator class.
+     *  @param params Tuning of the estimator.
+     */
+    AttitudeEstimator(const AttitudeParams &params = AttitudeParams::defaults());
+
+    /**
+     *  @brief Forgets the attitude; the next sample initializes it from the accelerometer.
+     */
+    void reset();
+
+    /**
+     *  @brief Adds one sample.
+     *  @param sample Raw gyro and accelerometer reading.
+     *  @param dt Time since the previous sample in s.
+     */
+    void update(const InertialSample &sample, float dt);
+
+    /**
+     *  @brief Gets the estimated pitch in degrees, rotation about the y axis.
+     */
+    float getPitch() const;
+
+    /**
+     *  @brief Gets the pitch rate in degrees per second, corrected for the estimated gyro bias.
+     */
+    float getPitchRate() const;
+
+    /**
+     *  @brief Gets the attitude quaternion w, x, y, z of the quaternion filters.
+     */
+    const float *getQuaternion() const;
+
+private:
+    AttitudeParams params;
+    bool initialized;
+    float q[4];          /**< Attitude quaternion w, x, y, z. */
+    float bias[3];       /**< Mahony integral term in rad/s. */
+    float pitch;         /**< Pitch in rad. */
+    float pitchRate;     /**< Pitch rate in rad/s. */
+
+    /**
+     *  @brief Sets the attitude from the gravity direction alone.
+     */
+    void initialize(const float accel[3]);
+
+    /**
+     *  @brief One step of the complementary filter.
+     */
+    void updateComplementary(const float gyro[3], const float accel[3], float dt);
+
+    /**
+     *  @brief One step of the Mahony filter.
+     */
+    void updateMahony(const float gyro[3], const float accel[3], float dt);
+
+    /**
+     *  @brief One step of the Madgwick filter.
+     */
+    void updateMadgwick(const float gyro[3], const float accel[3], float dt);
+
+    /**
+     *  @brief Takes pitch from the gravity direction of the quaternion.
+     */
+    void pitchFromQuaternion();
+};
+
+#endif
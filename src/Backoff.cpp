@@ -0,0 +1,48 @@
+/** @file Backoff.cpp
+ *  @brief Implementation of the retry scheduling.
+ */
+
+#include "Backoff.h"
+
+BackoffParams BackoffParams::defaults() {
+    BackoffParams p;
+    p.initialMicros = 500000;
+    p.maxMicros = 30000000;
+    p.multiplier = 2.0f;
+    p.jitter = 0.5f;
+    return p;
+}
+
+Backoff::Backoff(const BackoffParams &params, uint32_t seed) : params(params), random(seed ? seed : 1) {
+    reset();
+}
+
+void Backoff::reset() {
+    delay = 0.0f;
+    failures = 0;
+    nextAttempt = 0;
+}
+
+uint32_t Backoff::fail(int64_t now) {
+    delay = failures == 0 ? (float)params.initialMicros : delay * params.multiplier;
+    if (delay > (float)params.maxMicros) {
+        delay = (float)params.maxMicros;
+    }
+    failures++;
+
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    float unit = (float)(random >> 8) * (1.0f / 16777216.0f);
+    uint32_t wait = (uint32_t)(delay * (1.0f - params.jitter * unit));
+    nextAttempt = now + wait;
+    return wait;
+}
+
+bool Backoff::isDue(int64_t now) const {
+    return now >= nextAttempt;
+}
+
+uint32_t Backoff::getFailures() const {
+    return failures;
+}
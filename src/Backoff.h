@@ -0,0 +1,74 @@
+/** @file Backoff.h
+ *  @brief Retry scheduling with exponential backoff and jitter.
+ */
+
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+/**
+ *  @brief Delays between retries.
+ */
+struct BackoffParams {
+    uint32_t initialMicros;     /**< Delay after the first failure, in microseconds. */
+    uint32_t maxMicros;         /**< Longest delay, in microseconds. */
+    float multiplier;           /**< Growth of the delay with each further failure. */
+    float jitter;               /**< Fraction of each delay that is randomized, 0 to 1. */
+
+    /**
+     *  @brief Gets parameters for reconnecting to a WiFi network or MQTT broker: 0.5 s doubling to 30 s.
+     */
+    static BackoffParams defaults();
+};
+
+/**
+ *  @class Backoff
+ *  @brief Decides when a failed operation may be retried.
+ *
+ *  After each failure the delay grows by the multiplier up to the maximum,
+ *  and a random part of it (the jitter fraction) is drawn anew, so robots
+ *  that lost the same access point do not all retry at the same moment.
+ *  Nothing blocks: the caller polls isDue() from its own loop.
+ */
+class Backoff {
+public:
+    /**
+     *  @brief Constructor for the Backoff class; the first attempt is due at once.
+     *  @param params Delays between retries.
+     *  @param seed Seed of the jitter, nonzero; give each device its own.
+     */
+    Backoff(const BackoffParams &params = BackoffParams::defaults(), uint32_t seed = 1);
+
+    /**
+     *  @brief Forgets past failures after a success; the next attempt is due at once.
+     */
+    void reset();
+
+    /**
+     *  @brief Records a failed attempt and schedules the next one.
+     *  @param now Time of the failure, from nowMicros().
+     *  @return Delay until the next attempt, in microseconds.
+     */
+    uint32_t fail(int64_t now);
+
+    /**
+     *  @brief Checks if the next attempt may be made.
+     *  @param now Current time from nowMicros().
+     */
+    bool isDue(int64_t now) const;
+
+    /**
+     *  @brief Gets the number of failures since the last reset().
+     */
+    uint32_t getFailures() const;
+
+private:
+    BackoffParams params;
+    uint32_t random;            /**< Xorshift state of the jitter. */
+    float delay;                /**< Delay before jitter after the latest failure, in microseconds. */
+    uint32_t failures;
+    int64_t nextAttempt;        /**< Time from which the next attempt is due. */
+};
+
+#endif
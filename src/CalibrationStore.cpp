@@ -0,0 +1,89 @@
+#include "CalibrationStore.h"
+#include "Crc16.h"
+
+/** @brief NVS key of the profile blob. */
+static const char *const PROFILE_KEY = "bno055";
+
+/**
+ * @brief Constructor for the CalibrationStore class.
+ * @param name NVS namespace holding the profile.
+ */
+CalibrationStore::CalibrationStore(const char *name) : name(name) {}
+
+/**
+ * @brief Reads the stored profile.
+ * @param offsets Receives the offsets if a valid profile exists.
+ * @return True if a valid profile was read.
+ */
+bool CalibrationStore::load(adafruit_bno055_offsets_t &offsets)
+{
+    Record record;
+    if (!preferences.begin(name, true)) {
+        return false;
+    }
+    bool read = preferences.getBytesLength(PROFILE_KEY) == sizeof(record) &&
+                preferences.getBytes(PROFILE_KEY, &record, sizeof(record)) == sizeof(record);
+    preferences.end();
+
+    if (!read || record.magic != MAGIC || record.version != VERSION ||
+        record.crc != crc16(&record.offsets, sizeof(record.offsets)) || !isPlausible(record.offsets)) {
+        return false;
+    }
+    offsets = record.offsets;
+    return true;
+}
+
+/**
+ * @brief Replaces the stored profile.
+ * @param offsets Offsets read from a fully calibrated sensor.
+ * @return True if the profile was written.
+ */
+bool CalibrationStore::save(const adafruit_bno055_offsets_t &offsets)
+{
+    if (!isPlausible(offsets)) {
+        return false;
+    }
+    Record record;
+    record.magic = MAGIC;
+    record.version = VERSION;
+    record.offsets = offsets;
+    record.crc = crc16(&record.offsets, sizeof(record.offsets));
+
+    if (!preferences.begin(name, false)) {
+        return false;
+    }
+    bool written = preferences.putBytes(PROFILE_KEY, &record, sizeof(record)) == sizeof(record);
+    preferences.end();
+    return written;
+}
+
+/**
+ * @brief Deletes the stored profile.
+ */
+void CalibrationStore::clear()
+{
+    if (preferences.begin(name, false)) {
+        preferences.remove(PROFILE_KEY);
+        preferences.end();
+    }
+}
+
+/**
+ * @brief Checks offsets against the ranges of the BNO055 offset registers.
+ * @param offsets Offsets to check.
+ * @return True if every offset and radius is in range.
+ */
+bool CalibrationStore::isPlausible(const adafruit_bno055_offsets_t &offsets)
+{
+    // Register ranges at the default sensor configuration (datasheet section 3.6.4)
+    const int16_t accel[3] = {offsets.accel_offset_x, offsets.accel_offset_y, offsets.accel_offset_z};
+    const int16_t mag[3] = {offsets.mag_offset_x, offsets.mag_offset_y, offsets.mag_offset_z};
+    const int16_t gyro[3] = {offsets.gyro_offset_x, offsets.gyro_offset_y, offsets.gyro_offset_z};
+    for (int i = 0; i < 3; i++) {
+        if (abs(accel[i]) > 4000 || abs(mag[i]) > 6400 || abs(gyro[i]) > 2000) {
+            return false;
+        }
+    }
+    return offsets.accel_radius > 0 && offsets.accel_radius <= 1000 &&
+           offsets.mag_radius > 0 && offsets.mag_radius <= 960;
+}
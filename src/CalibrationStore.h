@@ -0,0 +1,71 @@
+#ifndef CALIBRATION_STORE_H
+#define CALIBRATION_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <Adafruit_BNO055.h>
+
+/**
+ * @class CalibrationStore
+ * @brief Keeps a BNO055 calibration profile in the ESP32's NVS flash.
+ *
+ * The profile is stored as one blob with a magic number, a format version
+ * and a CRC-16 over the offsets, so a profile from an older firmware, a
+ * partial write or a corrupted flash page is rejected instead of being
+ * loaded into the sensor. The offsets themselves must also lie within the
+ * ranges the BNO055 datasheet allows.
+ */
+class CalibrationStore
+{
+public:
+    /**
+     * @brief Constructor for the CalibrationStore class.
+     * @param name NVS namespace holding the profile.
+     */
+    CalibrationStore(const char *name = "imu");
+
+    /**
+     * @brief Reads the stored profile.
+     * @param offsets Receives the offsets if a valid profile exists.
+     * @return True if a valid profile was read.
+     */
+    bool load(adafruit_bno055_offsets_t &offsets);
+
+    /**
+     * @brief Replaces the stored profile.
+     * @param offsets Offsets read from a fully calibrated sensor.
+     * @return True if the profile was written.
+     */
+    bool save(const adafruit_bno055_offsets_t &offsets);
+
+    /**
+     * @brief Deletes the stored profile.
+     */
+    void clear();
+
+    /**
+     * @brief Checks offsets against the ranges of the BNO055 offset registers.
+     * @param offsets Offsets to check.
+     * @return True if every offset and radius is in range.
+     */
+    static bool isPlausible(const adafruit_bno055_offsets_t &offsets);
+
+private:
+    static const uint32_t MAGIC = 0x42434C31;  /**< "BCL1", marks a ConeBot calibration blob. */
+    static const uint16_t VERSION = 1;         /**< Layout version of the blob. */
+
+    /**
+     * @brief Stored layout of a profile.
+     */
+    typedef struct {
+        uint32_t magic;                        /**< Always MAGIC. */
+        uint16_t version;                      /**< Always VERSION. */
+        uint16_t crc;                          /**< CRC-16 of offsets. */
+        adafruit_bno055_offsets_t offsets;     /**< The calibration offsets. */
+    } Record;
+
+    const char *name;         /**< NVS namespace. */
+    Preferences preferences;  /**< NVS handle, opened per access. */
+};
+
+#endif
@@ -0,0 +1,183 @@
+/** @file Command.cpp
+ *  @brief Implementation of the command parsing.
+ */
+
+#include "Command.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "ConeBot.h"
+
+struct Cursor {
+    const uint8_t *p;
+    const uint8_t *end;
+};
+
+struct Name {
+    const char *text;
+    uint8_t value;
+};
+
+struct Route {
+    const char *topic;
+    bool (*parse)(Cursor &cursor, Command &command);
+};
+
+static const Name STATE_NAMES[] = {
+    {"idle", IDLE},
+    {"balance", CORRECTING_TILT},
+    {"forward", MOVING_FORWARD},
+    {"backward", MOVING_BACKWARD},
+    {"stop", STOPPED},
+};
+
+static const Name LOG_ACTIONS[] = {
+    {"upload", COMMAND_UPLOAD_LOG},
+};
+
+static const Name STAGE_NAMES[] = {
+    {"position", GAIN_POSITION},
+    {"pitch", GAIN_PITCH},
+    {"rate", GAIN_RATE},
+    {"lqr", GAIN_LQR},
+};
+
+// Largest accepted position setpoint in m, well beyond anywhere the robot can go on one charge
+static const float MAX_POSITION_SETPOINT = 1000.0f;
+
+static bool nextToken(Cursor &cursor, const uint8_t *&start, size_t &length) {
+    while (cursor.p < cursor.end && (*cursor.p == ' ' || *cursor.p == '\t' || *cursor.p == '\r' || *cursor.p == '\n')) {
+        cursor.p++;
+    }
+    start = cursor.p;
+    while (cursor.p < cursor.end && *cursor.p != ' ' && *cursor.p != '\t' && *cursor.p != '\r' && *cursor.p != '\n') {
+        cursor.p++;
+    }
+    length = cursor.p - start;
+    return length > 0;
+}
+
+static bool atEnd(Cursor &cursor) {
+    const uint8_t *start;
+    size_t length;
+    return !nextToken(cursor, start, length);
+}
+
+template <size_t N>
+static bool parseName(Cursor &cursor, const Name (&names)[N], uint8_t &value) {
+    const uint8_t *start;
+    size_t length;
+    if (!nextToken(cursor, start, length)) {
+        return false;
+    }
+    for (size_t i = 0; i < N; i++) {
+        if (strlen(names[i].text) == length && memcmp(names[i].text, start, length) == 0) {
+            value = names[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decimal number with optional sign, fraction and exponent; strtof needs a NUL-terminated copy
+static bool parseNumber(Cursor &cursor, float &value) {
+    const uint8_t *p, *end;
+    size_t length;
+    if (!nextToken(cursor, p, length)) {
+        return false;
+    }
+    end = p + length;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') {
+        p++;
+    }
+    double mantissa = 0.0;
+    int digits = 0, exponent = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        mantissa = mantissa * 10.0 + (*p - '0');
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            mantissa = mantissa * 10.0 + (*p - '0');
+            exponent--;
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) {
+            p++;
+        }
+        int power = 0, powerDigits = 0;
+        for (; p < end && *p >= '0' && *p <= '9' && power < 100; p++, powerDigits++) {
+            power = power * 10 + (*p - '0');
+        }
+        if (powerDigits == 0) {
+            return false;
+        }
+        exponent += negativeExponent ? -power : power;
+    }
+    if (p != end) {
+        return false;
+    }
+    value = (float)(mantissa * pow(10.0, exponent));
+    if (negative) {
+        value = -value;
+    }
+    return isfinite(value);
+}
+
+static bool parseState(Cursor &cursor, Command &command) {
+    command.type = COMMAND_SET_STATE;
+    return parseName(cursor, STATE_NAMES, command.state) && atEnd(cursor);
+}
+
+static bool parsePosition(Cursor &cursor, Command &command) {
+    command.type = COMMAND_SET_POSITION;
+    return parseNumber(cursor, command.values[0]) && fabsf(command.values[0]) <= MAX_POSITION_SETPOINT &&
+           atEnd(cursor);
+}
+
+static bool parseGains(Cursor &cursor, Command &command) {
+    command.type = COMMAND_SET_GAINS;
+    if (!parseName(cursor, STAGE_NAMES, command.stage)) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (!parseNumber(cursor, command.values[i])) {
+            return false;
+        }
+    }
+    if (command.stage != GAIN_LQR &&
+        (command.values[0] < 0.0f || command.values[1] < 0.0f || command.values[2] < 0.0f || command.values[3] <= 0.0f)) {
+        return false;
+    }
+    return atEnd(cursor);
+}
+
+static bool parseLog(Cursor &cursor, Command &command) {
+    return parseName(cursor, LOG_ACTIONS, command.type) && atEnd(cursor);
+}
+
+static const Route ROUTES[] = {
+    {"bot/cmd/state", parseState},
+    {"bot/cmd/position", parsePosition},
+    {"bot/cmd/gains", parseGains},
+    {"bot/cmd/log", parseLog},
+};
+
+bool parseCommand(const char *topic, const uint8_t *payload, size_t length, int64_t receivedAt, Command &command) {
+    for (const Route &route : ROUTES) {
+        if (strcmp(route.topic, topic) == 0) {
+            Cursor cursor = {payload, payload + length};
+            command = Command();
+            command.receivedAt = receivedAt;
+            return route.parse(cursor, command);
+        }
+    }
+    return false;
+}
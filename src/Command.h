@@ -0,0 +1,71 @@
+/** @file Command.h
+ *  @brief Remote commands: the MQTT topics they arrive on, and their parsing and validation.
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief MQTT subscription filter covering every command topic. */
+static const char COMMAND_TOPIC_FILTER[] = "bot/cmd/#";
+
+/**
+ *  @brief Kinds of command.
+ */
+enum CommandType {
+    COMMAND_SET_STATE,      /**< Switch the motor control FSM to Command::state. */
+    COMMAND_SET_POSITION,   /**< Move the balance position setpoint to Command::values[0], in m. */
+    COMMAND_SET_GAINS,      /**< Replace the gains of the balance stage Command::stage with Command::values. */
+    COMMAND_UPLOAD_LOG      /**< Publish the closed flight log files to "bot/log"; handled by the MQTT task, not queued. */
+};
+
+/**
+ *  @brief Balance controller stages whose gains a COMMAND_SET_GAINS replaces.
+ */
+enum GainStage {
+    GAIN_POSITION,          /**< BalanceGains::position as kp, ki, kd, outputLimit. */
+    GAIN_PITCH,             /**< BalanceGains::pitch as kp, ki, kd, outputLimit. */
+    GAIN_RATE,              /**< BalanceGains::rate as kp, ki, kd, outputLimit. */
+    GAIN_LQR                /**< BalanceGains::lqr. */
+};
+
+/**
+ *  @brief One validated command, as queued for the motor control loop.
+ */
+typedef struct {
+    uint8_t type;           /**< CommandType. */
+    uint8_t state;          /**< ConeBotState for COMMAND_SET_STATE. */
+    uint8_t stage;          /**< GainStage for COMMAND_SET_GAINS. */
+    float values[4];        /**< Arguments of COMMAND_SET_POSITION and COMMAND_SET_GAINS. */
+    int64_t receivedAt;     /**< Time the message was parsed, from nowMicros(). */
+} Command;
+
+/**
+ *  @brief Parses and validates a command message.
+ *
+ *  The topic is looked up in a fixed table, and the payload is parsed
+ *  where it lies, without copying it or allocating. Payloads are ASCII
+ *  words and decimal numbers separated by spaces:
+ *
+ *  | Topic            | Payload                                   |
+ *  |------------------|-------------------------------------------|
+ *  | bot/cmd/state    | idle, balance, forward, backward or stop  |
+ *  | bot/cmd/position | position setpoint in m                    |
+ *  | bot/cmd/gains    | position, pitch or rate, then kp ki kd limit; or lqr, then four gains |
+ *  | bot/cmd/log      | upload                                    |
+ *
+ *  Numbers must be finite; PID gains must not be negative and limits must
+ *  be positive.
+ *
+ *  @param topic NUL-terminated topic the message arrived on.
+ *  @param payload Message bytes, not NUL-terminated.
+ *  @param length Number of bytes in @p payload.
+ *  @param receivedAt Current time from nowMicros().
+ *  @param command Receives the command.
+ *  @return True if @p command holds a valid command.
+ */
+bool parseCommand(const char *topic, const uint8_t *payload, size_t length, int64_t receivedAt, Command &command);
+
+#endif
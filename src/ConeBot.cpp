@@ -0,0 +1,725 @@
+/** @file ConeBot.cpp
+ *  @brief Implementation of the ConeBot control, measurement and telemetry steps.
+ */
+
+#include "ConeBot.h"
+
+#include <math.h>
+#include <stdio.h>
+
+const BalanceGains DEFAULT_BALANCE_GAINS = {
+    BALANCE_CASCADED,
+    {5.3f, 0.0f, 11.8f, 10.0f},       // position (m) -> pitch setpoint (deg)
+    {44.0f, 0.2f, 0.0f, 300.0f},      // pitch (deg) -> pitch rate setpoint (deg/s)
+    {0.59f, 0.0f, 0.0f, 255.0f},      // pitch rate (deg/s) -> motor command
+    0.93f,
+    {137.0f, 306.0f, 26.0f, 0.6f},   // state feedback, equivalent to the cascade above
+    255.0f,
+};
+
+/**
+ * @brief Gets the short name of an FSM state, as used in commands and reports.
+ *
+ * @param state FSM state.
+ * @return The name, or "?" for a value that is not a state.
+ */
+const char *getStateName(uint8_t state) {
+    static const char *const NAMES[CONEBOT_STATE_COUNT] = {
+        "idle", "balance", "forward", "backward", "avoid", "stop",
+    };
+    return state < CONEBOT_STATE_COUNT ? NAMES[state] : "?";
+}
+
+/**
+ * @brief Constructor for the ConeBotFsm class.
+ *
+ * @param initial State before the first cycle.
+ * @param publishInterval Cycles between snapshots for other tasks.
+ */
+ConeBotFsm::ConeBotFsm(ConeBotState initial, uint32_t publishInterval)
+    : state(initial), requested(initial), hasRequest(false), resumeState(MOVING_FORWARD), enteredAt(0), lastTick(0),
+      started(false), publishInterval(publishInterval > 0 ? publishInterval : 1), cycles(0), stats() {
+    snapshot.put(stats);
+}
+
+/**
+ * @brief Gets the current state.
+ */
+ConeBotState ConeBotFsm::getState() const {
+    return state;
+}
+
+/**
+ * @brief Asks for a state, entered in the next cycle if a commanded transition allows it.
+ *
+ * @param target State to enter.
+ */
+void ConeBotFsm::request(ConeBotState target) {
+    requested = target;
+    hasRequest = true;
+}
+
+/**
+ * @brief Takes the state asked for since the previous cycle.
+ *
+ * @param target Receives the state.
+ * @return False if no state was asked for.
+ */
+bool ConeBotFsm::takeRequest(ConeBotState &target) {
+    if (!hasRequest) {
+        return false;
+    }
+    target = requested;
+    hasRequest = false;
+    return true;
+}
+
+/**
+ * @brief Counts a request no transition allowed.
+ */
+void ConeBotFsm::rejectRequest() {
+    stats.rejectedRequests++;
+}
+
+/**
+ * @brief Adds the time since the previous cycle to the current state, at the start of each cycle.
+ *
+ * @param now Time of the cycle.
+ */
+void ConeBotFsm::tick(int64_t now) {
+    if (started) {
+        stats.dwellMicros[state] += now - lastTick;
+    } else {
+        enteredAt = now;
+        started = true;
+    }
+    lastTick = now;
+    if (++cycles >= publishInterval) {
+        cycles = 0;
+        snapshot.put(stats);
+    }
+}
+
+/**
+ * @brief Changes the state and counts the transition; the caller runs the exit and entry actions.
+ *
+ * @param next State entered.
+ * @param now Time of the cycle, passed to tick() before.
+ */
+void ConeBotFsm::enter(ConeBotState next, int64_t now) {
+    stats.transitions[state][next]++;
+    state = next;
+    enteredAt = now;
+    snapshot.put(stats);
+}
+
+/**
+ * @brief Gets the time spent in the current state since it was entered.
+ *
+ * @param now Time of the cycle.
+ */
+int64_t ConeBotFsm::getTimeInState(int64_t now) const {
+    return now - enteredAt;
+}
+
+/**
+ * @brief Gets the moving state AVOIDING_OBSTACLE returns to once the way is clear.
+ */
+ConeBotState ConeBotFsm::getResumeState() const {
+    return resumeState;
+}
+
+/**
+ * @brief Sets the moving state AVOIDING_OBSTACLE returns to, by its entry action.
+ *
+ * @param state MOVING_FORWARD or MOVING_BACKWARD.
+ */
+void ConeBotFsm::setResumeState(ConeBotState state) {
+    resumeState = state;
+}
+
+/**
+ * @brief Gets the statistics as of the latest snapshot; safe to call from any task.
+ */
+FsmStats ConeBotFsm::getStats() const {
+    return snapshot.get();
+}
+
+/**
+ * @brief Inputs of the FSM guards and actions in one cycle.
+ */
+struct FsmContext {
+    ConeBotFsm &fsm;                /**< FSM being stepped. */
+    ConeBotController &controller;  /**< Balance controller. */
+    const Measurement &measurement; /**< Measurement read from the sensor bus for the cycle. */
+    bool obstacleDetected;          /**< Obstacle flag read from the sensor bus for the cycle. */
+    int64_t now;                    /**< Time of the cycle. */
+};
+
+/** @brief Condition a transition is taken on, or NULL for always. */
+typedef bool (*FsmGuard)(const FsmContext &context);
+
+/** @brief Entry or exit action, passed the state left or entered. */
+typedef void (*FsmAction)(FsmContext &context, ConeBotState other);
+
+/** @brief Action of a state in every cycle, setting the wheel speeds; NULL lets the motors coast. */
+typedef void (*FsmActivity)(FsmContext &context, WheelSetpoint &setpoint);
+
+/**
+ * @brief Actions of one state, NULL for none.
+ */
+struct FsmStateActions {
+    FsmAction entry;        /**< Run when the state is entered, passed the state left. */
+    FsmAction exit;         /**< Run when the state is left, passed the state entered. */
+    FsmActivity activity;   /**< Run in every cycle spent in the state, after the transitions. */
+};
+
+/** @brief FsmTransition::from matching every state. */
+static const uint8_t ANY_STATE = 0xFF;
+
+/**
+ * @brief One row of the transition table.
+ */
+struct FsmTransition {
+    uint8_t from;       /**< State the transition leaves, or ANY_STATE. */
+    ConeBotState to;    /**< State the transition enters. */
+    bool commanded;     /**< Taken when a command asks for @p to, rather than checked in every cycle. */
+    FsmGuard guard;     /**< Condition on the sensor bus inputs, or NULL for always. */
+};
+
+static bool isUpright(const FsmContext &context) {
+    const Measurement &measurement = context.measurement;
+    return measurement.imuTimestamp != 0 && context.now - measurement.imuTimestamp <= MAX_IMU_AGE_US &&
+           fabsf(measurement.angle) <= FALL_ANGLE_DEG;
+}
+
+static bool cannotBalance(const FsmContext &context) {
+    // Fallen over, or the pitch is too old to tell
+    return !isUpright(context);
+}
+
+static bool isBlocked(const FsmContext &context) {
+    return context.obstacleDetected;
+}
+
+static bool isClear(const FsmContext &context) {
+    return !context.obstacleDetected;
+}
+
+static bool isTurnedClear(const FsmContext &context) {
+    return !context.obstacleDetected && context.fsm.getTimeInState(context.now) >= AVOID_MIN_TURN_US;
+}
+
+static bool canResumeForward(const FsmContext &context) {
+    return context.fsm.getResumeState() == MOVING_FORWARD && isTurnedClear(context);
+}
+
+static bool canResumeBackward(const FsmContext &context) {
+    return context.fsm.getResumeState() == MOVING_BACKWARD && isTurnedClear(context);
+}
+
+static void stopBalancing(FsmContext &context, ConeBotState) {
+    // Also clears the controller for the next time balancing starts, as configure() does
+    context.controller.reset();
+}
+
+static void rememberMove(FsmContext &context, ConeBotState previous) {
+    context.fsm.setResumeState(previous);
+}
+
+static void balance(FsmContext &context, WheelSetpoint &setpoint) {
+    const Measurement &measurement = context.measurement;
+    float command = (float)context.controller.step(ControlScalar(measurement.position),
+                                                   ControlScalar(measurement.velocity),
+                                                   ControlScalar(measurement.angle),
+                                                   ControlScalar(measurement.angularVelocity));
+    setpoint.driving = true;
+    setpoint.left = setpoint.right = command * (MAX_WHEEL_SPEED_MPS / FULL_SPEED_COMMAND);
+}
+
+static void driveForward(FsmContext &, WheelSetpoint &setpoint) {
+    setpoint.driving = true;
+    setpoint.left = setpoint.right = MAX_WHEEL_SPEED_MPS;
+}
+
+static void driveBackward(FsmContext &, WheelSetpoint &setpoint) {
+    setpoint.driving = true;
+    setpoint.left = setpoint.right = -MAX_WHEEL_SPEED_MPS;
+}
+
+static void turnAside(FsmContext &, WheelSetpoint &setpoint) {
+    setpoint.driving = true;
+    setpoint.left = -AVOID_TURN_SPEED_MPS;
+    setpoint.right = AVOID_TURN_SPEED_MPS;
+}
+
+/** @brief Actions of each state, indexed by ConeBotState. */
+static constexpr FsmStateActions STATE_ACTIONS[] = {
+    {NULL, NULL, NULL},                 // IDLE
+    {NULL, stopBalancing, balance},     // CORRECTING_TILT
+    {NULL, NULL, driveForward},         // MOVING_FORWARD
+    {NULL, NULL, driveBackward},        // MOVING_BACKWARD
+    {rememberMove, NULL, turnAside},    // AVOIDING_OBSTACLE
+    {NULL, NULL, NULL},                 // STOPPED
+};
+
+/**
+ * @brief Transitions of the motor control FSM.
+ *
+ * Commanded transitions are looked up when a command asks for their target
+ * state, and the request is rejected if none from the current state has a
+ * guard that holds. Automatic transitions are checked in every cycle, and
+ * the first from the current state whose guard holds is taken.
+ */
+static constexpr FsmTransition TRANSITIONS[] = {
+    // Commanded
+    {ANY_STATE, IDLE, true, NULL},
+    {ANY_STATE, STOPPED, true, NULL},
+    {ANY_STATE, CORRECTING_TILT, true, isUpright},
+    {ANY_STATE, MOVING_FORWARD, true, isClear},
+    {ANY_STATE, MOVING_BACKWARD, true, NULL},
+
+    // Automatic, from the sensor bus
+    {CORRECTING_TILT, STOPPED, false, cannotBalance},
+    {MOVING_FORWARD, AVOIDING_OBSTACLE, false, isBlocked},
+    {MOVING_BACKWARD, AVOIDING_OBSTACLE, false, isBlocked},
+    {AVOIDING_OBSTACLE, MOVING_FORWARD, false, canResumeForward},
+    {AVOIDING_OBSTACLE, MOVING_BACKWARD, false, canResumeBackward},
+};
+
+static constexpr size_t TRANSITION_COUNT = sizeof(TRANSITIONS) / sizeof(TRANSITIONS[0]);
+
+static_assert(sizeof(STATE_ACTIONS) / sizeof(STATE_ACTIONS[0]) == CONEBOT_STATE_COUNT,
+              "Every state needs a row of actions");
+
+static constexpr bool isValidTransitionTable() {
+    for (size_t i = 0; i < TRANSITION_COUNT; i++) {
+        const FsmTransition &transition = TRANSITIONS[i];
+        bool fromState = transition.from < CONEBOT_STATE_COUNT;
+        if ((!fromState && (transition.from != ANY_STATE || !transition.commanded)) ||
+            transition.to >= CONEBOT_STATE_COUNT || transition.from == transition.to) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isValidTransitionTable(),
+              "Transitions must join two different states, and only commanded ones may start from ANY_STATE");
+
+static const FsmTransition *findTransition(const FsmContext &context, bool commanded, ConeBotState target) {
+    ConeBotState state = context.fsm.getState();
+    for (size_t i = 0; i < TRANSITION_COUNT; i++) {
+        const FsmTransition &transition = TRANSITIONS[i];
+        if (transition.commanded == commanded && (transition.from == ANY_STATE || transition.from == state) &&
+            transition.to != state && (!commanded || transition.to == target) &&
+            (!transition.guard || transition.guard(context))) {
+            return &transition;
+        }
+    }
+    return NULL;
+}
+
+static void changeState(FsmContext &context, ConeBotState next) {
+    ConeBotState previous = context.fsm.getState();
+    if (STATE_ACTIONS[previous].exit) {
+        STATE_ACTIONS[previous].exit(context, next);
+    }
+    context.fsm.enter(next, context.now);
+    if (STATE_ACTIONS[next].entry) {
+        STATE_ACTIONS[next].entry(context, previous);
+    }
+}
+
+/**
+ * @brief Runs one cycle of the motor control FSM.
+ *
+ * @param fsm FSM state and statistics, kept between cycles.
+ * @param measurement Latest sensor measurements.
+ * @param obstacleDetected True if the TOF sensor reports an obstacle.
+ * @param now Time of the cycle, the clock of dwell times and timed guards.
+ * @param controller Balance controller state, kept between cycles.
+ * @param setpoint Receives the wheel speeds for the wheel speed loop.
+ * @return The FSM state after the cycle.
+ */
+ConeBotState motorControlStep(ConeBotFsm &fsm, const Measurement &measurement, bool obstacleDetected, int64_t now,
+                              ConeBotController &controller, WheelSetpoint &setpoint) {
+    FsmContext context = {fsm, controller, measurement, obstacleDetected, now};
+    fsm.tick(now);
+
+    ConeBotState requested;
+    if (fsm.takeRequest(requested) && requested != fsm.getState()) {
+        if (findTransition(context, true, requested)) {
+            changeState(context, requested);
+        } else {
+            fsm.rejectRequest();
+        }
+    }
+    const FsmTransition *transition = findTransition(context, false, fsm.getState());
+    if (transition) {
+        changeState(context, transition->to);
+    }
+
+    setpoint.driving = false;
+    setpoint.left = setpoint.right = 0.0f;
+    const FsmStateActions &actions = STATE_ACTIONS[fsm.getState()];
+    if (actions.activity) {
+        actions.activity(context, setpoint);
+    }
+    return fsm.getState();
+}
+
+/**
+ * @brief Applies one command to the motor control FSM and balance controller.
+ *
+ * @param fsm Motor control FSM.
+ * @param command Validated command from parseCommand().
+ * @param controller Balance controller, owned by the motor control loop.
+ * @param gains Gains the controller runs with, updated by COMMAND_SET_GAINS.
+ */
+void commandStep(ConeBotFsm &fsm, const Command &command, ConeBotController &controller, BalanceGains &gains) {
+    switch (command.type) {
+        case COMMAND_SET_STATE:
+            fsm.request((ConeBotState)command.state);
+            break;
+
+        case COMMAND_SET_POSITION:
+            controller.setPositionSetpoint(ControlScalar(command.values[0]));
+            break;
+
+        case COMMAND_SET_GAINS: {
+            PIDGains *stage = command.stage == GAIN_POSITION ? &gains.position
+                            : command.stage == GAIN_PITCH    ? &gains.pitch
+                            : command.stage == GAIN_RATE     ? &gains.rate
+                                                             : NULL;
+            if (stage) {
+                stage->kp = command.values[0];
+                stage->ki = command.values[1];
+                stage->kd = command.values[2];
+                stage->outputLimit = command.values[3];
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    gains.lqr[i] = command.values[i];
+                }
+            }
+            controller.configure(gains, CONTROL_PERIOD_US * 1e-6f);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Publishes the outcome of one motor control cycle on the sensor bus.
+ *
+ * @param state FSM state after the cycle.
+ * @param measurement Measurement the cycle acted on.
+ * @param setpoint Wheel speeds set by the cycle.
+ * @param now Time of the cycle, as passed to motorControlStep().
+ * @param bus Sensor bus receiving the sample.
+ */
+void controlStep(ConeBotState state, const Measurement &measurement, const WheelSetpoint &setpoint, int64_t now,
+                 SensorBus &bus) {
+    ControlSample sample;
+    sample.timestamp = now;
+    sample.state = (uint8_t)state;
+    sample.pitch = measurement.angle;
+    sample.pitchRate = measurement.angularVelocity;
+    sample.position = measurement.position;
+    sample.velocity = measurement.velocity;
+    sample.leftSetpoint = setpoint.left;
+    sample.rightSetpoint = setpoint.right;
+    sample.imuTimestamp = measurement.imuTimestamp;
+    sample.encoderTimestamp = measurement.encoderTimestamp;
+    sample.obstacleTimestamp = measurement.obstacleTimestamp;
+    sample.gpsTimestamp = measurement.gpsTimestamp;
+    bus.control.push(sample);
+}
+
+/**
+ * @brief Runs one cycle of the wheel speed loop.
+ *
+ * @param setpoint Wheel speeds from the motor control FSM.
+ * @param odometry Latest odometry, for the measured wheel speeds.
+ * @param batteryVoltage Motor supply voltage in V.
+ * @param leftLoop Speed loop of the left wheel.
+ * @param rightLoop Speed loop of the right wheel.
+ * @param left Left drive motor.
+ * @param right Right drive motor.
+ */
+void wheelStep(const WheelSetpoint &setpoint, const OdometryState &odometry, float batteryVoltage,
+               WheelSpeedController &leftLoop, WheelSpeedController &rightLoop, MotorInterface &left,
+               MotorInterface &right) {
+    if (!setpoint.driving) {
+        left.stop();
+        right.stop();
+        leftLoop.reset();
+        rightLoop.reset();
+        return;
+    }
+    float leftDuty = leftLoop.update(setpoint.left, odometry.leftVelocity, batteryVoltage);
+    float rightDuty = rightLoop.update(setpoint.right, odometry.rightVelocity, batteryVoltage);
+    driveMotors(left, right, leftDuty, rightDuty);
+}
+
+/**
+ * @brief Samples both wheel encoders at once, updates the odometry and publishes both on the sensor bus.
+ *
+ * @param left Left drive motor.
+ * @param right Right drive motor.
+ * @param odometry Odometry, owned by the encoder producer.
+ * @param bus Sensor bus receiving the encoder sample and odometry state.
+ */
+void encoderStep(MotorInterface &left, MotorInterface &right, Odometry &odometry, SensorBus &bus) {
+    EncoderSample sample;
+    sample.timestamp = sampleEncoders(left, right, sample.left, sample.right);
+    odometryStep(sample, odometry, bus);
+}
+
+/**
+ * @brief Updates the odometry with an encoder sample and publishes both on the sensor bus.
+ *
+ * @param sample Reading of both encoders.
+ * @param odometry Odometry, owned by the encoder producer.
+ * @param bus Sensor bus receiving the encoder sample and odometry state.
+ */
+void odometryStep(const EncoderSample &sample, Odometry &odometry, SensorBus &bus) {
+    bus.encoders.push(sample);
+    bus.odometry.push(odometry.update(sample.timestamp, sample.left, sample.right));
+}
+
+/**
+ * @brief Reads the IMU and publishes the sample on the sensor bus, if the read produced new data.
+ *
+ * @param imu IMU providing the tilt angle and pitch rate.
+ * @param bus Sensor bus receiving the sample.
+ */
+void imuStep(IMUInterface &imu, SensorBus &bus) {
+    // A failed or uncalibrated read keeps the old pitch, which must not be published as a new sample
+    if (!imu.update()) {
+        return;
+    }
+    ImuSample sample;
+    sample.timestamp = nowMicros();
+    sample.pitch = imu.getPitch();
+    sample.pitchRate = imu.getAngularVelocity();
+    bus.imu.push(sample);
+}
+
+/**
+ * @brief Feeds a new TOF range to the obstacle model and publishes the range and the result on the sensor bus.
+ *
+ * @param frame Newly completed TOF range.
+ * @param obstacles Obstacle model, owned by the TOF producer.
+ * @param bus Sensor bus receiving the range and obstacle state.
+ */
+void obstacleStep(const TofFrame &frame, ObstacleModel &obstacles, SensorBus &bus) {
+    bus.tof.push(frame);
+    ObstacleSample sample;
+    sample.timestamp = frame.timestamp;
+    sample.obstacle = obstacles.update(frame);
+    bus.obstacle.push(sample);
+}
+
+/**
+ * @brief Publishes a new GPS fix on the sensor bus.
+ *
+ * @param fix Newly decoded fix.
+ * @param bus Sensor bus receiving the fix.
+ */
+void gpsStep(const GpsFix &fix, SensorBus &bus) {
+    GpsSample sample;
+    sample.timestamp = nowMicros();
+    sample.fix = fix;
+    bus.gps.push(sample);
+}
+
+/**
+ * @brief Assembles the inputs of the motor control FSM from the newest samples on the sensor bus.
+ *
+ * @param bus Sensor bus to read.
+ * @param measurement Updated with the newest sensor readings.
+ * @param obstacleDetected Set while the obstacle model reports an obstacle.
+ */
+void readMeasurement(const SensorBus &bus, Measurement &measurement, bool &obstacleDetected) {
+    ImuSample imu = bus.imu.latest();
+    measurement.angle = imu.pitch;
+    measurement.angularVelocity = imu.pitchRate;
+    measurement.imuTimestamp = imu.timestamp;
+
+    OdometryState odometry = bus.odometry.latest();
+    measurement.position = odometry.distance;
+    measurement.velocity = odometry.velocity;
+    measurement.encoderTimestamp = odometry.timestamp;
+
+    ObstacleSample obstacleSample = bus.obstacle.latest();
+    const ObstacleState &obstacle = obstacleSample.obstacle;
+    measurement.distance = obstacle.tracking ? (uint16_t)lrintf(obstacle.distance) : 0;
+    measurement.closingSpeed = obstacle.closingSpeed;
+    measurement.timeToCollision = obstacle.tracking ? obstacle.timeToCollision : INFINITY;
+    measurement.obstacleTimestamp = obstacleSample.timestamp;
+    obstacleDetected = obstacle.detected;
+
+    GpsSample gps = bus.gps.latest();
+    measurement.latitude = gps.fix.latitude;
+    measurement.longtitude = gps.fix.longitude;
+    measurement.gpsTimestamp = gps.timestamp;
+}
+
+/**
+ * @brief Derives the robot state published as telemetry from the sensor bus.
+ *
+ * @param bus Sensor bus to read.
+ * @return The newest IMU, odometry, control, obstacle and GPS samples combined.
+ */
+BotState readBotState(const SensorBus &bus) {
+    ImuSample imu = bus.imu.latest();
+    OdometryState odometry = bus.odometry.latest();
+    ControlSample control = bus.control.latest();
+    ObstacleState obstacle = bus.obstacle.latest().obstacle;
+    GpsFix fix = bus.gps.latest().fix;
+    BotState state;
+    state.timestamp = imu.timestamp;
+    state.state = control.state;
+    state.tilt_angle = imu.pitch;
+    state.pitchRate = imu.pitchRate;
+    state.position = odometry.distance;
+    state.velocity = odometry.velocity;
+    state.x = odometry.x;
+    state.y = odometry.y;
+    state.heading = odometry.heading;
+    state.yawRate = odometry.yawRate;
+    state.leftVelocity = odometry.leftVelocity;
+    state.rightVelocity = odometry.rightVelocity;
+    state.leftSetpoint = control.leftSetpoint;
+    state.rightSetpoint = control.rightSetpoint;
+    state.obstacleDetected = obstacle.detected;
+    state.obstacleDistance = obstacle.tracking ? (uint16_t)lrintf(obstacle.distance) : 0;
+    state.gpsValid = fix.valid;
+    state.latitude = fix.latitude;
+    state.longitude = fix.longitude;
+    return state;
+}
+
+/**
+ * @brief Publishes the robot state to the "bot/state" topic as a TELEMETRY_STATE frame.
+ *
+ * @param state Robot state to publish.
+ * @param mqtt Link to the MQTT broker.
+ * @return True if the message was handed to the broker connection.
+ */
+bool telemetryStep(const BotState &state, MQTTInterface &mqtt) {
+    uint8_t frame[TELEMETRY_STATE_FRAME_SIZE];
+    size_t length = encodeTelemetry(state, frame, sizeof(frame));
+    return length > 0 && mqtt.publish("bot/state", frame, length);
+}
+
+/**
+ * @brief Batches every control sample published since the previous call, and publishes
+ * each batch that is due to the "bot/trace" topic as a TELEMETRY_CONTROL_BATCH frame.
+ *
+ * A batch that fails to publish is discarded, as the next one is already
+ * being collected.
+ *
+ * @param bus Sensor bus to read.
+ * @param reader Cursor of the trace on the bus's control ring.
+ * @param batcher Batch being filled.
+ * @param mqtt Link to the MQTT broker.
+ * @return Number of batches handed to the broker connection.
+ */
+uint32_t telemetryBatchStep(const SensorBus &bus, SampleRing<ControlSample, 1024>::Reader &reader,
+                            TelemetryBatcher &batcher, MQTTInterface &mqtt) {
+    uint32_t published = 0;
+    ControlSample sample;
+    while (bus.control.read(reader, sample)) {
+        batcher.add(sample);
+        if (batcher.isFull()) {
+            size_t length = batcher.finish(reader.dropped);
+            published += mqtt.publish("bot/trace", batcher.getFrame(), length) ? 1 : 0;
+            batcher.clear();
+        }
+    }
+    if (batcher.isDue(nowMicros())) {
+        size_t length = batcher.finish(reader.dropped);
+        published += mqtt.publish("bot/trace", batcher.getFrame(), length) ? 1 : 0;
+        batcher.clear();
+    }
+    return published;
+}
+
+/**
+ * @brief Adds one record to the block, first handing the block to the sink and beginning the next if it is full.
+ *
+ * @return Number of blocks handed to @p sink.
+ */
+template <typename T>
+static uint32_t record(const T &sample, FlightLogBlock &block, FlightLogSink &sink) {
+    if (block.add(sample)) {
+        return 0;
+    }
+    sink.writeBlock(block.finish());
+    block.begin(block.getSession(), block.getSequence() + 1);
+    block.add(sample);
+    return 1;
+}
+
+/**
+ * @brief Logs every sample of one ring the cursor has not seen yet.
+ *
+ * @return Number of blocks handed to @p sink.
+ */
+template <typename T, uint32_t N>
+static uint32_t recordRing(const SampleRing<T, N> &ring, typename SampleRing<T, N>::Reader &reader,
+                           FlightLogBlock &block, FlightLogSink &sink) {
+    uint32_t written = 0;
+    T sample;
+    while (ring.read(reader, sample)) {
+        written += record(sample, block, sink);
+    }
+    return written;
+}
+
+/**
+ * @brief Starts logging the sensor bus with the samples pushed from now on.
+ *
+ * @param bus Sensor bus to log.
+ * @return Cursors for recordStep().
+ */
+RecordCursors startRecording(const SensorBus &bus) {
+    RecordCursors cursors;
+    cursors.imu = bus.imu.reader();
+    cursors.encoders = bus.encoders.reader();
+    cursors.tof = bus.tof.reader();
+    cursors.gps = bus.gps.reader();
+    cursors.commands = bus.commands.reader();
+    cursors.control = bus.control.reader();
+    cursors.state = NO_STATE;
+    return cursors;
+}
+
+/**
+ * @brief Logs every sample pushed on the sensor bus since the previous call into flight log blocks.
+ *
+ * @param bus Sensor bus to log.
+ * @param cursors Position of the log in each ring.
+ * @param block Block being filled, begun with the session's identifier.
+ * @param sink Receives each completed block.
+ * @return Number of blocks handed to @p sink.
+ */
+uint32_t recordStep(const SensorBus &bus, RecordCursors &cursors, FlightLogBlock &block, FlightLogSink &sink) {
+    uint32_t written = 0;
+    written += recordRing(bus.imu, cursors.imu, block, sink);
+    written += recordRing(bus.encoders, cursors.encoders, block, sink);
+    written += recordRing(bus.tof, cursors.tof, block, sink);
+    written += recordRing(bus.gps, cursors.gps, block, sink);
+    written += recordRing(bus.commands, cursors.commands, block, sink);
+    ControlSample sample;
+    while (bus.control.read(cursors.control, sample)) {
+        if (cursors.state != NO_STATE && sample.state != cursors.state) {
+            TransitionSample transition = {sample.timestamp, cursors.state, sample.state};
+            written += record(transition, block, sink);
+        }
+        cursors.state = sample.state;
+        written += record(sample, block, sink);
+    }
+    return written;
+}
@@ -0,0 +1,487 @@
+/** @file ConeBot.h
+ *  @brief Shared data types and the per-cycle steps of the ConeBot control and sensor pipelines.
+ *
+ *  The FreeRTOS tasks in main.cpp and the native simulation both call these
+ *  step functions, so they contain no delays, prints or direct hardware access.
+ */
+
+#ifndef CONEBOT_H
+#define CONEBOT_H
+
+#include "HAL.h"
+#include "Command.h"
+#include "Controller.h"
+#include "FixedPoint.h"
+#include "FlightLog.h"
+#include "LatestValue.h"
+#include "ObstacleModel.h"
+#include "SensorBus.h"
+#include "SpscQueue.h"
+#include "Telemetry.h"
+#include "WheelSpeedController.h"
+
+/** @brief Rate of the motor control loop in hertz, 200 to 1000. */
+static const uint32_t CONTROL_RATE_HZ = 500;
+
+/** @brief Period of the motor control loop in microseconds. */
+static const uint32_t CONTROL_PERIOD_US = 1000000 / CONTROL_RATE_HZ;
+
+static_assert(CONTROL_RATE_HZ >= 200 && CONTROL_RATE_HZ <= 1000, "Control rate must be 200 to 1000 Hz");
+
+/** @brief Rate of the wheel speed loop in hertz. */
+static const uint32_t WHEEL_RATE_HZ = 1000;
+
+/** @brief Period of the wheel speed loop in microseconds. */
+static const uint32_t WHEEL_PERIOD_US = 1000000 / WHEEL_RATE_HZ;
+
+/** @brief Period of the battery voltage reading used by the wheel speed loop, in milliseconds. */
+static const uint32_t BATTERY_PERIOD_MS = 100;
+
+/**
+ * @brief Period of the IMU task in milliseconds.
+ *
+ * By default this matches the 100 Hz BNO055 fusion output. Build with
+ * -DCONEBOT_RAW_IMU to read the raw gyro and accelerometer at 1 kHz and
+ * estimate pitch on the MCU instead (see AttitudeEstimator.h).
+ */
+#ifdef CONEBOT_RAW_IMU
+static const uint32_t IMU_PERIOD_MS = 1;
+#else
+static const uint32_t IMU_PERIOD_MS = 10;
+#endif
+
+/**
+ * @brief Longest IMU period in milliseconds at which DEFAULT_BALANCE_GAINS hold the simulated robot.
+ *
+ * From "batch --runs 50 --seconds 10 --imu-period US": up to 40 ms every run
+ * stays up at under 0.4 deg rms, at 50 ms the robot rocks by about 4 deg
+ * rms, and from 60 ms runs fall or are stopped on MAX_IMU_AGE_US. The IMU was read only every 100 ms until
+ * TOF ranging moved to its own task, so the gains balance from then on.
+ */
+static const uint32_t MAX_BALANCE_IMU_PERIOD_MS = 40;
+static_assert(IMU_PERIOD_MS <= MAX_BALANCE_IMU_PERIOD_MS, "DEFAULT_BALANCE_GAINS need a faster IMU");
+
+/** @brief Period of the MQTT telemetry publish in milliseconds, 50 Hz. */
+static const uint32_t TELEMETRY_PERIOD_MS = 20;
+
+/** @brief Buffered control trace messages replayed per telemetry period once the broker is back. */
+static const uint32_t TELEMETRY_REPLAY_PER_PERIOD = 4;
+
+/** @brief Period of the flight recorder draining the sensor bus in milliseconds, well within the 64 ms the IMU ring holds at 1 kHz. */
+static const uint32_t RECORD_PERIOD_MS = 20;
+
+/** @brief Pitch in degrees beyond which balancing is given up and the motors stop. */
+static const float FALL_ANGLE_DEG = 45.0f;
+
+/**
+ * @brief Age in microseconds beyond which an IMU sample is too old to balance on, a few IMU periods.
+ *
+ * If the IMU task stalls, balancing stops instead of holding a frozen pitch.
+ */
+static const int64_t MAX_IMU_AGE_US = 5 * IMU_PERIOD_MS * 1000;
+
+/** @brief Wheel speed in m/s of the moving states and of a full balance controller command. */
+static const float MAX_WHEEL_SPEED_MPS = 1.0f;
+
+/** @brief Wheel speed in m/s of the turn in place in AVOIDING_OBSTACLE. */
+static const float AVOID_TURN_SPEED_MPS = 0.3f;
+
+/** @brief Shortest turn in AVOIDING_OBSTACLE in microseconds, so the robot turns clear of the obstacle's edge. */
+static const int64_t AVOID_MIN_TURN_US = 500000;
+
+/** @brief Balance controller command that asks for MAX_WHEEL_SPEED_MPS. */
+static const float FULL_SPEED_COMMAND = 255.0f;
+
+/** @brief Wheel radius in meters. */
+static const float WHEEL_RADIUS_M = 0.04f;
+
+/** @brief Encoder counts per wheel revolution. */
+static const float ENCODER_COUNTS_PER_REV = 660.0f;
+
+/** @brief Distance between the wheel contact points in meters. */
+static const float WHEEL_TRACK_M = 0.16f;
+
+/**
+ * @brief Scalar type of the balance controller.
+ *
+ * Build with -DCONEBOT_FIXED_POINT_CONTROL to run the controller in Q15.16
+ * fixed point instead of single-precision float.
+ */
+#ifdef CONEBOT_FIXED_POINT_CONTROL
+typedef Q16 ControlScalar;
+#else
+typedef float ControlScalar;
+#endif
+
+/** @brief Balance controller used in the CORRECTING_TILT state. */
+typedef BalanceController<ControlScalar> ConeBotController;
+
+/** @brief Balance gains tuned against the native pendulum model. */
+extern const BalanceGains DEFAULT_BALANCE_GAINS;
+
+/**
+ * @brief Structure to store sensor measurements.
+ */
+typedef struct {
+    float position;      /**< Wheel position in meters, the mean of both encoders. */
+    float velocity;      /**< Wheel speed in m/s from the odometry, the mean of both wheels. */
+    float angle;         /**< Robot's tilt angle. */
+    float angularVelocity; /**< Robot's pitch rate. */
+    int32_t latitude;    /**< Latitude from GPS in 1e-7 degrees. */
+    int32_t longtitude;  /**< Longitude from GPS in 1e-7 degrees. */
+    uint32_t attitude;   /**< Placeholder for additional attitude data. */
+    uint16_t distance;   /**< Filtered distance to the nearest obstacle in mm, or 0 if none. */
+    float closingSpeed;  /**< Speed at which the obstacle approaches in mm/s. */
+    float timeToCollision; /**< Time until the obstacle is reached in s, or INFINITY. */
+    int64_t imuTimestamp;      /**< Time of the IMU sample behind angle and angularVelocity, or 0 if none yet. */
+    int64_t encoderTimestamp;  /**< Time of the encoder sample behind position and velocity, or 0 if none yet. */
+    int64_t obstacleTimestamp; /**< Time of the TOF range behind the obstacle fields, or 0 if none yet. */
+    int64_t gpsTimestamp;      /**< Time of the GPS fix behind latitude and longtitude, or 0 if none yet. */
+} Measurement;
+
+/**
+ * @brief Finite State Machine (FSM) states for the robot.
+ */
+enum ConeBotState {
+    IDLE,               /**< Robot is idle. */
+    CORRECTING_TILT,    /**< Robot is correcting tilt. */
+    MOVING_FORWARD,     /**< Robot is moving forward. */
+    MOVING_BACKWARD,    /**< Robot is moving backward. */
+    AVOIDING_OBSTACLE,  /**< Robot met an obstacle while moving and turns in place until the way is clear. */
+    STOPPED,            /**< Robot fell over or was told to stop; the motors are off until a command. */
+    CONEBOT_STATE_COUNT /**< Number of states. */
+};
+
+/**
+ * @brief Gets the short name of an FSM state, as used in commands and reports.
+ *
+ * @param state FSM state.
+ * @return The name, or "?" for a value that is not a state.
+ */
+const char *getStateName(uint8_t state);
+
+/**
+ * @brief Time spent in each FSM state and the transitions between them.
+ */
+typedef struct {
+    int64_t dwellMicros[CONEBOT_STATE_COUNT];   /**< Time spent in each state. */
+    uint32_t transitions[CONEBOT_STATE_COUNT][CONEBOT_STATE_COUNT]; /**< Transitions by state left and state entered. */
+    uint32_t rejectedRequests;                  /**< Commanded states refused by a guard or with no transition. */
+} FsmStats;
+
+/**
+ * @class ConeBotFsm
+ * @brief State and bookkeeping of the motor control FSM, owned by the motor control loop.
+ *
+ * The transitions, guards and entry, exit and per-cycle actions are
+ * constexpr tables in ConeBot.cpp, run by motorControlStep(). This class
+ * holds the current state, the state commandStep() asked for, and the time
+ * spent in each state. Every publishInterval cycles, and after each
+ * transition, the statistics are published to a lock-free snapshot that any
+ * task can read with getStats().
+ */
+class ConeBotFsm {
+public:
+    /**
+     * @brief Constructor for the ConeBotFsm class.
+     *
+     * @param initial State before the first cycle.
+     * @param publishInterval Cycles between snapshots for other tasks.
+     */
+    ConeBotFsm(ConeBotState initial = IDLE, uint32_t publishInterval = CONTROL_RATE_HZ / 10);
+
+    /**
+     * @brief Gets the current state.
+     */
+    ConeBotState getState() const;
+
+    /**
+     * @brief Asks for a state, entered in the next cycle if a commanded transition allows it.
+     *
+     * Only the last request before a cycle counts.
+     *
+     * @param target State to enter.
+     */
+    void request(ConeBotState target);
+
+    /**
+     * @brief Takes the state asked for since the previous cycle.
+     *
+     * @param target Receives the state.
+     * @return False if no state was asked for.
+     */
+    bool takeRequest(ConeBotState &target);
+
+    /**
+     * @brief Counts a request no transition allowed.
+     */
+    void rejectRequest();
+
+    /**
+     * @brief Adds the time since the previous cycle to the current state, at the start of each cycle.
+     *
+     * @param now Time of the cycle.
+     */
+    void tick(int64_t now);
+
+    /**
+     * @brief Changes the state and counts the transition; the caller runs the exit and entry actions.
+     *
+     * @param next State entered.
+     * @param now Time of the cycle, passed to tick() before.
+     */
+    void enter(ConeBotState next, int64_t now);
+
+    /**
+     * @brief Gets the time spent in the current state since it was entered.
+     *
+     * @param now Time of the cycle.
+     */
+    int64_t getTimeInState(int64_t now) const;
+
+    /**
+     * @brief Gets the moving state AVOIDING_OBSTACLE returns to once the way is clear.
+     */
+    ConeBotState getResumeState() const;
+
+    /**
+     * @brief Sets the moving state AVOIDING_OBSTACLE returns to, by its entry action.
+     *
+     * @param state MOVING_FORWARD or MOVING_BACKWARD.
+     */
+    void setResumeState(ConeBotState state);
+
+    /**
+     * @brief Gets the statistics as of the latest snapshot; safe to call from any task.
+     */
+    FsmStats getStats() const;
+
+private:
+    ConeBotState state;             /**< Current state. */
+    ConeBotState requested;         /**< State asked for, valid while hasRequest. */
+    bool hasRequest;                /**< A request is waiting for the next cycle. */
+    ConeBotState resumeState;       /**< Moving state AVOIDING_OBSTACLE returns to. */
+    int64_t enteredAt;              /**< Time the current state was entered, or of the first cycle. */
+    int64_t lastTick;               /**< Time of the previous cycle. */
+    bool started;                   /**< tick() has run at least once. */
+    uint32_t publishInterval;       /**< Cycles between snapshots. */
+    uint32_t cycles;                /**< Cycles since the previous snapshot. */
+    FsmStats stats;                 /**< Statistics, owned by the motor control loop. */
+    LatestValue<FsmStats> snapshot; /**< Copy of stats for other tasks. */
+};
+
+/**
+ * @brief Wheel speeds commanded by the motor control FSM to the wheel speed loop.
+ */
+typedef struct {
+    bool driving;   /**< False to let both motors coast with zero duty. */
+    float left;     /**< Left wheel speed in m/s, forward positive. */
+    float right;    /**< Right wheel speed in m/s, forward positive. */
+} WheelSetpoint;
+
+/**
+ * @brief Runs one cycle of the motor control FSM.
+ *
+ * First a state asked for by commandStep() is entered, if a commanded
+ * transition from the current state allows it and its guard holds. Then
+ * the first automatic transition from the state whose guard holds on the
+ * measurement is taken: a fall or a stale IMU sample stops the robot, an obstacle turns a moving
+ * robot aside, and a clear way resumes the move. Leaving a state runs its
+ * exit action, entering one its entry action. Last, the state's action
+ * sets the wheel speeds.
+ *
+ * In CORRECTING_TILT the balance controller sets both wheel speeds from the
+ * pitch, pitch rate and wheel position. The controller must have been
+ * configured for CONTROL_PERIOD_US; it is reset whenever balancing stops.
+ *
+ * @param fsm FSM state and statistics, kept between cycles.
+ * @param measurement Latest sensor measurements.
+ * @param obstacleDetected True if the TOF sensor reports an obstacle.
+ * @param now Time of the cycle, the clock of dwell times and timed guards.
+ * @param controller Balance controller state, kept between cycles.
+ * @param setpoint Receives the wheel speeds for the wheel speed loop.
+ * @return The FSM state after the cycle.
+ */
+ConeBotState motorControlStep(ConeBotFsm &fsm, const Measurement &measurement, bool obstacleDetected, int64_t now,
+                              ConeBotController &controller, WheelSetpoint &setpoint);
+
+/** @brief Queue of validated commands from the MQTT task to the motor control loop. */
+typedef SpscQueue<Command, 16> CommandQueue;
+
+/** @brief Most commands the motor control loop applies in one cycle, bounding the cycle's execution time. */
+static const uint8_t MAX_COMMANDS_PER_CYCLE = 4;
+
+/**
+ * @brief Applies one command to the motor control FSM and balance controller.
+ *
+ * A new state is only requested here; motorControlStep() enters it in the
+ * same cycle if the transition table allows it. New gains are applied
+ * with BalanceController::configure(), which also resets the controller.
+ *
+ * @param fsm Motor control FSM.
+ * @param command Validated command from parseCommand().
+ * @param controller Balance controller, owned by the motor control loop.
+ * @param gains Gains the controller runs with, updated by COMMAND_SET_GAINS.
+ */
+void commandStep(ConeBotFsm &fsm, const Command &command, ConeBotController &controller, BalanceGains &gains);
+
+/**
+ * @brief Publishes the outcome of one motor control cycle on the sensor bus.
+ *
+ * @param state FSM state after the cycle.
+ * @param measurement Measurement the cycle acted on.
+ * @param setpoint Wheel speeds set by the cycle.
+ * @param now Time of the cycle, as passed to motorControlStep().
+ * @param bus Sensor bus receiving the sample.
+ */
+void controlStep(ConeBotState state, const Measurement &measurement, const WheelSetpoint &setpoint, int64_t now,
+                 SensorBus &bus);
+
+/**
+ * @brief Runs one cycle of the wheel speed loop.
+ *
+ * Regulates each wheel to its setpoint from the odometry wheel speeds, or
+ * stops both motors and clears the loops when the setpoint is not driving.
+ *
+ * @param setpoint Wheel speeds from the motor control FSM.
+ * @param odometry Latest odometry, for the measured wheel speeds.
+ * @param batteryVoltage Motor supply voltage in V.
+ * @param leftLoop Speed loop of the left wheel.
+ * @param rightLoop Speed loop of the right wheel.
+ * @param left Left drive motor.
+ * @param right Right drive motor.
+ */
+void wheelStep(const WheelSetpoint &setpoint, const OdometryState &odometry, float batteryVoltage,
+               WheelSpeedController &leftLoop, WheelSpeedController &rightLoop, MotorInterface &left,
+               MotorInterface &right);
+
+/**
+ * @brief Samples both wheel encoders at once, updates the odometry and publishes both on the sensor bus.
+ *
+ * @param left Left drive motor.
+ * @param right Right drive motor.
+ * @param odometry Odometry, owned by the encoder producer.
+ * @param bus Sensor bus receiving the encoder sample and odometry state.
+ */
+void encoderStep(MotorInterface &left, MotorInterface &right, Odometry &odometry, SensorBus &bus);
+
+/**
+ * @brief Updates the odometry with an encoder sample and publishes both on the sensor bus.
+ *
+ * The part of encoderStep() after reading the encoders, also used to replay
+ * recorded encoder samples.
+ *
+ * @param sample Reading of both encoders.
+ * @param odometry Odometry, owned by the encoder producer.
+ * @param bus Sensor bus receiving the encoder sample and odometry state.
+ */
+void odometryStep(const EncoderSample &sample, Odometry &odometry, SensorBus &bus);
+
+/**
+ * @brief Reads the IMU and publishes the sample on the sensor bus, if the read produced new data.
+ *
+ * Nothing is published while the IMU is uncalibrated or its read fails, so
+ * the newest sample on the bus keeps the time of the last good read.
+ *
+ * @param imu IMU providing the tilt angle and pitch rate.
+ * @param bus Sensor bus receiving the sample.
+ */
+void imuStep(IMUInterface &imu, SensorBus &bus);
+
+/**
+ * @brief Feeds a new TOF range to the obstacle model and publishes the range and the result on the sensor bus.
+ *
+ * @param frame Newly completed TOF range.
+ * @param obstacles Obstacle model, owned by the TOF producer.
+ * @param bus Sensor bus receiving the range and obstacle state.
+ */
+void obstacleStep(const TofFrame &frame, ObstacleModel &obstacles, SensorBus &bus);
+
+/**
+ * @brief Publishes a new GPS fix on the sensor bus.
+ *
+ * @param fix Newly decoded fix.
+ * @param bus Sensor bus receiving the fix.
+ */
+void gpsStep(const GpsFix &fix, SensorBus &bus);
+
+/**
+ * @brief Assembles the inputs of the motor control FSM from the newest samples on the sensor bus.
+ *
+ * @param bus Sensor bus to read.
+ * @param measurement Updated with the newest sensor readings.
+ * @param obstacleDetected Set while the obstacle model reports an obstacle.
+ */
+void readMeasurement(const SensorBus &bus, Measurement &measurement, bool &obstacleDetected);
+
+/**
+ * @brief Derives the robot state published as telemetry from the sensor bus.
+ *
+ * @param bus Sensor bus to read.
+ * @return The newest IMU, odometry, control, obstacle and GPS samples combined.
+ */
+BotState readBotState(const SensorBus &bus);
+
+/**
+ * @brief Publishes the robot state to the "bot/state" topic as a TELEMETRY_STATE frame.
+ *
+ * @param state Robot state to publish.
+ * @param mqtt Link to the MQTT broker.
+ * @return True if the message was handed to the broker connection.
+ */
+bool telemetryStep(const BotState &state, MQTTInterface &mqtt);
+
+/**
+ * @brief Batches every control sample published since the previous call, and publishes
+ * each batch that is due to the "bot/trace" topic as a TELEMETRY_CONTROL_BATCH frame.
+ *
+ * @param bus Sensor bus to read.
+ * @param reader Cursor of the trace on the bus's control ring.
+ * @param batcher Batch being filled.
+ * @param mqtt Link to the MQTT broker.
+ * @return Number of batches handed to the broker connection.
+ */
+uint32_t telemetryBatchStep(const SensorBus &bus, SampleRing<ControlSample, 1024>::Reader &reader,
+                            TelemetryBatcher &batcher, MQTTInterface &mqtt);
+
+/**
+ * @brief Position of the flight recorder in each sensor bus ring it logs.
+ */
+typedef struct {
+    SampleRing<ImuSample, 64>::Reader imu;           /**< Cursor on SensorBus::imu. */
+    SampleRing<EncoderSample, 512>::Reader encoders; /**< Cursor on SensorBus::encoders. */
+    SampleRing<TofFrame, 16>::Reader tof;            /**< Cursor on SensorBus::tof. */
+    SampleRing<GpsSample, 8>::Reader gps;            /**< Cursor on SensorBus::gps. */
+    SampleRing<CommandSample, 16>::Reader commands;  /**< Cursor on SensorBus::commands. */
+    SampleRing<ControlSample, 1024>::Reader control;  /**< Cursor on SensorBus::control. */
+    uint8_t state;      /**< FSM state of the latest control sample logged, or NO_STATE before the first. */
+} RecordCursors;
+
+/** @brief RecordCursors::state before any control sample was logged. */
+static const uint8_t NO_STATE = 0xFF;
+
+/**
+ * @brief Starts logging the sensor bus with the samples pushed from now on.
+ *
+ * @param bus Sensor bus to log.
+ * @return Cursors for recordStep().
+ */
+RecordCursors startRecording(const SensorBus &bus);
+
+/**
+ * @brief Logs every sample pushed on the sensor bus since the previous call into flight log blocks.
+ *
+ * Each full block is handed to @p sink and the next block of the session
+ * is begun. A TransitionSample is logged before each control sample whose
+ * FSM state differs from the previous one. Samples a ring overwrote before
+ * they were logged are counted in the cursors' dropped fields.
+ *
+ * @param bus Sensor bus to log.
+ * @param cursors Position of the log in each ring.
+ * @param block Block being filled, begun with the session's identifier.
+ * @param sink Receives each completed block.
+ * @return Number of blocks handed to @p sink.
+ */
+uint32_t recordStep(const SensorBus &bus, RecordCursors &cursors, FlightLogBlock &block, FlightLogSink &sink);
+
+#endif
@@ -0,0 +1,140 @@
+#include "ControlLoop.h"
+#include "HAL.h"
+
+/** @brief General-purpose timers handed out so far, two per group. */
+static uint8_t timersInUse = 0;
+
+/** @brief Release timer ticks per second, from the 80 MHz APB clock. */
+static const uint32_t TIMER_DIVIDER = 80;
+
+/**
+ * @brief Constructor for the ControlLoop class.
+ * @param name Name of the loop task.
+ * @param rateHz Loop rate in hertz.
+ * @param step Function called once per cycle.
+ * @param context Argument passed to @p step.
+ */
+ControlLoop::ControlLoop(const char *name, uint32_t rateHz, StepFunction step, void *context)
+    : name(name), periodMicros(1000000 / rateHz), step(step), context(context), timerGroup(TIMER_GROUP_0),
+      timerIndex(TIMER_0), task(NULL), monitor(1000000 / rateHz) {}
+
+/**
+ * @brief Creates the loop task and starts the timer.
+ * @param priority FreeRTOS priority of the loop task.
+ * @param core Core the loop task is pinned to.
+ * @param stackSize Stack size of the loop task in bytes.
+ * @return True if the task and timer were started.
+ */
+bool ControlLoop::begin(UBaseType_t priority, BaseType_t core, uint32_t stackSize)
+{
+    if (timersInUse >= TIMER_GROUP_MAX * TIMER_MAX) {
+        Serial.println("No timer left for the control loop.");
+        return false;
+    }
+    timerGroup = (timer_group_t)(timersInUse / TIMER_MAX);
+    timerIndex = (timer_idx_t)(timersInUse % TIMER_MAX);
+
+    // Counts microseconds and reloads at every alarm, so releases stay one period apart
+    timer_config_t config = {};
+    config.alarm_en = TIMER_ALARM_EN;
+    config.counter_en = TIMER_PAUSE;
+    config.intr_type = TIMER_INTR_LEVEL;
+    config.counter_dir = TIMER_COUNT_UP;
+    config.auto_reload = TIMER_AUTORELOAD_EN;
+    config.divider = TIMER_DIVIDER;
+    if (timer_init(timerGroup, timerIndex, &config) != ESP_OK) {
+        Serial.println("Failed to create control loop timer.");
+        return false;
+    }
+    timersInUse++;
+    timer_set_counter_value(timerGroup, timerIndex, 0);
+    timer_set_alarm_value(timerGroup, timerIndex, periodMicros);
+    timer_enable_intr(timerGroup, timerIndex);
+
+    // The task attaches and starts the timer itself, so the interrupt runs on its core and
+    // no release arrives before it is waiting
+    if (xTaskCreatePinnedToCore(loopTask, name, stackSize, this, priority, &task, core) != pdPASS) {
+        Serial.println("Failed to create control loop task.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Gets the name of the loop task.
+ */
+const char *ControlLoop::getName() const
+{
+    return name;
+}
+
+/**
+ * @brief Gets the loop period.
+ * @return The period in microseconds.
+ */
+uint32_t ControlLoop::getPeriodMicros() const
+{
+    return periodMicros;
+}
+
+/**
+ * @brief Gets the timing statistics of the loop.
+ * @return Jitter, execution time and overrun statistics, refreshed ten times per second.
+ */
+LoopStats ControlLoop::getStats() const
+{
+    return stats.get();
+}
+
+/**
+ * @brief Gets the handle of the loop task.
+ */
+TaskHandle_t ControlLoop::getTaskHandle() const
+{
+    return task;
+}
+
+/**
+ * @brief Timer alarm interrupt that releases the loop task.
+ * @param arg Pointer to the ControlLoop instance.
+ * @return True if the release woke a task that should run now.
+ */
+bool IRAM_ATTR ControlLoop::release(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(static_cast<ControlLoop *>(arg)->task, &woken);
+    return woken == pdTRUE;
+}
+
+/**
+ * @brief Loop task entry point.
+ * @param parameter Pointer to the ControlLoop instance.
+ */
+void ControlLoop::loopTask(void *parameter)
+{
+    ControlLoop *loop = static_cast<ControlLoop *>(parameter);
+    const uint32_t publishInterval = 100000 / loop->periodMicros + 1; // About ten snapshots per second
+
+    // In IRAM, so releases keep counting while a flash write holds the cache
+    if (timer_isr_callback_add(loop->timerGroup, loop->timerIndex, release, loop, ESP_INTR_FLAG_IRAM) != ESP_OK) {
+        Serial.println("Failed to attach control loop timer.");
+        vTaskDelete(NULL);
+        return;
+    }
+    int64_t releaseTime = nowMicros();
+    timer_start(loop->timerGroup, loop->timerIndex);
+
+    while (1) {
+        // Each pending notification is one release; more than one means cycles were missed
+        uint32_t releases = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t wake = nowMicros();
+        releaseTime += (int64_t)loop->periodMicros * releases;
+
+        loop->step(loop->context);
+
+        loop->monitor.record(releaseTime, wake, nowMicros(), releases - 1);
+        if (loop->monitor.getStats().cycles % publishInterval == 0) {
+            loop->stats.put(loop->monitor.getStats());
+        }
+    }
+}
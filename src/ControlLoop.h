@@ -0,0 +1,94 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <Arduino.h>
+#include <driver/timer.h>
+#include "LoopMonitor.h"
+#include "LatestValue.h"
+
+/**
+ * @class ControlLoop
+ * @brief Runs a step function at a fixed rate from a pinned, high-priority task.
+ *
+ * A hardware timer's alarm interrupt notifies the loop task at every
+ * release. Because the timer reloads itself rather than counting from when
+ * the task wakes, the period does not drift with execution time, unlike a
+ * vTaskDelay() loop. The interrupt is allocated from the loop task, so it
+ * runs on the loop's own core, and no task on the other core, such as the
+ * esp_timer task below WiFi and lwIP, stands between the alarm and the
+ * release. Every cycle is recorded in a LoopMonitor so jitter and overruns
+ * can be inspected while the robot runs.
+ *
+ * Each loop takes one of the four general-purpose timers.
+ */
+class ControlLoop
+{
+public:
+    typedef void (*StepFunction)(void *context); /**< Function called once per cycle. */
+
+    /**
+     * @brief Constructor for the ControlLoop class.
+     * @param name Name of the loop task.
+     * @param rateHz Loop rate in hertz.
+     * @param step Function called once per cycle.
+     * @param context Argument passed to @p step.
+     */
+    ControlLoop(const char *name, uint32_t rateHz, StepFunction step, void *context = NULL);
+
+    /**
+     * @brief Creates the loop task and starts the timer.
+     * @param priority FreeRTOS priority of the loop task.
+     * @param core Core the loop task is pinned to.
+     * @param stackSize Stack size of the loop task in bytes.
+     * @return True if the task and timer were started.
+     */
+    bool begin(UBaseType_t priority, BaseType_t core, uint32_t stackSize = 4096);
+
+    /**
+     * @brief Gets the name of the loop task.
+     */
+    const char *getName() const;
+
+    /**
+     * @brief Gets the loop period.
+     * @return The period in microseconds.
+     */
+    uint32_t getPeriodMicros() const;
+
+    /**
+     * @brief Gets the timing statistics of the loop.
+     * @return Jitter, execution time and overrun statistics, refreshed ten times per second.
+     */
+    LoopStats getStats() const;
+
+    /**
+     * @brief Gets the handle of the loop task.
+     */
+    TaskHandle_t getTaskHandle() const;
+
+private:
+    const char *name;            /**< Name of the loop task. */
+    uint32_t periodMicros;       /**< Loop period in microseconds. */
+    StepFunction step;           /**< Function called once per cycle. */
+    void *context;               /**< Argument passed to the step function. */
+    timer_group_t timerGroup;    /**< Group of the release timer. */
+    timer_idx_t timerIndex;      /**< Release timer within its group. */
+    TaskHandle_t task;           /**< Loop task notified by the timer. */
+    LoopMonitor monitor;         /**< Per-cycle statistics, owned by the loop task. */
+    LatestValue<LoopStats> stats; /**< Snapshot of the monitor for other tasks. */
+
+    /**
+     * @brief Timer alarm interrupt that releases the loop task.
+     * @param arg Pointer to the ControlLoop instance.
+     * @return True if the release woke a task that should run now.
+     */
+    static bool release(void *arg);
+
+    /**
+     * @brief Loop task entry point.
+     * @param parameter Pointer to the ControlLoop instance.
+     */
+    static void loopTask(void *parameter);
+};
+
+#endif
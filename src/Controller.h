@@ -0,0 +1,259 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Controller structures for balancing, as configured in engineering units.
+ *
+ * Angles are in degrees, rates in degrees per second, positions in meters and
+ * outputs in motor command units. Gains are given as plain floats and
+ * converted once to the controller's scalar type in configure().
+ */
+typedef struct {
+    float kp;               /**< Proportional gain. */
+    float ki;               /**< Integral gain per second. */
+    float kd;               /**< Derivative gain in seconds. */
+    float outputLimit;      /**< Output saturates at plus or minus this value. */
+} PIDGains;
+
+/**
+ * @brief Balance controller modes.
+ */
+enum BalanceMode {
+    BALANCE_CASCADED,       /**< Position, pitch and pitch-rate PID loops in series. */
+    BALANCE_LQR             /**< Full state feedback with precomputed gains. */
+};
+
+/**
+ * @brief Gains of the balance controller.
+ */
+typedef struct {
+    BalanceMode mode;       /**< Which controller structure to run. */
+    PIDGains position;      /**< Outer loop: position error (m) to pitch setpoint (deg). */
+    PIDGains pitch;         /**< Middle loop: pitch error (deg) to pitch-rate setpoint (deg/s). */
+    PIDGains rate;          /**< Inner loop: pitch-rate error (deg/s) to motor command. */
+    float derivativeFilter; /**< Weight of the previous derivative term, 0 (no filter) to below 1. */
+    float lqr[4];           /**< State feedback gains for position, velocity, pitch and pitch rate. */
+    float outputLimit;      /**< Motor command limit in LQR mode. */
+} BalanceGains;
+
+/**
+ * @class PID
+ * @brief PID controller with a filtered derivative and conditional-integration anti-windup.
+ *
+ * The derivative acts on the measurement, not the error, so setpoint steps
+ * do not kick the output. The integrator stops accumulating while the output
+ * is saturated in the direction of the error. The gains are pre-scaled by the
+ * sample time in configure(), so step() is a fixed sequence of multiply-adds
+ * with no division and no allocation.
+ *
+ * @tparam T Scalar type: float, or a Fixed type from FixedPoint.h.
+ */
+template <typename T>
+class PID
+{
+public:
+    PID() : kp(0), kiDt(0), kdOverDt(0), alpha(0), limit(0)
+    {
+        reset();
+    }
+
+    /**
+     * @brief Sets the gains.
+     * @param gains Gains in engineering units.
+     * @param derivativeFilter Weight of the previous derivative term, 0 to below 1.
+     * @param dt Sample time in seconds.
+     */
+    void configure(const PIDGains &gains, float derivativeFilter, float dt)
+    {
+        kp = T(gains.kp);
+        kiDt = T(gains.ki * dt);
+        kdOverDt = T(gains.kd * (1.0f - derivativeFilter) / dt);
+        alpha = T(derivativeFilter);
+        limit = T(gains.outputLimit);
+    }
+
+    /**
+     * @brief Clears the integrator and derivative history.
+     */
+    void reset()
+    {
+        integral = T(0);
+        derivative = T(0);
+        lastMeasurement = T(0);
+        primed = false;
+    }
+
+    /**
+     * @brief Runs one sample of the controller.
+     * @param setpoint Desired value.
+     * @param measurement Measured value.
+     * @return Controller output, limited to plus or minus the output limit.
+     */
+    T step(T setpoint, T measurement)
+    {
+        T error = setpoint - measurement;
+        if (!primed) {
+            lastMeasurement = measurement;
+            primed = true;
+        }
+        derivative = alpha * derivative - kdOverDt * (measurement - lastMeasurement);
+        lastMeasurement = measurement;
+
+        T proportional = kp * error;
+        T candidate = integral + kiDt * error;
+        T output = proportional + candidate + derivative;
+        if ((output > limit && error > T(0)) || (output < -limit && error < T(0))) {
+            output = proportional + integral + derivative;
+        } else {
+            integral = clamp(candidate, -limit, limit);
+        }
+        return clamp(output, -limit, limit);
+    }
+
+    /**
+     * @brief Limits a value to a range.
+     */
+    static T clamp(T value, T low, T high)
+    {
+        return value < low ? low : (value > high ? high : value);
+    }
+
+private:
+    T kp, kiDt, kdOverDt, alpha, limit;
+    T integral, derivative, lastMeasurement;
+    bool primed;
+};
+
+/**
+ * @class BalanceController
+ * @brief Balance controller for a wheeled inverted pendulum.
+ *
+ * In cascaded mode the position loop sets a pitch setpoint, the pitch loop
+ * sets a pitch-rate setpoint and the pitch-rate loop sets the motor command.
+ * In LQR mode the command is a weighted sum of the four state errors. Both
+ * modes take a fixed number of operations every step. The wheel velocity
+ * used by the LQR gains is either supplied by the caller or estimated from
+ * successive positions.
+ *
+ * @tparam T Scalar type: float, or a Fixed type from FixedPoint.h.
+ */
+template <typename T>
+class BalanceController
+{
+public:
+    BalanceController()
+        : mode(BALANCE_CASCADED), positionSetpoint(0), lqrLimit(0), inverseDt(0), velocityAlpha(0), velocityGain(0)
+    {
+        for (int i = 0; i < 4; i++) {
+            lqr[i] = T(0);
+        }
+    }
+
+    /**
+     * @brief Sets the gains and clears the controller state.
+     * @param gains Gains in engineering units.
+     * @param dt Sample time in seconds.
+     */
+    void configure(const BalanceGains &gains, float dt)
+    {
+        mode = gains.mode;
+        positionLoop.configure(gains.position, gains.derivativeFilter, dt);
+        pitchLoop.configure(gains.pitch, gains.derivativeFilter, dt);
+        rateLoop.configure(gains.rate, gains.derivativeFilter, dt);
+        for (int i = 0; i < 4; i++) {
+            lqr[i] = T(gains.lqr[i]);
+        }
+        lqrLimit = T(gains.outputLimit);
+        inverseDt = T(1.0f / dt);
+        velocityAlpha = T(gains.derivativeFilter);
+        velocityGain = T(1.0f - gains.derivativeFilter);
+        reset();
+    }
+
+    /**
+     * @brief Clears the integrators, derivative filters and velocity estimate.
+     */
+    void reset()
+    {
+        positionLoop.reset();
+        pitchLoop.reset();
+        rateLoop.reset();
+        velocity = T(0);
+        lastPosition = T(0);
+        primed = false;
+    }
+
+    /**
+     * @brief Gets the filtered wheel velocity in meters per second.
+     */
+    T getVelocity() const
+    {
+        return velocity;
+    }
+
+    /**
+     * @brief Sets the position to hold, in meters.
+     */
+    void setPositionSetpoint(T position)
+    {
+        positionSetpoint = position;
+    }
+
+    /**
+     * @brief Runs one sample of the controller.
+     * @param position Wheel position in meters.
+     * @param pitch Pitch in degrees, leaning forward positive.
+     * @param pitchRate Pitch rate in degrees per second.
+     * @return Motor command, positive driving forward.
+     */
+    T step(T position, T pitch, T pitchRate)
+    {
+        // Wheel velocity from the position difference, low-pass filtered like the derivative terms
+        if (!primed) {
+            lastPosition = position;
+            primed = true;
+        }
+        T difference = (position - lastPosition) * inverseDt;
+        lastPosition = position;
+        return step(position, difference, pitch, pitchRate);
+    }
+
+    /**
+     * @brief Runs one sample of the controller with a measured wheel velocity.
+     * @param position Wheel position in meters.
+     * @param wheelVelocity Wheel velocity in meters per second, e.g. from Odometry; low-pass
+     *        filtered like the derivative terms before use.
+     * @param pitch Pitch in degrees, leaning forward positive.
+     * @param pitchRate Pitch rate in degrees per second.
+     * @return Motor command, positive driving forward.
+     */
+    T step(T position, T wheelVelocity, T pitch, T pitchRate)
+    {
+        velocity = velocityAlpha * velocity + velocityGain * wheelVelocity;
+        if (mode == BALANCE_LQR) {
+            T command = lqr[0] * (position - positionSetpoint) + lqr[1] * velocity + lqr[2] * pitch +
+                        lqr[3] * pitchRate;
+            return PID<T>::clamp(command, -lqrLimit, lqrLimit);
+        }
+
+        // Leaning back makes the robot drive back, so a position error maps directly to a lean
+        T pitchSetpoint = positionLoop.step(positionSetpoint, position);
+        T rateSetpoint = pitchLoop.step(pitchSetpoint, pitch);
+        // Falling forward faster than wanted needs the wheels driven forward, hence the sign
+        return -rateLoop.step(rateSetpoint, pitchRate);
+    }
+
+private:
+    BalanceMode mode;
+    PID<T> positionLoop, pitchLoop, rateLoop;
+    T positionSetpoint;
+    T lqr[4];
+    T lqrLimit;
+    T inverseDt, velocityAlpha, velocityGain;
+    T velocity, lastPosition;
+    bool primed;
+};
+
+#endif
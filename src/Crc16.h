@@ -0,0 +1,30 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF) of a byte buffer.
+ *
+ * Bitwise rather than table driven, so it costs no flash for a table; pass
+ * the previous result as @p crc to continue over several buffers.
+ *
+ * @param data Bytes to check.
+ * @param length Number of bytes.
+ * @param crc Running CRC, 0xFFFF for a new computation.
+ * @return The updated CRC.
+ */
+inline uint16_t crc16(const void *data, size_t length, uint16_t crc = 0xFFFF)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)bytes[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+#endif
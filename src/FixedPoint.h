@@ -0,0 +1,147 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+/**
+ * @class Fixed
+ * @brief Saturating signed fixed-point number with @p FracBits fractional bits.
+ *
+ * Arithmetic is done in the @p Wide type and saturates to the range of
+ * @p Storage instead of wrapping, so a controller driven out of range clips
+ * like its float counterpart. Every operation is a handful of integer
+ * instructions with no branches on data other than the saturation checks.
+ *
+ * @tparam FracBits Number of fractional bits.
+ * @tparam Storage Signed integer type holding the raw value.
+ * @tparam Wide Signed integer type at least twice as wide as @p Storage.
+ */
+template <int FracBits, typename Storage = int32_t, typename Wide = int64_t>
+class Fixed
+{
+public:
+    static_assert(FracBits > 0 && FracBits < (int)(sizeof(Storage) * 8), "FracBits must fit in Storage");
+    static_assert(sizeof(Wide) >= 2 * sizeof(Storage), "Wide must be twice as wide as Storage");
+
+    constexpr Fixed() : raw(0) {}
+
+    /**
+     * @brief Converts from floating point, saturating out-of-range values.
+     */
+    constexpr Fixed(float value) : raw(fromFloat(value)) {}
+
+    /**
+     * @brief Converts from double precision, saturating out-of-range values.
+     */
+    constexpr Fixed(double value) : raw(fromDouble(value)) {}
+
+    /**
+     * @brief Converts from an integer, saturating out-of-range values.
+     */
+    constexpr Fixed(int value) : raw(saturate((Wide)value * ONE)) {}
+
+    /**
+     * @brief Creates a value from its raw representation.
+     */
+    static constexpr Fixed fromRaw(Storage value)
+    {
+        return Fixed(value, RawTag());
+    }
+
+    /**
+     * @brief Gets the raw representation.
+     */
+    constexpr Storage getRaw() const
+    {
+        return raw;
+    }
+
+    /**
+     * @brief Converts to floating point.
+     */
+    constexpr explicit operator float() const
+    {
+        return (float)raw * (1.0f / (float)ONE);
+    }
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b)
+    {
+        return fromRaw(saturate((Wide)a.raw + b.raw));
+    }
+
+    friend constexpr Fixed operator-(Fixed a, Fixed b)
+    {
+        return fromRaw(saturate((Wide)a.raw - b.raw));
+    }
+
+    friend constexpr Fixed operator-(Fixed a)
+    {
+        return fromRaw(saturate(-(Wide)a.raw));
+    }
+
+    friend constexpr Fixed operator*(Fixed a, Fixed b)
+    {
+        // Round to nearest rather than truncating toward minus infinity
+        return fromRaw(saturate(((Wide)a.raw * b.raw + HALF) >> FracBits));
+    }
+
+    friend constexpr Fixed operator/(Fixed a, Fixed b)
+    {
+        return b.raw == 0 ? fromRaw(a.raw < 0 ? MIN : MAX)
+                          : fromRaw(saturate(((Wide)a.raw * ONE) / b.raw));
+    }
+
+    Fixed &operator+=(Fixed other) { return *this = *this + other; }
+    Fixed &operator-=(Fixed other) { return *this = *this - other; }
+    Fixed &operator*=(Fixed other) { return *this = *this * other; }
+
+    friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+    friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+    friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+    friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+
+private:
+    struct RawTag {};
+
+    static constexpr Wide ONE = (Wide)1 << FracBits;
+    static constexpr Wide HALF = (Wide)1 << (FracBits - 1);
+    static constexpr Storage MAX = (Storage)(((Wide)1 << (sizeof(Storage) * 8 - 1)) - 1);
+    static constexpr Storage MIN = (Storage)(-MAX - 1);
+
+    Storage raw; /**< Value times 2^FracBits. */
+
+    constexpr Fixed(Storage value, RawTag) : raw(value) {}
+
+    static constexpr Storage saturate(Wide value)
+    {
+        return value > MAX ? MAX : (value < MIN ? MIN : (Storage)value);
+    }
+
+    // Single precision on purpose: the ESP32 FPU has no double support
+    static constexpr Storage fromFloat(float value)
+    {
+        return value * (float)ONE >= (float)MAX ? MAX
+             : (value * (float)ONE <= (float)MIN ? MIN
+             : (Storage)(value * (float)ONE + (value < 0 ? -0.5f : 0.5f)));
+    }
+
+    static constexpr Storage fromDouble(double value)
+    {
+        return value * ONE >= (double)MAX ? MAX
+             : (value * ONE <= (double)MIN ? MIN
+             : (Storage)(value * ONE + (value < 0 ? -0.5 : 0.5)));
+    }
+};
+
+/** @brief Q15: 16-bit signal normalized to [-1, 1). */
+typedef Fixed<15, int16_t, int32_t> Q15;
+
+/** @brief Q31: 32-bit signal normalized to [-1, 1). */
+typedef Fixed<31, int32_t, int64_t> Q31;
+
+/** @brief Q15.16: 32-bit value in [-32768, 32768) with a resolution of 1.5e-5. */
+typedef Fixed<16, int32_t, int64_t> Q16;
+
+#endif
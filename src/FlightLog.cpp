@@ -0,0 +1,377 @@
+/** @file FlightLog.cpp
+ *  @brief Implementation of the flight log block format.
+ */
+
+#include "FlightLog.h"
+
+#include <string.h>
+
+#include "Crc16.h"
+#include "Varint.h"
+
+/** @brief Largest record, limited by its length byte. */
+static const size_t MAX_RECORD_SIZE = 255;
+
+static void putU16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void putU32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static uint16_t getU16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t *putInt(uint8_t *p, int64_t value) {
+    return p + putVarint(p, value);
+}
+
+static uint8_t *putDelta(uint8_t *p, int64_t value, int64_t &previous) {
+    p += putVarint(p, (int64_t)((uint64_t)value - (uint64_t)previous));
+    previous = value;
+    return p;
+}
+
+static uint8_t *putFloat(uint8_t *p, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    putU32(p, bits);
+    return p + 4;
+}
+
+// Read position within one record; ok turns false once a field runs past the record
+struct FieldReader {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok;
+};
+
+static int64_t getInt(FieldReader &in) {
+    int64_t value = 0;
+    size_t used = in.ok ? getVarint(in.p, in.end, value) : 0;
+    if (used == 0) {
+        in.ok = false;
+        return 0;
+    }
+    in.p += used;
+    return value;
+}
+
+static int64_t getDelta(FieldReader &in, int64_t &previous) {
+    previous = (int64_t)((uint64_t)previous + (uint64_t)getInt(in));
+    return previous;
+}
+
+static float getFloat(FieldReader &in) {
+    if (!in.ok || in.end - in.p < 4) {
+        in.ok = false;
+        return 0.0f;
+    }
+    uint32_t bits = getU32(in.p);
+    in.p += 4;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+FlightLogBlock::FlightLogBlock() {
+    begin(0, 0);
+}
+
+void FlightLogBlock::begin(uint32_t session, uint32_t sequence) {
+    this->session = session;
+    this->sequence = sequence;
+    length = FLIGHT_LOG_HEADER_SIZE;
+    memset(previous, 0, sizeof(previous));
+}
+
+bool FlightLogBlock::add(const ImuSample &sample) {
+    uint8_t record[MAX_RECORD_SIZE];
+    int64_t last[FLIGHT_LOG_DELTA_FIELDS];
+    memcpy(last, previous[RECORD_IMU], sizeof(last));
+    uint8_t *p = record;
+    p = putDelta(p, sample.timestamp, last[0]);
+    p = putFloat(p, sample.pitch);
+    p = putFloat(p, sample.pitchRate);
+    return append(RECORD_IMU, record, p - record, last);
+}
+
+bool FlightLogBlock::add(const EncoderSample &sample) {
+    uint8_t record[MAX_RECORD_SIZE];
+    int64_t last[FLIGHT_LOG_DELTA_FIELDS];
+    memcpy(last, previous[RECORD_ENCODER], sizeof(last));
+    uint8_t *p = record;
+    p = putDelta(p, sample.timestamp, last[0]);
+    p = putDelta(p, sample.left, last[1]);
+    p = putDelta(p, sample.right, last[2]);
+    return append(RECORD_ENCODER, record, p - record, last);
+}
+
+bool FlightLogBlock::add(const TofFrame &frame) {
+    uint8_t record[MAX_RECORD_SIZE];
+    int64_t last[FLIGHT_LOG_DELTA_FIELDS];
+    memcpy(last, previous[RECORD_TOF], sizeof(last));
+    uint8_t count = frame.count < TOF_MAX_TARGETS ? frame.count : TOF_MAX_TARGETS;
+    uint8_t *p = record;
+    p = putDelta(p, frame.timestamp, last[0]);
+    p = putInt(p, count);
+    for (uint8_t i = 0; i < count; i++) {
+        const TofTarget &target = frame.targets[i];
+        p = putInt(p, target.distance);
+        p = putInt(p, target.status);
+        p = putFloat(p, target.signalRate);
+        p = putFloat(p, target.sigma);
+    }
+    return append(RECORD_TOF, record, p - record, last);
+}
+
+bool FlightLogBlock::add(const GpsSample &sample) {
+    uint8_t record[MAX_RECORD_SIZE];
+    int64_t last[FLIGHT_LOG_DELTA_FIELDS];
+    memcpy(last, previous[RECORD_GPS], sizeof(last));
+    const GpsFix &fix = sample.fix;
+    uint8_t *p = record;
+    p = putDelta(p, sample.timestamp, last[0]);
+    p = putInt(p, fix.utcMillis);
+    p = putInt(p, fix.date);
+    p = putDelta(p, fix.latitude, last[1]);
+    p = putDelta(p, fix.longitude, last[2]);
+    p = putDelta(p, fix.altitude, last[3]);
+    p = putInt(p, fix.speed);
+    p = putInt(p, fix.course);
+    p = putInt(p, fix.hdop);
+    p = putInt(p, fix.fixQuality);
+    p = putInt(p, fix.satellites);
+    p = putInt(p, fix.valid);
+    return append(RECORD_GPS, record, p - record, last);
+}
+
+bool FlightLogBlock::add(const CommandSample &sample) {
+    uint8_t record[MAX_RECORD_SIZE];
+    int64_t last[FLIGHT_LOG_DELTA_FIELDS];
+    memcpy(last, previous[RECORD_COMMAND], sizeof(last));
+    const Command &command = sample.command;
+    uint8_t *p = record;
+    p = putDelta(p, sample.timestamp, last[0]);
+    p = putInt(p, command.type);
+    p = putInt(p, command.state);
+    p = putInt(p, command.stage);
+    for (int i = 0; i < 4; i++) {
+        p = putFloat(p, command.values[i]);
+    }
+    p = putInt(p, sample.timestamp - command.receivedAt);
+    return append(RECORD_COMMAND, record, p - record, last);
+}
+
+bool FlightLogBlock::add(const ControlSample &sample) {
+    uint8_t record[MAX_RECORD_SIZE];
+    int64_t last[FLIGHT_LOG_DELTA_FIELDS];
+    memcpy(last, previous[RECORD_CONTROL], sizeof(last));
+    uint8_t *p = record;
+    p = putDelta(p, sample.timestamp, last[0]);
+    p = putInt(p, sample.state);
+    p = putFloat(p, sample.leftSetpoint);
+    p = putFloat(p, sample.rightSetpoint);
+    p = putInt(p, sample.timestamp - sample.imuTimestamp);
+    p = putInt(p, sample.timestamp - sample.encoderTimestamp);
+    p = putInt(p, sample.timestamp - sample.obstacleTimestamp);
+    p = putInt(p, sample.timestamp - sample.gpsTimestamp);
+    return append(RECORD_CONTROL, record, p - record, last);
+}
+
+bool FlightLogBlock::add(const TransitionSample &sample) {
+    uint8_t record[MAX_RECORD_SIZE];
+    int64_t last[FLIGHT_LOG_DELTA_FIELDS];
+    memcpy(last, previous[RECORD_TRANSITION], sizeof(last));
+    uint8_t *p = record;
+    p = putDelta(p, sample.timestamp, last[0]);
+    p = putInt(p, sample.from);
+    p = putInt(p, sample.to);
+    return append(RECORD_TRANSITION, record, p - record, last);
+}
+
+bool FlightLogBlock::isEmpty() const {
+    return length == FLIGHT_LOG_HEADER_SIZE;
+}
+
+uint32_t FlightLogBlock::getSession() const {
+    return session;
+}
+
+uint32_t FlightLogBlock::getSequence() const {
+    return sequence;
+}
+
+const uint8_t *FlightLogBlock::finish() {
+    putU32(data, FLIGHT_LOG_MAGIC);
+    data[4] = FLIGHT_LOG_VERSION;
+    data[5] = 0;
+    putU16(data + 6, (uint16_t)(length - FLIGHT_LOG_HEADER_SIZE));
+    putU32(data + 8, session);
+    putU32(data + 12, sequence);
+    uint16_t crc = crc16(data, 16);
+    crc = crc16(data + FLIGHT_LOG_HEADER_SIZE, length - FLIGHT_LOG_HEADER_SIZE, crc);
+    putU16(data + 16, crc);
+    putU16(data + 18, 0);
+    memset(data + length, 0xFF, FLIGHT_LOG_BLOCK_SIZE - length);
+    return data;
+}
+
+bool FlightLogBlock::append(uint8_t type, const uint8_t *record, size_t size, const int64_t *last) {
+    if (length + 2 + size > FLIGHT_LOG_BLOCK_SIZE) {
+        return false;
+    }
+    data[length] = type;
+    data[length + 1] = (uint8_t)size;
+    memcpy(data + length + 2, record, size);
+    length += 2 + size;
+    memcpy(previous[type], last, sizeof(previous[type]));
+    return true;
+}
+
+FlightLogReader::FlightLogReader() : block(NULL), offset(0), end(0) {
+    memset(previous, 0, sizeof(previous));
+}
+
+bool FlightLogReader::load(const uint8_t *block) {
+    this->block = block;
+    offset = end = FLIGHT_LOG_HEADER_SIZE;
+    memset(previous, 0, sizeof(previous));
+    if (getU32(block) != FLIGHT_LOG_MAGIC || block[4] != FLIGHT_LOG_VERSION) {
+        return false;
+    }
+    size_t used = getU16(block + 6);
+    if (used > FLIGHT_LOG_BLOCK_SIZE - FLIGHT_LOG_HEADER_SIZE) {
+        return false;
+    }
+    uint16_t crc = crc16(block, 16);
+    crc = crc16(block + FLIGHT_LOG_HEADER_SIZE, used, crc);
+    if (crc != getU16(block + 16)) {
+        return false;
+    }
+    end = FLIGHT_LOG_HEADER_SIZE + used;
+    return true;
+}
+
+uint32_t FlightLogReader::getSession() const {
+    return getU32(block + 8);
+}
+
+uint32_t FlightLogReader::getSequence() const {
+    return getU32(block + 12);
+}
+
+bool FlightLogReader::next(FlightRecord &record) {
+    while (offset + 2 <= end) {
+        uint8_t type = block[offset];
+        size_t size = block[offset + 1];
+        if (offset + 2 + size > end) {
+            break;
+        }
+        FieldReader in = {block + offset + 2, block + offset + 2 + size, true};
+        offset += 2 + size;
+        if (type == 0 || type >= RECORD_TYPE_COUNT) {
+            continue;
+        }
+
+        memset(&record, 0, sizeof(record));
+        record.type = type;
+        int64_t *last = previous[type];
+        switch (type) {
+            case RECORD_IMU:
+                record.imu.timestamp = getDelta(in, last[0]);
+                record.imu.pitch = getFloat(in);
+                record.imu.pitchRate = getFloat(in);
+                break;
+
+            case RECORD_ENCODER:
+                record.encoder.timestamp = getDelta(in, last[0]);
+                record.encoder.left = getDelta(in, last[1]);
+                record.encoder.right = getDelta(in, last[2]);
+                break;
+
+            case RECORD_TOF: {
+                TofFrame &frame = record.tof;
+                frame.timestamp = getDelta(in, last[0]);
+                int64_t count = getInt(in);
+                if (count < 0 || count > TOF_MAX_TARGETS) {
+                    in.ok = false;
+                    break;
+                }
+                frame.count = (uint8_t)count;
+                for (uint8_t i = 0; i < frame.count; i++) {
+                    frame.targets[i].distance = (uint16_t)getInt(in);
+                    frame.targets[i].status = (uint8_t)getInt(in);
+                    frame.targets[i].signalRate = getFloat(in);
+                    frame.targets[i].sigma = getFloat(in);
+                }
+                break;
+            }
+
+            case RECORD_GPS: {
+                GpsFix &fix = record.gps.fix;
+                record.gps.timestamp = getDelta(in, last[0]);
+                fix.utcMillis = (uint32_t)getInt(in);
+                fix.date = (uint32_t)getInt(in);
+                fix.latitude = (int32_t)getDelta(in, last[1]);
+                fix.longitude = (int32_t)getDelta(in, last[2]);
+                fix.altitude = (int32_t)getDelta(in, last[3]);
+                fix.speed = (uint32_t)getInt(in);
+                fix.course = (uint16_t)getInt(in);
+                fix.hdop = (uint16_t)getInt(in);
+                fix.fixQuality = (uint8_t)getInt(in);
+                fix.satellites = (uint8_t)getInt(in);
+                fix.valid = getInt(in) != 0;
+                break;
+            }
+
+            case RECORD_COMMAND: {
+                Command &command = record.command.command;
+                record.command.timestamp = getDelta(in, last[0]);
+                command.type = (uint8_t)getInt(in);
+                command.state = (uint8_t)getInt(in);
+                command.stage = (uint8_t)getInt(in);
+                for (int i = 0; i < 4; i++) {
+                    command.values[i] = getFloat(in);
+                }
+                command.receivedAt = record.command.timestamp - getInt(in);
+                break;
+            }
+
+            case RECORD_CONTROL: {
+                ControlSample &control = record.control;
+                control.timestamp = getDelta(in, last[0]);
+                control.state = (uint8_t)getInt(in);
+                control.leftSetpoint = getFloat(in);
+                control.rightSetpoint = getFloat(in);
+                control.imuTimestamp = control.timestamp - getInt(in);
+                control.encoderTimestamp = control.timestamp - getInt(in);
+                control.obstacleTimestamp = control.timestamp - getInt(in);
+                control.gpsTimestamp = control.timestamp - getInt(in);
+                break;
+            }
+
+            case RECORD_TRANSITION:
+                record.transition.timestamp = getDelta(in, last[0]);
+                record.transition.from = (uint8_t)getInt(in);
+                record.transition.to = (uint8_t)getInt(in);
+                break;
+        }
+        if (!in.ok) {
+            break;
+        }
+        return true;
+    }
+    offset = end;
+    return false;
+}
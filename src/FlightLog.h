@@ -0,0 +1,215 @@
+/** @file FlightLog.h
+ *  @brief Flight log format: CRC-framed blocks of compact sensor, command and controller records.
+ */
+
+#ifndef FLIGHT_LOG_H
+#define FLIGHT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorBus.h"
+
+/** @brief Size of every log block in bytes, a multiple of the flash page and LittleFS block sizes. */
+static const size_t FLIGHT_LOG_BLOCK_SIZE = 4096;
+
+/** @brief First four bytes of every block, "CBFL" little-endian. */
+static const uint32_t FLIGHT_LOG_MAGIC = 0x4C464243;
+
+/** @brief Log format version. */
+static const uint8_t FLIGHT_LOG_VERSION = 1;
+
+/** @brief Bytes of the block header, before the first record. */
+static const size_t FLIGHT_LOG_HEADER_SIZE = 20;
+
+/** @brief Most delta-coded fields of any record type. */
+static const uint8_t FLIGHT_LOG_DELTA_FIELDS = 4;
+
+/**
+ *  @brief Types of log record.
+ */
+enum FlightRecordType {
+    RECORD_IMU = 1,         /**< ImuSample. */
+    RECORD_ENCODER = 2,     /**< EncoderSample. */
+    RECORD_TOF = 3,         /**< TofFrame. */
+    RECORD_GPS = 4,         /**< GpsSample. */
+    RECORD_COMMAND = 5,     /**< CommandSample. */
+    RECORD_CONTROL = 6,     /**< ControlSample. */
+    RECORD_TRANSITION = 7,  /**< TransitionSample. */
+    RECORD_TYPE_COUNT       /**< One past the last record type. */
+};
+
+/**
+ *  @brief Change of the motor control FSM state.
+ */
+typedef struct {
+    int64_t timestamp;  /**< Time of the first control cycle in the new state, from nowMicros(). */
+    uint8_t from;       /**< ConeBotState before. */
+    uint8_t to;         /**< ConeBotState after. */
+} TransitionSample;
+
+/**
+ *  @brief One decoded log record.
+ */
+typedef struct {
+    uint8_t type;       /**< FlightRecordType, selecting the member of the union. */
+    union {
+        ImuSample imu;
+        EncoderSample encoder;
+        TofFrame tof;
+        GpsSample gps;
+        CommandSample command;
+        ControlSample control;
+        TransitionSample transition;
+    };
+} FlightRecord;
+
+/**
+ *  @class FlightLogBlock
+ *  @brief Packs records into one FLIGHT_LOG_BLOCK_SIZE block.
+ *
+ *  A block is a header followed by records and padded with 0xFF:
+ *
+ *  | Offset | Type | Field                                              |
+ *  |--------|------|----------------------------------------------------|
+ *  | 0      | u32  | FLIGHT_LOG_MAGIC                                   |
+ *  | 4      | u8   | FLIGHT_LOG_VERSION                                 |
+ *  | 5      | u8   | reserved, 0                                        |
+ *  | 6      | u16  | bytes of records                                   |
+ *  | 8      | u32  | session, the same for every block of one log       |
+ *  | 12     | u32  | sequence number of the block within the session    |
+ *  | 16     | u16  | CRC-16/CCITT-FALSE of bytes 0 to 15 and the records |
+ *  | 18     | u16  | reserved, 0                                        |
+ *
+ *  Each record is a type byte, a length byte and the fields of its sample
+ *  in declaration order. Timestamps, encoder counts and GPS coordinates
+ *  are zigzag varints of the change from the previous record of the same
+ *  type in the block, so they usually take one or two bytes. The sample
+ *  timestamps of a ControlSample and the receive time of a Command are
+ *  varints of their age at the record's timestamp. The measurement fields
+ *  of a ControlSample, pitch to velocity, are left out since the sensor
+ *  records its sample timestamps point at hold them; they decode as 0.
+ *  Floats are their four IEEE 754 bytes, so values replay bit for bit, and
+ *  other integers are zigzag varints. A TofFrame holds only its first count
+ *  targets. All multi-byte values are little-endian.
+ *
+ *  Every block decodes on its own, so a damaged block costs only its own
+ *  records. Records of one type are in time order; records of different
+ *  types are interleaved in the order they were logged.
+ */
+class FlightLogBlock {
+public:
+    /**
+     *  @brief Constructor for the FlightLogBlock class.
+     */
+    FlightLogBlock();
+
+    /**
+     *  @brief Empties the block and starts a new one.
+     *  @param session Identifier of the log the block belongs to.
+     *  @param sequence Sequence number of the block in the log.
+     */
+    void begin(uint32_t session, uint32_t sequence);
+
+    /**
+     *  @brief Appends a record if it fits; each overload returns false, leaving the
+     *  block unchanged, if the block has no room for the record.
+     */
+    bool add(const ImuSample &sample);
+    bool add(const EncoderSample &sample);
+    bool add(const TofFrame &frame);
+    bool add(const GpsSample &sample);
+    bool add(const CommandSample &sample);
+    bool add(const ControlSample &sample);
+    bool add(const TransitionSample &sample);
+
+    /**
+     *  @brief Checks if the block holds no records.
+     */
+    bool isEmpty() const;
+
+    /**
+     *  @brief Gets the session passed to begin().
+     */
+    uint32_t getSession() const;
+
+    /**
+     *  @brief Gets the sequence number passed to begin().
+     */
+    uint32_t getSequence() const;
+
+    /**
+     *  @brief Completes the header and padding.
+     *  @return The block, FLIGHT_LOG_BLOCK_SIZE bytes, valid until the next begin().
+     */
+    const uint8_t *finish();
+
+private:
+    uint8_t data[FLIGHT_LOG_BLOCK_SIZE];
+    size_t length;                          /**< Bytes of data written. */
+    uint32_t session;
+    uint32_t sequence;
+    int64_t previous[RECORD_TYPE_COUNT][FLIGHT_LOG_DELTA_FIELDS]; /**< Delta-coded fields of the latest record of each type. */
+
+    bool append(uint8_t type, const uint8_t *record, size_t size, const int64_t *last);
+};
+
+/**
+ *  @class FlightLogSink
+ *  @brief Destination of completed log blocks.
+ */
+class FlightLogSink {
+public:
+    virtual ~FlightLogSink() {}
+
+    /**
+     *  @brief Takes one completed block.
+     *  @param block FLIGHT_LOG_BLOCK_SIZE bytes, only valid during the call.
+     *  @return False if the block was discarded.
+     */
+    virtual bool writeBlock(const uint8_t *block) = 0;
+};
+
+/**
+ *  @class FlightLogReader
+ *  @brief Decodes the records of one block.
+ */
+class FlightLogReader {
+public:
+    /**
+     *  @brief Constructor for the FlightLogReader class; no block is loaded.
+     */
+    FlightLogReader();
+
+    /**
+     *  @brief Checks a block and starts reading its records.
+     *  @param block FLIGHT_LOG_BLOCK_SIZE bytes, kept by the caller until the last next().
+     *  @return False if the block is not an intact block of this version; nothing can be read then.
+     */
+    bool load(const uint8_t *block);
+
+    /**
+     *  @brief Gets the session of the loaded block.
+     */
+    uint32_t getSession() const;
+
+    /**
+     *  @brief Gets the sequence number of the loaded block.
+     */
+    uint32_t getSequence() const;
+
+    /**
+     *  @brief Decodes the next record.
+     *  @param record Receives the record.
+     *  @return False at the end of the block, or if a record is malformed. Records of
+     *          unknown type are skipped.
+     */
+    bool next(FlightRecord &record);
+
+private:
+    const uint8_t *block;
+    size_t offset;                          /**< Offset of the next record. */
+    size_t end;                             /**< End of the records. */
+    int64_t previous[RECORD_TYPE_COUNT][FLIGHT_LOG_DELTA_FIELDS]; /**< Delta-coded fields of the latest record of each type. */
+};
+
+#endif
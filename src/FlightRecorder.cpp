@@ -0,0 +1,277 @@
+#include "FlightRecorder.h"
+
+/**
+ * @brief Constructor for the FlightRecorder class; nothing is started.
+ *
+ * The cursors are taken here rather than in begin(), so the log covers
+ * the bus from the first sample the control path pushes.
+ *
+ * @param bus Sensor bus to record, constructed before the recorder.
+ */
+FlightRecorder::FlightRecorder(const SensorBus &bus)
+    : bus(bus), cursors(startRecording(bus)), flushPending(false), flushTaskHandle(NULL), fileLock(NULL),
+      fileIndex(0), oldestIndex(0), fileBlocks(0), uploadRequested(false), uploading(false), uploadIndex(0),
+      uploadEnd(0), uploadOffset(0), blocks(0), droppedBlocks(0), lostSamples(0), files(0), uploaded(0),
+      maxWriteMicros(0), slowWrites(0) {}
+
+/**
+ * @brief Mounts LittleFS, formatting it if it cannot be mounted, and starts the record and flush tasks.
+ * @param recordConfig Placement of the record task.
+ * @param flushConfig Placement of the flush task, below the record task.
+ * @return True if recording started.
+ */
+bool FlightRecorder::begin(const TaskConfig &recordConfig, const TaskConfig &flushConfig)
+{
+    if (!LittleFS.begin(true)) {
+        Serial.println("Failed to mount LittleFS for the flight log.");
+        return false;
+    }
+    LittleFS.mkdir(LOG_DIR);
+    scanFiles();
+    fileLock = xSemaphoreCreateMutex();
+    block.begin(esp_random(), 0);
+
+    if (xTaskCreatePinnedToCore(flushTask, flushConfig.name, flushConfig.stackSize, this, flushConfig.priority,
+                                &flushTaskHandle, flushConfig.core) != pdPASS ||
+        xTaskCreatePinnedToCore(recordTask, recordConfig.name, recordConfig.stackSize, this, recordConfig.priority,
+                                NULL, recordConfig.core) != pdPASS) {
+        Serial.println("Failed to start flight recorder tasks.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Hands a full block to the flush task; called by recordStep() in the record task.
+ *
+ * The block is copied, so the record task can begin the next one at once.
+ *
+ * @param block FLIGHT_LOG_BLOCK_SIZE bytes.
+ * @return False if the flush task is still writing the previous block and this one was dropped.
+ */
+bool FlightRecorder::writeBlock(const uint8_t *block)
+{
+    if (flushPending) {
+        droppedBlocks++;
+        return false;
+    }
+    memcpy(flushBuffer, block, FLIGHT_LOG_BLOCK_SIZE);
+    flushPending = true;
+    xTaskNotifyGive(flushTaskHandle);
+    return true;
+}
+
+/**
+ * @brief Asks for the closed log files to be uploaded; safe to call from any task.
+ */
+void FlightRecorder::requestUpload()
+{
+    uploadRequested = true;
+}
+
+/**
+ * @brief Publishes the next block of a requested upload, in the MQTT task.
+ * @param mqtt Link to the MQTT broker.
+ * @return True if a message was published.
+ */
+bool FlightRecorder::uploadStep(MQTTInterface &mqtt)
+{
+    if (!uploading) {
+        if (!uploadRequested.exchange(false)) {
+            return false;
+        }
+        xSemaphoreTake(fileLock, portMAX_DELAY);
+        uploadIndex = oldestIndex;
+        uploadEnd = fileIndex;
+        xSemaphoreGive(fileLock);
+        uploadOffset = 0;
+        uploading = true;
+    }
+    if (!mqtt.connected()) {
+        return false;
+    }
+
+    // Files are only opened and deleted under the lock, so one cannot vanish while a block is read
+    bool haveBlock = false;
+    char path[24];
+    xSemaphoreTake(fileLock, portMAX_DELAY);
+    while (!haveBlock && uploadIndex < uploadEnd) {
+        if (uploadIndex < oldestIndex) {
+            uploadIndex = oldestIndex;
+            uploadOffset = 0;
+            continue;
+        }
+        filePath(uploadIndex, path, sizeof(path));
+        File log = LittleFS.exists(path) ? LittleFS.open(path, FILE_READ) : File();
+        haveBlock = log && log.seek(uploadOffset) &&
+                    log.read(uploadBuffer, FLIGHT_LOG_BLOCK_SIZE) == FLIGHT_LOG_BLOCK_SIZE;
+        if (log) {
+            log.close();
+        }
+        if (!haveBlock) {
+            uploadIndex++;
+            uploadOffset = 0;
+        }
+    }
+    xSemaphoreGive(fileLock);
+
+    if (!haveBlock) {
+        // An empty message marks the end of the upload
+        if (!mqtt.publish("bot/log", uploadBuffer, 0)) {
+            return false;
+        }
+        uploading = false;
+        return true;
+    }
+    if (!mqtt.publish("bot/log", uploadBuffer, FLIGHT_LOG_BLOCK_SIZE)) {
+        return false;
+    }
+    uploadOffset += FLIGHT_LOG_BLOCK_SIZE;
+    uploaded++;
+    return true;
+}
+
+/**
+ * @brief Gets the counters.
+ */
+FlightRecorderStats FlightRecorder::getStats() const
+{
+    FlightRecorderStats stats;
+    stats.blocks = blocks;
+    stats.droppedBlocks = droppedBlocks;
+    stats.lostSamples = lostSamples;
+    stats.files = files;
+    stats.uploaded = uploaded;
+    stats.maxWriteMicros = maxWriteMicros;
+    stats.slowWrites = slowWrites;
+    return stats;
+}
+
+/**
+ * @brief Finds the oldest and newest log files kept from earlier runs.
+ *
+ * The file written next is numbered one past the newest, so the numbers
+ * keep increasing across boots.
+ */
+void FlightRecorder::scanFiles()
+{
+    bool found = false;
+    uint32_t oldest = 0, newest = 0;
+    File dir = LittleFS.open(LOG_DIR);
+    if (dir && dir.isDirectory()) {
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+            char *end;
+            uint32_t index = strtoul(entry.name(), &end, 10);
+            if (end != entry.name() && strcmp(end, ".cbl") == 0) {
+                oldest = !found || index < oldest ? index : oldest;
+                newest = !found || index > newest ? index : newest;
+                found = true;
+            }
+            entry.close();
+        }
+    }
+    fileIndex = found ? newest + 1 : 0;
+    oldestIndex = found ? oldest : fileIndex;
+}
+
+/**
+ * @brief Closes the file being written, deletes the oldest files until there is room, and starts the next file.
+ * @return True if the new file is open.
+ */
+bool FlightRecorder::startFile()
+{
+    char path[24];
+    xSemaphoreTake(fileLock, portMAX_DELAY);
+    if (file) {
+        file.close();
+        fileIndex++;
+    }
+    while (LittleFS.totalBytes() - LittleFS.usedBytes() < MIN_FREE_BYTES && oldestIndex < fileIndex) {
+        filePath(oldestIndex, path, sizeof(path));
+        if (LittleFS.exists(path)) {
+            LittleFS.remove(path);
+        }
+        oldestIndex++;
+    }
+    filePath(fileIndex, path, sizeof(path));
+    file = LittleFS.open(path, FILE_WRITE);
+    fileBlocks = 0;
+    xSemaphoreGive(fileLock);
+    if (!file) {
+        Serial.printf("Failed to create flight log %s\n", path);
+        return false;
+    }
+    files++;
+    return true;
+}
+
+/**
+ * @brief Writes flushBuffer to the current file, starting a new file when it is full.
+ *
+ * Every write is one whole block at a block-aligned offset, and the file is
+ * synced after it, so a power loss costs at most the block being written.
+ * The time taken is recorded, as the flash cache is off for most of it.
+ */
+void FlightRecorder::flush()
+{
+    int64_t start = esp_timer_get_time();
+    bool written = (file && fileBlocks < FILE_BLOCKS) || startFile();
+    written = written && file.write(flushBuffer, FLIGHT_LOG_BLOCK_SIZE) == FLIGHT_LOG_BLOCK_SIZE;
+    if (written) {
+        file.flush();
+        fileBlocks++;
+        blocks++;
+    } else {
+        droppedBlocks++;
+    }
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    if (elapsed > maxWriteMicros) {
+        maxWriteMicros = elapsed;
+    }
+    if (elapsed > CONTROL_PERIOD_US) {
+        slowWrites++;
+    }
+}
+
+/**
+ * @brief Formats the path of a log file.
+ * @param index Number of the file.
+ * @param path Receives the path.
+ * @param size Size of @p path.
+ */
+void FlightRecorder::filePath(uint32_t index, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%08lu.cbl", LOG_DIR, (unsigned long)index);
+}
+
+/**
+ * @brief Record task entry point, logging the sensor bus every RECORD_PERIOD_MS.
+ * @param parameter Pointer to the FlightRecorder instance.
+ */
+void FlightRecorder::recordTask(void *parameter)
+{
+    FlightRecorder *recorder = static_cast<FlightRecorder *>(parameter);
+    RecordCursors &cursors = recorder->cursors;
+    TickType_t lastWake = xTaskGetTickCount();
+    while (1) {
+        recordStep(recorder->bus, cursors, recorder->block, *recorder);
+        recorder->lostSamples = cursors.imu.dropped + cursors.encoders.dropped + cursors.tof.dropped +
+                                cursors.gps.dropped + cursors.commands.dropped + cursors.control.dropped;
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(RECORD_PERIOD_MS));
+    }
+}
+
+/**
+ * @brief Flush task entry point, writing each block the record task hands over.
+ * @param parameter Pointer to the FlightRecorder instance.
+ */
+void FlightRecorder::flushTask(void *parameter)
+{
+    FlightRecorder *recorder = static_cast<FlightRecorder *>(parameter);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        recorder->flush();
+        recorder->flushPending = false;
+    }
+}
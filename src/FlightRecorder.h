@@ -0,0 +1,175 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include "ConeBot.h"
+#include "TaskConfig.h"
+
+/**
+ * @brief Counters of the flight recorder.
+ */
+typedef struct {
+    uint32_t blocks;        /**< Blocks written to flash. */
+    uint32_t droppedBlocks; /**< Blocks discarded because the previous one was still being written, or the write failed. */
+    uint32_t lostSamples;   /**< Samples the sensor bus overwrote before they were logged. */
+    uint32_t files;         /**< Log files started since boot. */
+    uint32_t uploaded;      /**< Blocks published to "bot/log". */
+    uint32_t maxWriteMicros; /**< Longest time to write and sync one block, including starting a file. */
+    uint32_t slowWrites;    /**< Block writes that took longer than one control period. */
+} FlightRecorderStats;
+
+/**
+ * @class FlightRecorder
+ * @brief Black-box recorder logging the sensor bus to LittleFS, and uploading the log over MQTT on request.
+ *
+ * A record task drains every ring of the sensor bus each RECORD_PERIOD_MS
+ * into a FlightLogBlock (see FlightLog.h), so the control path never
+ * touches the log. A full block is copied to a second buffer and handed to
+ * a flush task at the lowest priority, which writes it as one aligned
+ * FLIGHT_LOG_BLOCK_SIZE write while the record task fills the next block.
+ * If a write is still running when the next block is full, that block is
+ * dropped and counted rather than the record task waiting for flash.
+ *
+ * The priorities do not keep flash from delaying the control path, though.
+ * While LittleFS programs or erases flash, the flash cache is off on both
+ * cores: the other core is held and only IRAM interrupts run, whatever the
+ * task priorities. Each new 4 KB block needs a sector erase, typically
+ * tens of milliseconds, so the control loops can miss cycles during a
+ * flush. The PCNT limit interrupt is in IRAM so encoder wraps are still
+ * carried. The longest block write and the writes longer than a control
+ * period are counted in getStats() and shown by TaskMonitor next to the
+ * loops' jitter.
+ *
+ * Blocks are appended to numbered files under LOG_DIR, each FILE_BLOCKS
+ * long. Before a file is started the oldest files are deleted until
+ * MIN_FREE_BYTES are free, so the log keeps the most recent runs. Each
+ * boot starts a new file and a new random session. The robot records
+ * about 20 KB/s, so the default 1.4 MB partition keeps about the last
+ * minute.
+ */
+class FlightRecorder : public FlightLogSink
+{
+public:
+    /**
+     * @brief Constructor for the FlightRecorder class; nothing is started.
+     *
+     * The log starts with the first sample pushed on @p bus after this, so
+     * a recorder constructed with the bus logs every sample since boot, as
+     * far as the rings hold them until begin().
+     *
+     * @param bus Sensor bus to record, constructed before the recorder.
+     */
+    FlightRecorder(const SensorBus &bus);
+
+    /**
+     * @brief Mounts LittleFS, formatting it if it cannot be mounted, and starts the record and flush tasks.
+     * @param recordConfig Placement of the record task.
+     * @param flushConfig Placement of the flush task, below the record task.
+     * @return True if recording started.
+     */
+    bool begin(const TaskConfig &recordConfig, const TaskConfig &flushConfig);
+
+    /**
+     * @brief Hands a full block to the flush task; called by recordStep() in the record task.
+     * @param block FLIGHT_LOG_BLOCK_SIZE bytes.
+     * @return False if the flush task is still writing the previous block and this one was dropped.
+     */
+    bool writeBlock(const uint8_t *block) override;
+
+    /**
+     * @brief Asks for the closed log files to be uploaded; safe to call from any task.
+     */
+    void requestUpload();
+
+    /**
+     * @brief Publishes the next block of a requested upload, in the MQTT task.
+     *
+     * Every file closed when the upload was requested is sent oldest first,
+     * one block per message on "bot/log" and one block per call, followed by
+     * an empty message marking the end. A block that fails to publish is
+     * retried on the next call.
+     *
+     * @param mqtt Link to the MQTT broker.
+     * @return True if a message was published.
+     */
+    bool uploadStep(MQTTInterface &mqtt);
+
+    /**
+     * @brief Gets the counters.
+     */
+    FlightRecorderStats getStats() const;
+
+private:
+    static constexpr const char *LOG_DIR = "/log";             /**< Directory of the log files. */
+    static const uint32_t FILE_BLOCKS = 64;                    /**< Blocks per log file, 256 KB. */
+    static const size_t MIN_FREE_BYTES = 2 * FILE_BLOCKS * FLIGHT_LOG_BLOCK_SIZE; /**< Free space kept when starting a file. */
+
+    const SensorBus &bus;
+    RecordCursors cursors;              /**< Position of the log on the sensor bus, owned by the record task. */
+    FlightLogBlock block;               /**< Block being filled, owned by the record task. */
+    uint8_t flushBuffer[FLIGHT_LOG_BLOCK_SIZE]; /**< Block being written, owned by the flush task while flushPending. */
+    std::atomic<bool> flushPending;     /**< flushBuffer holds a block the flush task has not written yet. */
+    TaskHandle_t flushTaskHandle;       /**< Flush task, notified with each block. */
+
+    SemaphoreHandle_t fileLock;         /**< Guards opening and deleting log files. */
+    File file;                          /**< File being written, owned by the flush task. */
+    uint32_t fileIndex;                 /**< Number of the file being written, changed under fileLock. */
+    uint32_t oldestIndex;               /**< Number of the oldest file kept, changed under fileLock. */
+    uint32_t fileBlocks;                /**< Blocks in the file being written. */
+
+    std::atomic<bool> uploadRequested;  /**< Set by requestUpload(). */
+    bool uploading;                     /**< An upload is running, owned by the MQTT task. */
+    uint32_t uploadIndex;               /**< File being uploaded. */
+    uint32_t uploadEnd;                 /**< First file not to upload, the one open when the upload was requested. */
+    uint32_t uploadOffset;              /**< Offset of the next block to upload in its file. */
+    uint8_t uploadBuffer[FLIGHT_LOG_BLOCK_SIZE]; /**< Block being uploaded. */
+
+    std::atomic<uint32_t> blocks;
+    std::atomic<uint32_t> droppedBlocks;
+    std::atomic<uint32_t> lostSamples;
+    std::atomic<uint32_t> files;
+    std::atomic<uint32_t> uploaded;
+    std::atomic<uint32_t> maxWriteMicros;
+    std::atomic<uint32_t> slowWrites;
+
+    /**
+     * @brief Finds the oldest and newest log files kept from earlier runs.
+     */
+    void scanFiles();
+
+    /**
+     * @brief Closes the file being written, deletes the oldest files until there is room, and starts the next file.
+     * @return True if the new file is open.
+     */
+    bool startFile();
+
+    /**
+     * @brief Writes flushBuffer to the current file, starting a new file when it is full.
+     */
+    void flush();
+
+    /**
+     * @brief Formats the path of a log file.
+     * @param index Number of the file.
+     * @param path Receives the path.
+     * @param size Size of @p path.
+     */
+    static void filePath(uint32_t index, char *path, size_t size);
+
+    /**
+     * @brief Record task entry point.
+     * @param parameter Pointer to the FlightRecorder instance.
+     */
+    static void recordTask(void *parameter);
+
+    /**
+     * @brief Flush task entry point.
+     * @param parameter Pointer to the FlightRecorder instance.
+     */
+    static void flushTask(void *parameter);
+};
+
+#endif
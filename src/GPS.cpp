@@ -2,107 +2,185 @@
 
 /**
  * @brief Constructor for the GPS class.
- * @param serial Reference to the hardware serial interface for GPS communication.
+ * @param port UART peripheral connected to the GPS module.
+ * @param rxPin GPIO receiving data from the GPS module.
+ * @param txPin GPIO transmitting data to the GPS module.
  * @param baud The baud rate for GPS communication (default: 9600).
  */
-GPS::GPS(HardwareSerial &serial, uint32_t baud)
-    : gpsSerial(serial), gpsBaud(baud), latitude(""), longitude(""),
-      altitude(""), utcTime(""), fixStatus("") {}
+GPS::GPS(uart_port_t port, int rxPin, int txPin, uint32_t baud)
+    : port(port), rxPin(rxPin), txPin(txPin), gpsBaud(baud), eventQueue(NULL), listener(NULL), listenerContext(NULL),
+      droppedBytes(0), overflows(0), fixVersion(0), fix() {}
 
 /**
- * @brief Initialize the GPS module by starting the serial communication.
+ * @brief Set a function the ingest task calls with every new fix; call before begin().
+ * @param listener Function to call, or NULL for none.
+ * @param context Argument passed to @p listener.
  */
-void GPS::begin()
+void GPS::setListener(FixListener listener, void *context)
 {
-    gpsSerial.begin(gpsBaud);
+    this->listener = listener;
+    listenerContext = context;
 }
 
 /**
- * @brief Update the GPS data by reading and parsing an NMEA sentence.
- * @return True if a valid NMEA sentence was parsed; otherwise, false.
+ * @brief Initialize the UART driver and start the ingest task.
+ * @param priority FreeRTOS priority of the ingest task.
+ * @param core Core the ingest task is pinned to.
+ * @param stackSize Stack size of the ingest task in bytes.
+ * @return True if the UART driver and task were started; otherwise, false.
  */
-bool GPS::update()
+bool GPS::begin(UBaseType_t priority, BaseType_t core, uint32_t stackSize)
+{
+    uart_config_t config = {};
+    config.baud_rate = (int)gpsBaud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+
+    if (uart_driver_install(port, RX_BUFFER_SIZE, 0, EVENT_QUEUE_LENGTH, &eventQueue, 0) != ESP_OK ||
+        uart_param_config(port, &config) != ESP_OK ||
+        uart_set_pin(port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+        Serial.println("Failed to start GPS UART driver.");
+        return false;
+    }
+
+    if (xTaskCreatePinnedToCore(ingestTask, "GPSTask", stackSize, this, priority, NULL, core) != pdPASS) {
+        Serial.println("Failed to start GPS task.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Task entry point that waits for UART events and drains the RX buffer.
+ * @param parameter Pointer to the GPS instance.
+ */
+void GPS::ingestTask(void *parameter)
 {
-    while (gpsSerial.available()) {
-        char c = gpsSerial.read();
-        if (c == '\n') { // End of NMEA sentence
-            parseNMEA(nmeaBuffer);
-            nmeaBuffer = ""; // Clear the buffer for the next sentence
-            return true;
-        } else {
-            nmeaBuffer += c;
+    GPS *gps = static_cast<GPS *>(parameter);
+    uart_event_t event;
+    while (1) {
+        if (xQueueReceive(gps->eventQueue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        switch (event.type) {
+            case UART_FIFO_OVF:
+                // The driver resets the hardware FIFO, discarding its contents
+                gps->droppedBytes += SOC_UART_FIFO_LEN;
+                gps->overflows++;
+                break;
+
+            case UART_BUFFER_FULL:
+                // Reception resumes once the ring buffer is drained below
+                gps->overflows++;
+                break;
+
+            default:
+                break;
         }
+        // Every event type is a hint that data may be waiting; consume all of it
+        gps->drain();
     }
-    return false; // No complete sentence received
 }
 
 /**
- * @brief Parse an NMEA sentence to extract GPS data fields.
- * @param nmea The NMEA sentence to parse.
+ * @brief Read every buffered byte, parse it and publish the newest fix.
  */
-void GPS::parseNMEA(const String &nmea)
+void GPS::drain()
 {
-    if (nmea.startsWith("$GPGGA")) { // Parse $GPGGA sentence
-        int fieldIndex = 0;
-        String field;
-        for (int i = 0; i < nmea.length(); i++) {
-            char c = nmea[i];
-            if (c == ',' || i == nmea.length() - 1) {
-                if (fieldIndex == 1) utcTime = field;         // UTC time
-                if (fieldIndex == 2) latitude = field;        // Latitude
-                if (fieldIndex == 4) longitude = field;       // Longitude
-                if (fieldIndex == 6) fixStatus = field;       // Fix status
-                if (fieldIndex == 9) altitude = field;        // Altitude
-                field = "";
-                fieldIndex++;
-            } else {
-                field += c;
-            }
+    char chunk[128];
+    bool decoded = false;
+    int length;
+    while ((length = uart_read_bytes(port, (uint8_t *)chunk, sizeof(chunk), 0)) > 0) {
+        if (parser.encode(chunk, (size_t)length) > 0) {
+            decoded = true;
+        }
+    }
+    if (decoded) {
+        latestFix.put(parser.getFix());
+        if (listener) {
+            listener(parser.getFix(), listenerContext);
         }
     }
+
+    GpsStats current;
+    current.sentences = parser.getSentenceCount();
+    current.droppedSentences = parser.getChecksumErrors() + parser.getOverflowCount();
+    current.droppedBytes = droppedBytes;
+    current.overflows = overflows;
+    stats.put(current);
+}
+
+/**
+ * @brief Fetch the newest fix published by the ingest task.
+ * @return True if a new fix arrived since the previous call; otherwise, false.
+ */
+bool GPS::update()
+{
+    return latestFix.getIfNewer(fix, fixVersion);
+}
+
+/**
+ * @brief Get the most recent fix.
+ * @return The fix assembled from GGA, RMC and VTG sentences.
+ */
+const GpsFix &GPS::getFix() const
+{
+    return fix;
+}
+
+/**
+ * @brief Get the latitude.
+ * @return The latitude in 1e-7 degrees, north positive.
+ */
+int32_t GPS::getLatitude() const
+{
+    return fix.latitude;
 }
 
 /**
- * @brief Get the latitude as a string.
- * @return The latitude in NMEA format.
+ * @brief Get the longitude.
+ * @return The longitude in 1e-7 degrees, east positive.
  */
-String GPS::getLatitude()
+int32_t GPS::getLongitude() const
 {
-    return latitude;
+    return fix.longitude;
 }
 
 /**
- * @brief Get the longitude as a string.
- * @return The longitude in NMEA format.
+ * @brief Get the UTC time.
+ * @return The UTC time of day in milliseconds.
  */
-String GPS::getLongitude()
+uint32_t GPS::getUTC() const
 {
-    return longitude;
+    return fix.utcMillis;
 }
 
 /**
- * @brief Get the UTC time as a string.
- * @return The UTC time in NMEA format.
+ * @brief Get the GPS fix status.
+ * @return The GGA fix quality reported by the GPS module (0 = no fix).
  */
-String GPS::getUTC()
+uint8_t GPS::getFixStatus() const
 {
-    return utcTime;
+    return fix.fixQuality;
 }
 
 /**
- * @brief Get the GPS fix status as a string.
- * @return The fix status from the GPS module.
+ * @brief Get the altitude.
+ * @return The altitude in millimeters as reported by the GPS module.
  */
-String GPS::getFixStatus()
+int32_t GPS::getAltitude() const
 {
-    return fixStatus;
+    return fix.altitude;
 }
 
 /**
- * @brief Get the altitude as a string.
- * @return The altitude in meters as reported by the GPS module.
+ * @brief Get the ingest counters.
+ * @return Sentence and byte counters as of the last drained UART event.
  */
-String GPS::getAltitude()
+GpsStats GPS::getStats() const
 {
-    return altitude;
+    return stats.get();
 }
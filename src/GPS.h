@@ -2,77 +2,139 @@
 #define GPS_H
 
 #include <Arduino.h>
+#include <driver/uart.h>
+#include "NMEAParser.h"
+#include "LatestValue.h"
+#include "HAL.h"
+
+/**
+ * @brief Ingest counters for the GPS UART path.
+ */
+typedef struct {
+    uint32_t sentences;        /**< Sentences received with a valid checksum. */
+    uint32_t droppedSentences; /**< Sentences rejected as corrupt, truncated or too long. */
+    uint32_t droppedBytes;     /**< Bytes discarded by RX FIFO overflows. */
+    uint32_t overflows;        /**< Number of RX FIFO or ring buffer overflow events. */
+} GpsStats;
 
 /**
  * @class GPS
  * @brief A class for interfacing with a GPS module using NMEA sentences.
  * 
  * The GPS class provides methods to read and parse GPS data, including latitude,
- * longitude, altitude, UTC time, and fix status. It communicates with the GPS
- * module via a hardware serial interface.
+ * longitude, altitude, UTC time, and fix status. It installs the ESP-IDF UART
+ * driver and runs its own ingest task, which wakes on UART events, decodes every
+ * complete sentence with an allocation-free NMEAParser and publishes only the
+ * newest fix through a lock-free slot.
  */
-class GPS
+class GPS : public GPSInterface
 {
 public:
+    typedef void (*FixListener)(const GpsFix &fix, void *context); /**< Called by the ingest task with each new fix. */
+
     /**
      * @brief Constructor for the GPS class.
-     * @param serial Reference to the hardware serial interface for GPS communication.
+     * @param port UART peripheral connected to the GPS module.
+     * @param rxPin GPIO receiving data from the GPS module.
+     * @param txPin GPIO transmitting data to the GPS module.
      * @param baud The baud rate for GPS communication (default: 9600).
      */
-    GPS(HardwareSerial &serial, uint32_t baud = 9600);
+    GPS(uart_port_t port, int rxPin, int txPin, uint32_t baud = 9600);
+
+    /**
+     * @brief Set a function the ingest task calls with every new fix; call before begin().
+     * @param listener Function to call, or NULL for none.
+     * @param context Argument passed to @p listener.
+     */
+    void setListener(FixListener listener, void *context = NULL);
+
+    /**
+     * @brief Initialize the UART driver and start the ingest task.
+     * @param priority FreeRTOS priority of the ingest task.
+     * @param core Core the ingest task is pinned to.
+     * @param stackSize Stack size of the ingest task in bytes.
+     * @return True if the UART driver and task were started; otherwise, false.
+     */
+    bool begin(UBaseType_t priority, BaseType_t core, uint32_t stackSize = 3072);
 
     /**
-     * @brief Initialize the GPS module by setting up the serial communication.
+     * @brief Fetch the newest fix published by the ingest task.
+     * @return True if a new fix arrived since the previous call; otherwise, false.
      */
-    void begin();
+    bool update() override;
 
     /**
-     * @brief Update the GPS data by reading and parsing NMEA sentences.
-     * @return True if a valid NMEA sentence was parsed; otherwise, false.
+     * @brief Get the most recent fix.
+     * @return The fix assembled from GGA, RMC and VTG sentences.
      */
-    bool update();
+    const GpsFix &getFix() const override;
 
     /**
-     * @brief Get the latitude as a string.
-     * @return The latitude in NMEA format.
+     * @brief Get the latitude.
+     * @return The latitude in 1e-7 degrees, north positive.
      */
-    String getLatitude();
+    int32_t getLatitude() const;
 
     /**
-     * @brief Get the longitude as a string.
-     * @return The longitude in NMEA format.
+     * @brief Get the longitude.
+     * @return The longitude in 1e-7 degrees, east positive.
      */
-    String getLongitude();
+    int32_t getLongitude() const;
 
     /**
-     * @brief Get the UTC time as a string.
-     * @return The UTC time in NMEA format.
+     * @brief Get the UTC time.
+     * @return The UTC time of day in milliseconds.
      */
-    String getUTC();
+    uint32_t getUTC() const;
 
     /**
-     * @brief Get the GPS fix status as a string.
-     * @return The fix status from the GPS module.
+     * @brief Get the GPS fix status.
+     * @return The GGA fix quality reported by the GPS module (0 = no fix).
      */
-    String getFixStatus();
+    uint8_t getFixStatus() const;
 
     /**
-     * @brief Get the altitude as a string.
-     * @return The altitude in meters as reported by the GPS module.
+     * @brief Get the altitude.
+     * @return The altitude in millimeters as reported by the GPS module.
      */
-    String getAltitude();
+    int32_t getAltitude() const;
+
+    /**
+     * @brief Get the ingest counters.
+     * @return Sentence and byte counters as of the last drained UART event.
+     */
+    GpsStats getStats() const;
 
 private:
-    HardwareSerial &gpsSerial; /**< Reference to the serial port used for GPS communication. */
-    uint32_t gpsBaud;          /**< Baud rate for GPS communication. */
-    String nmeaBuffer;         /**< Buffer to hold the current NMEA sentence. */
-    String latitude, longitude, altitude, utcTime, fixStatus; /**< Parsed GPS data fields. */
+    static const int RX_BUFFER_SIZE = 2048;  /**< UART driver ring buffer size in bytes. */
+    static const int EVENT_QUEUE_LENGTH = 16; /**< UART driver event queue depth. */
+
+    uart_port_t port;             /**< UART peripheral used for GPS communication. */
+    int rxPin;                    /**< GPIO receiving GPS data. */
+    int txPin;                    /**< GPIO transmitting to the GPS module. */
+    uint32_t gpsBaud;             /**< Baud rate for GPS communication. */
+    QueueHandle_t eventQueue;     /**< UART driver event queue. */
+    FixListener listener;         /**< Called with each new fix, or NULL. */
+    void *listenerContext;        /**< Argument passed to the listener. */
+    NMEAParser parser;            /**< Parser owned by the ingest task. */
+    uint32_t droppedBytes;        /**< Bytes lost to FIFO overflows, owned by the ingest task. */
+    uint32_t overflows;           /**< Overflow events, owned by the ingest task. */
+
+    LatestValue<GpsFix> latestFix;  /**< Newest fix, written by the ingest task. */
+    LatestValue<GpsStats> stats;    /**< Ingest counters, written by the ingest task. */
+    uint32_t fixVersion;            /**< Version of latestFix last copied by update(). */
+    GpsFix fix;                     /**< Fix returned by the getters. */
+
+    /**
+     * @brief Task entry point that waits for UART events and drains the RX buffer.
+     * @param parameter Pointer to the GPS instance.
+     */
+    static void ingestTask(void *parameter);
 
     /**
-     * @brief Parse an NMEA sentence to extract GPS data.
-     * @param nmea The NMEA sentence to parse.
+     * @brief Read every buffered byte, parse it and publish the newest fix.
      */
-    void parseNMEA(const String &nmea);
+    void drain();
 };
 
 #endif
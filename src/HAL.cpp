@@ -0,0 +1,48 @@
+/** @file HAL.cpp
+ *  @brief ESP32 implementation of the hardware abstraction functions.
+ */
+
+#include "HAL.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+/** @brief ADC pin sensing the battery through a resistor divider. */
+static const uint8_t BATTERY_SENSE_PIN = 33;
+
+/** @brief Battery voltage per volt at BATTERY_SENSE_PIN. */
+static const float BATTERY_DIVIDER_RATIO = 3.0f;
+
+/** @brief Keeps both encoder reads within one critical section, on either core. */
+static portMUX_TYPE encoderLock = portMUX_INITIALIZER_UNLOCKED;
+
+/** @brief Keeps the duty updates of both motors within one critical section. */
+static portMUX_TYPE driveLock = portMUX_INITIALIZER_UNLOCKED;
+
+int64_t nowMicros() {
+    return esp_timer_get_time();
+}
+
+float readBatteryVoltage() {
+    return analogReadMilliVolts(BATTERY_SENSE_PIN) * 1e-3f * BATTERY_DIVIDER_RATIO;
+}
+
+int64_t sampleEncoders(const MotorInterface &left, const MotorInterface &right, int64_t &leftCount,
+                       int64_t &rightCount) {
+    portENTER_CRITICAL(&encoderLock);
+    int64_t timestamp = esp_timer_get_time();
+    leftCount = left.getPosition();
+    rightCount = right.getPosition();
+    portEXIT_CRITICAL(&encoderLock);
+    return timestamp;
+}
+
+void driveMotors(MotorInterface &left, MotorInterface &right, float leftDuty, float rightDuty) {
+    // Both channels run off one LEDC timer, so duties latched together switch in the same period
+    left.setDuty(leftDuty);
+    right.setDuty(rightDuty);
+    portENTER_CRITICAL(&driveLock);
+    left.applyDuty();
+    right.applyDuty();
+    portEXIT_CRITICAL(&driveLock);
+}
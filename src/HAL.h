@@ -0,0 +1,205 @@
+/** @file HAL.h
+ *  @brief Hardware abstraction interfaces shared by the ESP32 drivers and the native simulation.
+ *
+ *  The control and measurement pipelines only talk to these interfaces, so the
+ *  same code runs against the real peripherals on the robot and against the
+ *  simulated back ends in src/native when built with the PlatformIO native env.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "NMEAParser.h"
+
+/**
+ *  @brief Monotonic time source.
+ *  @return Microseconds since boot on the robot, or simulated time on the native build.
+ */
+int64_t nowMicros();
+
+/**
+ *  @brief Reads the motor supply voltage.
+ *  @return Battery voltage in V.
+ */
+float readBatteryVoltage();
+
+/**
+ *  @class MotorInterface
+ *  @brief A drive motor with an incremental encoder.
+ */
+class MotorInterface {
+public:
+    virtual ~MotorInterface() {}
+
+    /**
+     *  @brief Prepares a new duty; it reaches the motor at the next applyDuty().
+     *  @param duty Duty from -1 to 1, forward positive.
+     */
+    virtual void setDuty(float duty) = 0;
+
+    /**
+     *  @brief Makes the duty prepared by setDuty() take effect.
+     */
+    virtual void applyDuty() = 0;
+
+    /**
+     *  @brief Stops the motor at once.
+     */
+    virtual void stop() = 0;
+
+    /**
+     *  @brief Gets the accumulated encoder count.
+     *
+     *  Reading does not change the count, so any task may call this at any rate.
+     */
+    virtual int64_t getPosition() const = 0;
+
+    /**
+     *  @brief Resets the encoder position to zero.
+     */
+    virtual void resetPosition() = 0;
+};
+
+/**
+ *  @brief Reads both wheel encoders at the same instant.
+ *
+ *  On the robot nothing can run between the two reads, so the counts
+ *  describe one moment even if an interrupt or the other core is active.
+ *
+ *  @param left Left drive motor.
+ *  @param right Right drive motor.
+ *  @param leftCount Receives the left encoder count.
+ *  @param rightCount Receives the right encoder count.
+ *  @return The time of the reads, from nowMicros().
+ */
+int64_t sampleEncoders(const MotorInterface &left, const MotorInterface &right, int64_t &leftCount,
+                       int64_t &rightCount);
+
+/**
+ *  @brief Sets the duty of both drive motors so that they change in the same PWM period.
+ *
+ *  @param left Left drive motor.
+ *  @param right Right drive motor.
+ *  @param leftDuty Left duty from -1 to 1, forward positive.
+ *  @param rightDuty Right duty from -1 to 1, forward positive.
+ */
+void driveMotors(MotorInterface &left, MotorInterface &right, float leftDuty, float rightDuty);
+
+/**
+ *  @class IMUInterface
+ *  @brief An inertial sensor providing the robot's pitch and pitch rate.
+ */
+class IMUInterface {
+public:
+    virtual ~IMUInterface() {}
+
+    /**
+     *  @brief Reads the sensor and updates pitch and angular velocity.
+     *  @return True if new data was read; false leaves the previous pitch and rate in place.
+     */
+    virtual bool update() = 0;
+
+    /**
+     *  @brief Gets the current pitch (tilt angle) in degrees.
+     */
+    virtual float getPitch() = 0;
+
+    /**
+     *  @brief Gets the current pitch rate in degrees per second.
+     */
+    virtual float getAngularVelocity() = 0;
+
+    /**
+     *  @brief Checks if the sensor is ready to be used.
+     */
+    virtual bool isCalibrated() const = 0;
+};
+
+/** @brief Largest number of targets reported in one TOF frame. */
+static const uint8_t TOF_MAX_TARGETS = 4;
+
+/**
+ *  @brief One target detected by a TOF sensor.
+ */
+typedef struct {
+    uint16_t distance;   /**< Distance to the target in millimeters. */
+    uint8_t status;      /**< Range status as reported by the sensor, 0 for a valid range. */
+    float signalRate;    /**< Return signal rate in mega counts per second. */
+    float sigma;         /**< Estimated standard deviation of the distance in millimeters. */
+} TofTarget;
+
+/**
+ *  @brief All targets of one completed TOF range.
+ */
+typedef struct {
+    int64_t timestamp;                    /**< Time the range became ready, from nowMicros(). */
+    uint8_t count;                        /**< Number of entries in targets. */
+    TofTarget targets[TOF_MAX_TARGETS];   /**< Targets, nearest first. */
+} TofFrame;
+
+/**
+ *  @class TOFInterface
+ *  @brief A multi-target time-of-flight range sensor.
+ */
+class TOFInterface {
+public:
+    virtual ~TOFInterface() {}
+
+    /**
+     *  @brief Fetches the newest range.
+     *  @return True if a new range arrived since the previous call.
+     */
+    virtual bool update() = 0;
+
+    /**
+     *  @brief Gets the most recent range.
+     */
+    virtual const TofFrame &getFrame() const = 0;
+};
+
+/**
+ *  @class GPSInterface
+ *  @brief A GNSS receiver.
+ */
+class GPSInterface {
+public:
+    virtual ~GPSInterface() {}
+
+    /**
+     *  @brief Fetches the newest fix.
+     *  @return True if a new fix arrived since the previous call.
+     */
+    virtual bool update() = 0;
+
+    /**
+     *  @brief Gets the most recent fix.
+     */
+    virtual const GpsFix &getFix() const = 0;
+};
+
+/**
+ *  @class MQTTInterface
+ *  @brief A publish link to the MQTT broker.
+ */
+class MQTTInterface {
+public:
+    virtual ~MQTTInterface() {}
+
+    /**
+     *  @brief Checks if the link to the broker is up.
+     */
+    virtual bool connected() = 0;
+
+    /**
+     *  @brief Publishes a message.
+     *  @param topic The topic to publish to.
+     *  @param payload Pointer to the message payload.
+     *  @param length Length of the payload in bytes.
+     *  @return True if the message was handed to the broker connection.
+     */
+    virtual bool publish(const char* topic, const uint8_t* payload, size_t length) = 0;
+};
+
+#endif
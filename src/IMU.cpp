@@ -6,7 +6,19 @@
  * @param address The I2C address of the BNO055 sensor.
  */
 IMU::IMU(uint8_t address)
-    : bno(55, address), address(address), calibrated(false), pitch(0), angularVelocity(0) {}
+    : bno(55, address), address(address), calibrated(false), profileLoaded(false), lastCalibrationCheck(0),
+      lastProfileSave(0), pitch(0), angularVelocity(0), data(), readErrors(0), rawMode(false), rawSample(),
+      lastSampleTime(0) {}
+
+/**
+ * @brief Runs the sensor in raw AMG mode and estimates pitch on the MCU; call before begin().
+ * @param params Tuning of the attitude estimator.
+ */
+void IMU::setEstimator(const AttitudeParams &params)
+{
+    estimator = AttitudeEstimator(params);
+    rawMode = true;
+}
 
 /**
  * @brief Initializes the BNO055 sensor.
@@ -14,12 +26,30 @@ IMU::IMU(uint8_t address)
  */
 bool IMU::begin()
 {
-    if (!bno.begin((adafruit_bno055_opmode_t)0x0C)) {
+    adafruit_bno055_opmode_t mode = rawMode ? OPERATION_MODE_AMG : OPERATION_MODE_NDOF;
+    if (!bno.begin(mode)) {
         Serial.println("Error initializing BNO055!");
         return false;
     }
-    delay(1000);
+    adafruit_bno055_offsets_t offsets;
+    if (!rawMode && store.load(offsets)) {
+        // Written in config mode; the library switches back to the fusion mode afterwards
+        bno.setSensorOffsets(offsets);
+        profileLoaded = true;
+        calibrated = true;
+        Serial.println("Restored IMU calibration from NVS");
+    }
     bno.setExtCrystalUse(true);
+    if (rawMode) {
+        // Sensor configuration registers are only writable in config mode
+        bno.setMode(OPERATION_MODE_CONFIG);
+        bool configured = configureRawMode();
+        bno.setMode(mode);
+        if (!configured) {
+            Serial.println("Error configuring BNO055 raw mode!");
+            return false;
+        }
+    }
     return true;
 }
 
@@ -44,18 +74,59 @@ void IMU::calibrate()
     } while (sys < 3 || gyro < 3 || accel < 3 || mag < 3);
     calibrated = true;
     Serial.println("IMU Calibrated!");
+    if (!saveCalibration()) {
+        Serial.println("Failed to save IMU calibration");
+    }
+}
+
+/**
+ * @brief Tracks the chip's background calibration and saves improved profiles.
+ * @param idle True if the robot is not balancing, so a short pause in the output is harmless.
+ */
+void IMU::refineCalibration(bool idle)
+{
+    int64_t now = nowMicros();
+    if (rawMode || now - lastCalibrationCheck < (int64_t)CALIBRATION_CHECK_MS * 1000) {
+        return;
+    }
+    lastCalibrationCheck = now;
+    if (!bno.isFullyCalibrated()) {
+        return;
+    }
+    calibrated = true;
+
+    // A first calibration is saved at once; a loaded or saved profile is refreshed after it has had time to improve
+    bool due = (lastProfileSave == 0 && !profileLoaded) || now - lastProfileSave >= (int64_t)CALIBRATION_SAVE_MS * 1000;
+    if (idle && due && saveCalibration()) {
+        lastProfileSave = now;
+    }
+}
+
+/**
+ * @brief Reads the offsets from the sensor and saves them to NVS.
+ * @return True if the sensor was fully calibrated and the profile was saved.
+ */
+bool IMU::saveCalibration()
+{
+    adafruit_bno055_offsets_t offsets;
+    return bno.getSensorOffsets(offsets) && store.save(offsets);
 }
 
 /**
  * @brief Updates the sensor's state, including pitch and angular velocity.
+ * @return False if the sensor is not calibrated yet or the read failed.
  */
-void IMU::update()
+bool IMU::update()
 {
+    if (rawMode) {
+        // Raw samples do not depend on the chip's fusion calibration
+        return computeRawState();
+    }
     if (!calibrated) {
         Serial.println("IMU not calibrated yet!");
-        return;
+        return false;
     }
-    computeState();
+    return computeState();
 }
 
 /**
@@ -69,13 +140,39 @@ float IMU::getPitch()
 
 /**
  * @brief Gets the angular velocity of the sensor (pitch rate).
- * @return The angular velocity in radians per second.
+ * @return The angular velocity in degrees per second.
  */
 float IMU::getAngularVelocity()
 {
     return angularVelocity;
 }
 
+/**
+ * @brief Gets every output decoded by the last update.
+ * @return Quaternion, Euler angles, angular rate and linear acceleration.
+ */
+const ImuData &IMU::getData() const
+{
+    return data;
+}
+
+/**
+ * @brief Gets the raw sample behind the last estimate in raw mode.
+ * @return Gyro and accelerometer readings in sensor axes.
+ */
+const InertialSample &IMU::getRawSample() const
+{
+    return rawSample;
+}
+
+/**
+ * @brief Gets the number of burst reads that failed.
+ */
+uint32_t IMU::getReadErrors() const
+{
+    return readErrors;
+}
+
 /**
  * @brief Checks if the sensor is fully calibrated.
  * @return True if calibrated, false otherwise.
@@ -104,12 +201,120 @@ void IMU::printCalibrationStatus()
 
 /**
  * @brief Computes the current state of the sensor, including pitch and angular velocity.
+ * @return False if the read failed.
  */
-void IMU::computeState()
+bool IMU::computeState()
 {
-    imu::Vector<3> euler = bno.getVector(Adafruit_BNO055::VECTOR_EULER);
-    pitch = euler.z();
+    uint8_t buffer[BURST_LENGTH];
+    if (!readBurst(BURST_START, buffer, BURST_LENGTH)) {
+        readErrors++;
+        return false;
+    }
 
-    imu::Vector<3> gyro = bno.getVector(Adafruit_BNO055::VECTOR_GYROSCOPE);
-    angularVelocity = gyro.y();
+    // Little-endian signed 16-bit registers, scaled per the BNO055 datasheet for the default units
+    int16_t raw[BURST_LENGTH / 2];
+    for (uint8_t i = 0; i < BURST_LENGTH / 2; i++) {
+        raw[i] = (int16_t)((uint16_t)buffer[2 * i] | ((uint16_t)buffer[2 * i + 1] << 8));
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        data.gyro[i] = raw[i] / 16.0f;             // 0x14: 16 LSB per deg/s
+        data.euler[i] = raw[3 + i] / 16.0f;        // 0x1A: 16 LSB per degree
+        data.linearAccel[i] = raw[10 + i] / 100.0f; // 0x28: 100 LSB per m/s^2
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+        data.quaternion[i] = raw[6 + i] / 16384.0f; // 0x20: 2^14 LSB per unit
+    }
+
+    // The BNO055's Euler pitch is the rotation about its x axis, the wheel axle, so its rate is gyro x
+    pitch = data.euler[2];
+    angularVelocity = data.gyro[0];
+    return true;
+}
+
+/**
+ * @brief Reads the raw accelerometer and gyro and updates the estimator.
+ * @return False if the read failed.
+ */
+bool IMU::computeRawState()
+{
+    uint8_t buffer[RAW_BURST_LENGTH];
+    if (!readBurst(RAW_BURST_START, buffer, RAW_BURST_LENGTH)) {
+        readErrors++;
+        return false;
+    }
+    int64_t now = nowMicros();
+
+    int16_t raw[RAW_BURST_LENGTH / 2];
+    for (uint8_t i = 0; i < RAW_BURST_LENGTH / 2; i++) {
+        raw[i] = (int16_t)((uint16_t)buffer[2 * i] | ((uint16_t)buffer[2 * i + 1] << 8));
+    }
+    // Sensor x runs along the axle, so the estimator's axes (x forward, y axle, z up) are -y, x and z of the sensor
+    float accel[3], gyro[3];
+    for (uint8_t i = 0; i < 3; i++) {
+        accel[i] = raw[i] / 100.0f;   // 0x08: 100 LSB per m/s^2
+        gyro[i] = raw[6 + i] / 16.0f; // 0x14: 16 LSB per deg/s
+    }
+    rawSample.accel[0] = -accel[1];
+    rawSample.accel[1] = accel[0];
+    rawSample.accel[2] = accel[2];
+    rawSample.gyro[0] = -gyro[1];
+    rawSample.gyro[1] = gyro[0];
+    rawSample.gyro[2] = gyro[2];
+
+    float dt = lastSampleTime != 0 ? (now - lastSampleTime) * 1e-6f : 0.0f;
+    lastSampleTime = now;
+    estimator.update(rawSample, dt);
+    pitch = estimator.getPitch();
+    angularVelocity = estimator.getPitchRate();
+    return true;
+}
+
+/**
+ * @brief Reads consecutive registers in one I2C transaction.
+ * @param start First register to read.
+ * @param buffer Receives the register values.
+ * @param length Number of registers to read.
+ * @return True if every byte was read.
+ */
+bool IMU::readBurst(uint8_t start, uint8_t *buffer, uint8_t length)
+{
+    Wire.beginTransmission(address);
+    Wire.write(start);
+    if (Wire.endTransmission(false) != 0) {
+        return false;
+    }
+    if (Wire.requestFrom(address, length) != length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        buffer[i] = (uint8_t)Wire.read();
+    }
+    return true;
+}
+
+/**
+ * @brief Writes one register.
+ * @param reg Register address.
+ * @param value Value to write.
+ * @return True if the write was acknowledged.
+ */
+bool IMU::writeRegister(uint8_t reg, uint8_t value)
+{
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    Wire.write(value);
+    return Wire.endTransmission() == 0;
+}
+
+/**
+ * @brief Sets the accelerometer and gyro ranges and rates for AMG mode.
+ * @return True if every register was written.
+ */
+bool IMU::configureRawMode()
+{
+    // ACC_CONFIG and GYR_CONFIG_0 live on register page 1
+    bool ok = writeRegister(PAGE_ID, 1) &&
+              writeRegister(ACC_CONFIG, ACC_CONFIG_AMG) &&
+              writeRegister(GYR_CONFIG_0, GYR_CONFIG_0_AMG);
+    return writeRegister(PAGE_ID, 0) && ok;
 }
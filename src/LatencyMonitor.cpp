@@ -0,0 +1,50 @@
+#include "LatencyMonitor.h"
+
+/**
+ * @brief Constructor for the LatencyMonitor class.
+ * @param publishInterval Records between snapshots for other tasks.
+ */
+LatencyMonitor::LatencyMonitor(uint32_t publishInterval)
+    : publishInterval(publishInterval > 0 ? publishInterval : 1)
+{
+    reset();
+}
+
+/**
+ * @brief Records one latency.
+ * @param sampleTime Timestamp of the sample that was used, from nowMicros().
+ * @param actuationTime Time the output derived from it took effect, from nowMicros().
+ */
+void LatencyMonitor::record(int64_t sampleTime, int64_t actuationTime)
+{
+    int64_t age = actuationTime - sampleTime;
+    uint32_t latency = age < 0 ? 0 : (age > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)age);
+
+    if (stats.samples == 0 || latency < stats.minLatency) stats.minLatency = latency;
+    if (latency > stats.maxLatency) stats.maxLatency = latency;
+    stats.samples++;
+    latencySum += latency;
+    stats.meanLatency = (uint32_t)(latencySum / stats.samples);
+
+    if (stats.samples % publishInterval == 0) {
+        snapshot.put(stats);
+    }
+}
+
+/**
+ * @brief Gets the statistics as of the latest snapshot; safe to call from any task.
+ */
+LatencyStats LatencyMonitor::getStats() const
+{
+    return snapshot.get();
+}
+
+/**
+ * @brief Clears the statistics; only call from the recording task.
+ */
+void LatencyMonitor::reset()
+{
+    stats = LatencyStats();
+    latencySum = 0;
+    snapshot.put(stats);
+}
@@ -0,0 +1,58 @@
+#ifndef LATENCY_MONITOR_H
+#define LATENCY_MONITOR_H
+
+#include <stdint.h>
+#include "LatestValue.h"
+
+/**
+ * @brief Age statistics of sensor samples at the moment they were acted on, in microseconds.
+ */
+typedef struct {
+    uint32_t samples;       /**< Number of latencies recorded. */
+    uint32_t minLatency;    /**< Smallest latency. */
+    uint32_t maxLatency;    /**< Largest latency. */
+    uint32_t meanLatency;   /**< Mean latency. */
+} LatencyStats;
+
+/**
+ * @class LatencyMonitor
+ * @brief Accumulates the time from a sensor sample to the actuation that used it.
+ *
+ * record() is called by one task, typically the control loop right after it
+ * sets the motors. Every publishInterval records the statistics are published
+ * to a lock-free snapshot that any task can read with getStats().
+ */
+class LatencyMonitor
+{
+public:
+    /**
+     * @brief Constructor for the LatencyMonitor class.
+     * @param publishInterval Records between snapshots for other tasks.
+     */
+    LatencyMonitor(uint32_t publishInterval = 50);
+
+    /**
+     * @brief Records one latency.
+     * @param sampleTime Timestamp of the sample that was used, from nowMicros().
+     * @param actuationTime Time the output derived from it took effect, from nowMicros().
+     */
+    void record(int64_t sampleTime, int64_t actuationTime);
+
+    /**
+     * @brief Gets the statistics as of the latest snapshot; safe to call from any task.
+     */
+    LatencyStats getStats() const;
+
+    /**
+     * @brief Clears the statistics; only call from the recording task.
+     */
+    void reset();
+
+private:
+    uint32_t publishInterval;            /**< Records between snapshots. */
+    LatencyStats stats;                  /**< Statistics, owned by the recording task. */
+    uint64_t latencySum;                 /**< Sum of all recorded latencies. */
+    LatestValue<LatencyStats> snapshot;  /**< Copy of stats for other tasks. */
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef LATEST_VALUE_H
+#define LATEST_VALUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+/**
+ * @class LatestValue
+ * @brief Single-writer, multi-reader slot holding the newest value of type T.
+ *
+ * A sequence lock: the writer bumps the sequence to odd, copies the value and
+ * bumps it back to even. Readers copy the value and retry if the sequence
+ * moved underneath them, so they never take a lock or block the writer. The
+ * scheduler is suspended on the writer's core during the copy so a reader on
+ * the same core can never spin on a half-written value. T must be trivially
+ * copyable and put() must only ever be called from one task.
+ */
+template <typename T>
+class LatestValue
+{
+public:
+    /**
+     * @brief Constructor for the LatestValue class; the slot starts value-initialized.
+     */
+    LatestValue() : sequence(0), value() {}
+
+    /**
+     * @brief Publish a new value, replacing the previous one.
+     * @param newValue The value to publish.
+     */
+    void put(const T &newValue)
+    {
+#ifdef ARDUINO
+        vTaskSuspendAll();
+#endif
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = newValue;
+        sequence.store(seq + 2, std::memory_order_release);
+#ifdef ARDUINO
+        xTaskResumeAll();
+#endif
+    }
+
+    /**
+     * @brief Read the newest value.
+     * @return A consistent copy of the last published value.
+     */
+    T get() const
+    {
+        T copy;
+        read(copy);
+        return copy;
+    }
+
+    /**
+     * @brief Read the newest value only if it was published after @p seen.
+     * @param out Receives the value if it is newer.
+     * @param seen Version last seen by the caller; updated on success.
+     * @return True if a newer value was copied into @p out.
+     */
+    bool getIfNewer(T &out, uint32_t &seen) const
+    {
+        if (version() == seen) {
+            return false;
+        }
+        seen = read(out);
+        return true;
+    }
+
+    /**
+     * @brief Get the number of values published so far.
+     */
+    uint32_t version() const
+    {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    std::atomic<uint32_t> sequence; /**< Even when stable, odd while a write is in progress. */
+    T value;                        /**< The most recently published value. */
+
+    /**
+     * @brief Copy the value, retrying until no write overlapped the copy.
+     * @return The version of the value that was copied.
+     */
+    uint32_t read(T &out) const
+    {
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            out = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+        return before / 2;
+    }
+};
+
+#endif
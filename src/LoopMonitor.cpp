@@ -0,0 +1,53 @@
+#include "LoopMonitor.h"
+
+/**
+ * @brief Constructor for the LoopMonitor class.
+ * @param periodMicros Nominal loop period in microseconds.
+ */
+LoopMonitor::LoopMonitor(uint32_t periodMicros) : periodMicros(periodMicros)
+{
+    reset();
+}
+
+/**
+ * @brief Records one cycle.
+ * @param release Ideal release time of the cycle.
+ * @param wake Time the cycle actually started.
+ * @param end Time the cycle finished.
+ * @param missed Number of releases skipped before this cycle.
+ */
+void LoopMonitor::record(int64_t release, int64_t wake, int64_t end, uint32_t missed)
+{
+    int32_t jitter = (int32_t)(wake - release);
+    uint32_t execution = (uint32_t)(end - wake);
+
+    if (stats.cycles == 0 || jitter < stats.minJitter) stats.minJitter = jitter;
+    if (stats.cycles == 0 || jitter > stats.maxJitter) stats.maxJitter = jitter;
+    if (execution > stats.maxExecution) stats.maxExecution = execution;
+    if (end > release + periodMicros) stats.overruns++;
+    stats.missedCycles += missed;
+    stats.cycles++;
+
+    absJitterSum += (uint64_t)(jitter < 0 ? -jitter : jitter);
+    executionSum += execution;
+    stats.meanAbsJitter = (uint32_t)(absJitterSum / stats.cycles);
+    stats.meanExecution = (uint32_t)(executionSum / stats.cycles);
+}
+
+/**
+ * @brief Gets the statistics accumulated since construction or the last reset().
+ */
+LoopStats LoopMonitor::getStats() const
+{
+    return stats;
+}
+
+/**
+ * @brief Clears the statistics.
+ */
+void LoopMonitor::reset()
+{
+    stats = LoopStats();
+    absJitterSum = 0;
+    executionSum = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef LOOP_MONITOR_H
+#define LOOP_MONITOR_H
+
+#include <stdint.h>
+
+/**
+ * @brief Timing statistics of a periodic loop, all times in microseconds.
+ */
+typedef struct {
+    uint32_t cycles;         /**< Number of cycles executed. */
+    uint32_t overruns;       /**< Cycles that finished after the next release time. */
+    uint32_t missedCycles;   /**< Releases skipped because a cycle was still running. */
+    int32_t minJitter;       /**< Earliest wake-up relative to the ideal release time. */
+    int32_t maxJitter;       /**< Latest wake-up relative to the ideal release time. */
+    uint32_t meanAbsJitter;  /**< Mean absolute wake-up jitter. */
+    uint32_t maxExecution;   /**< Longest time from wake-up to the end of a cycle. */
+    uint32_t meanExecution;  /**< Mean time from wake-up to the end of a cycle. */
+} LoopStats;
+
+/**
+ * @class LoopMonitor
+ * @brief Accumulates per-cycle jitter and overrun statistics of a fixed-period loop.
+ */
+class LoopMonitor
+{
+public:
+    /**
+     * @brief Constructor for the LoopMonitor class.
+     * @param periodMicros Nominal loop period in microseconds.
+     */
+    LoopMonitor(uint32_t periodMicros);
+
+    /**
+     * @brief Records one cycle.
+     * @param release Ideal release time of the cycle.
+     * @param wake Time the cycle actually started.
+     * @param end Time the cycle finished.
+     * @param missed Number of releases skipped before this cycle.
+     */
+    void record(int64_t release, int64_t wake, int64_t end, uint32_t missed);
+
+    /**
+     * @brief Gets the statistics accumulated since construction or the last reset().
+     */
+    LoopStats getStats() const;
+
+    /**
+     * @brief Clears the statistics.
+     */
+    void reset();
+
+private:
+    uint32_t periodMicros;
+    LoopStats stats;
+    uint64_t absJitterSum;
+    uint64_t executionSum;
+};
+
+#endif
@@ -9,60 +9,90 @@
  */
 
 
-void MQTTClientESP32::setupWifi() {
-    if (isHotspot) {
-        Serial << "Setting up WiFi access point...";
-        WiFi.mode(WIFI_AP);
-        WiFi.softAPConfig(local_ip, gateway, subnet);
-        WiFi.softAP(ssid, password);
-        Serial << "done." << endl;
-    } else {
-        Serial << "Connecting to " << ssid;
-        WiFi.begin(ssid, password);
-        while (WiFi.status() != WL_CONNECTED) {
-            vTaskDelay(1000);
-            Serial.print(".");
-        }
-        Serial << "connected at IP address " << WiFi.localIP() << endl;
+void MQTTClientESP32::onWifiEvent(arduino_event_id_t event) {
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        wifiUp = true;
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED || event == ARDUINO_EVENT_WIFI_STA_LOST_IP) {
+        wifiUp = false;
     }
 }
 
-void MQTTClientESP32::reconnect() {
-    while (!client.connected()) {
-        Serial << "Connecting to MQTT..." << endl;
-
-        if (client.connect("ESP32_Client")) {
-            Serial << "connected." << endl;
-            client.subscribe("esp32/output");
-        } else {
-            Serial << "failed, rc = " << client.state() << endl;
-            if (!isHotspot) {
-                setupWifi();
+void MQTTClientESP32::pollLink() {
+    int64_t now = nowMicros();
+    switch (linkState) {
+        case LINK_WIFI_DOWN:
+            if (wifiBackoff.isDue(now)) {
+                WiFi.begin(ssid, password);
+                joinStarted = now;
+                setLinkState(LINK_WIFI_JOINING);
             }
-            delay(5000);
-        }
+            break;
+
+        case LINK_WIFI_JOINING:
+            if (wifiUp) {
+                Serial << "Joined " << ssid << " at IP address " << WiFi.localIP() << endl;
+                wifiBackoff.reset();
+                setLinkState(LINK_BROKER_DOWN);
+            } else if (now - joinStarted > WIFI_JOIN_TIMEOUT_US) {
+                WiFi.disconnect();
+                uint32_t wait = wifiBackoff.fail(now);
+                Serial << "Joining " << ssid << " timed out, retrying in " << wait / 1000 << " ms" << endl;
+                setLinkState(LINK_WIFI_DOWN);
+            }
+            break;
+
+        case LINK_BROKER_DOWN:
+            if (!wifiUp) {
+                setLinkState(LINK_WIFI_DOWN);
+            } else if (brokerBackoff.isDue(now)) {
+                // The connect blocks for up to two socket timeouts, so start it with the control ring empty
+                telemetryBatchStep(sensorBus, traceReader, traceBatcher, outbox);
+                if (client.connect("ESP32_Client")) {
+                    client.subscribe(COMMAND_TOPIC_FILTER);
+                    brokerBackoff.reset();
+                    setLinkState(LINK_ONLINE);
+                } else {
+                    uint32_t wait = brokerBackoff.fail(nowMicros());
+                    Serial << "MQTT connect failed, rc = " << client.state() << ", retrying in " << wait / 1000
+                           << " ms" << endl;
+                }
+            }
+            break;
+
+        case LINK_ONLINE:
+            if (!wifiUp || !client.loop()) {
+                client.disconnect();
+                setLinkState(wifiUp ? LINK_BROKER_DOWN : LINK_WIFI_DOWN);
+            }
+            break;
     }
 }
 
-void MQTTClientESP32::callback(char* topic, byte* message, uint16_t length) {
-    lastReceivedTopic = String(topic);
-    lastReceivedMessage = String((char*)message, length);
-
-    Serial << "MQTT received topic \"" << lastReceivedTopic << "\", message \"" << lastReceivedMessage << "\"" << endl;
+void MQTTClientESP32::setLinkState(LinkState state) {
+    static const char *names[] = {"WiFi down", "joining WiFi", "broker down", "online"};
+    StoreAndForwardStats stats = outbox.getStats();
+    Serial << "MQTT link " << names[linkState] << " -> " << names[state] << ", " << stats.pending
+           << " trace messages buffered, " << stats.dropped << " dropped" << endl;
+    linkState = state;
+}
 
-    if (lastReceivedTopic == "esp32/output") {
-        if (lastReceivedMessage == "command1") {
-            Serial << "Executing Command 1" << endl;
-        } else if (lastReceivedMessage == "command2") {
-            Serial << "Executing Command 2" << endl;
-        }
+void MQTTClientESP32::callback(char* topic, byte* message, uint16_t length) {
+    Command command;
+    if (!parseCommand(topic, message, length, nowMicros(), command)) {
+        Serial << "MQTT rejected invalid command on \"" << topic << "\"" << endl;
+    } else if (command.type == COMMAND_UPLOAD_LOG) {
+        flightRecorder.requestUpload();
+    } else if (!commandQueue.push(command)) {
+        Serial << "MQTT command queue full, dropped command on \"" << topic << "\"" << endl;
     }
 }
 
 MQTTClientESP32::MQTTClientESP32(const char* ssid, const char* password, const char* mqtt_server, uint16_t mqtt_port, bool isHotspot,
                                  IPAddress local_ip, IPAddress gateway, IPAddress subnet)
     : ssid(ssid), password(password), mqtt_server(mqtt_server), mqtt_port(mqtt_port), isHotspot(isHotspot),
-      local_ip(local_ip), gateway(gateway), subnet(subnet), client(espClient) {}
+      local_ip(local_ip), gateway(gateway), subnet(subnet), client(espClient), outbox(*this),
+      linkState(LINK_WIFI_DOWN), wifiUp(false), joinStarted(0),
+      wifiBackoff(BackoffParams::defaults(), esp_random()), brokerBackoff(BackoffParams::defaults(), esp_random()) {}
 
 void MQTTClientESP32::begin() {
     Serial.begin(115200);
@@ -73,35 +103,59 @@ void MQTTClientESP32::begin() {
     delay(1000);
     Serial << endl << F("\033[2JTesting Arduino MQTT") << endl;
 
-    setupWifi();
+    if (isHotspot) {
+        Serial << "Setting up WiFi access point...";
+        WiFi.mode(WIFI_AP);
+        WiFi.softAPConfig(local_ip, gateway, subnet);
+        WiFi.softAP(ssid, password);
+        Serial << "done." << endl;
+        wifiUp = true;
+        linkState = LINK_BROKER_DOWN;
+    } else {
+        // Rejoining is paced by wifiBackoff rather than by the driver
+        WiFi.mode(WIFI_STA);
+        WiFi.setAutoReconnect(false);
+        WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t) {
+            this->onWifiEvent(event);
+        });
+    }
 
     // Set up the callback using a lambda function
     client.setServer(mqtt_server, mqtt_port);
+    espClient.setTimeout(SOCKET_TIMEOUT_S);
+    client.setSocketTimeout(SOCKET_TIMEOUT_S);
+    // Room for a full control trace batch plus the topic and MQTT header
+    client.setBufferSize(TELEMETRY_BATCH_FRAME_CAPACITY + 64);
     client.setCallback([this](char* topic, byte* message, unsigned int length) {
         this->callback(topic, message, length);
     });
 }
 
 void MQTTClientESP32::mqttLoop() {
+    traceReader = sensorBus.control.reader();
     for (;;) {
-        if (!client.loop()) {
-            reconnect();
-        }
+        pollLink();
 
-        BotState local_state = botState.get();
+        telemetryStep(readBotState(sensorBus), *this);
+        telemetryBatchStep(sensorBus, traceReader, traceBatcher, outbox);
+        outbox.flush(TELEMETRY_REPLAY_PER_PERIOD);
+        flightRecorder.uploadStep(*this);
 
-        char msg_string[64];
-        sprintf(msg_string, "Position: %.2f, Tilt Angle: %.2f", local_state.position, local_state.tilt_angle);
-        client.publish("bot/state", msg_string);
-
-        vTaskDelay(1000);
+        vTaskDelay(TELEMETRY_PERIOD_MS / portTICK_PERIOD_MS);
     }
 }
 
-String MQTTClientESP32::getLastReceivedTopic() const {
-    return lastReceivedTopic;
+bool MQTTClientESP32::connected() {
+    return linkState == LINK_ONLINE;
 }
 
-String MQTTClientESP32::getLastReceivedMessage() const {
-    return lastReceivedMessage;
+bool MQTTClientESP32::publish(const char* topic, const uint8_t* payload, size_t length) {
+    if (linkState != LINK_ONLINE) {
+        return false;
+    }
+    if (length <= TELEMETRY_BATCH_FRAME_CAPACITY) {
+        return client.publish(topic, payload, length);
+    }
+    return client.beginPublish(topic, length, false) && client.write(payload, length) == length &&
+           client.endPublish() == 1;
 }
\ No newline at end of file
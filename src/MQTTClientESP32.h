@@ -9,28 +9,62 @@
 #include "PrintStream.h"
 #include <WiFi.h>
 #include <PubSubClient.h>
-#include "taskshare.h"
+#include <atomic>
+#include "HAL.h"
+#include "Backoff.h"
+#include "ConeBot.h"
+#include "FlightRecorder.h"
+#include "StoreAndForward.h"
 
 /**
- *  @brief Structure representing the bot's position and tilt angle.
+ *  @brief Extern sensor bus the published robot state is derived from.
  */
-typedef struct {
-    float position;
-    float tilt_angle;
-} BotState;
+
+extern SensorBus sensorBus;
+
+/**
+ *  @brief Extern queue receiving the validated commands for the motor control loop.
+ */
+extern CommandQueue commandQueue;
 
 /**
- *  @brief Extern variable to store the bot's current state.
+ *  @brief Extern flight recorder whose log is uploaded on request.
  */
+extern FlightRecorder flightRecorder;
 
-extern Share<BotState> botState;
+/**
+ *  @brief Steps of bringing up the link to the broker.
+ */
+enum LinkState {
+    LINK_WIFI_DOWN,     /**< Off the network, waiting for the backoff to join it. */
+    LINK_WIFI_JOINING,  /**< Joining the network, waiting for an IP address. */
+    LINK_BROKER_DOWN,   /**< On the network, waiting for the backoff to connect to the broker. */
+    LINK_ONLINE         /**< Connected to the broker. */
+};
 
 /**
  *  @class MQTTClientESP32
  *  @brief Handles MQTT communication on an ESP32 device.
+ *
+ *  The connection is a state machine advanced once per pass of the MQTT
+ *  task, fed by WiFi events, with its own exponential backoff for joining
+ *  the network and for connecting to the broker. No step waits for the
+ *  network: the only time spent on it is a broker connect attempt, which
+ *  the socket timeouts bound to about SOCKET_TIMEOUT_S each for the TCP
+ *  connection and the broker's reply. The control trace goes through a
+ *  StoreAndForward, so an outage loses at most what no longer fits in it;
+ *  the robot state is live data and is only sent while online. The trace
+ *  is drained into it right before a connect attempt, and the control ring
+ *  holds more than the two blocking steps, so no sample is lost meanwhile.
  */
-class MQTTClientESP32 {
+class MQTTClientESP32 : public MQTTInterface {
 private:
+    static const int64_t WIFI_JOIN_TIMEOUT_US = 10000000; /**< Join attempt given up after this long. */
+    static const uint16_t SOCKET_TIMEOUT_S = 1;          /**< Bound of each blocking step of a broker connect. */
+    static_assert((uint64_t)decltype(SensorBus::control)::CAPACITY * CONTROL_PERIOD_US >=
+                      2ULL * SOCKET_TIMEOUT_S * 1000000 + TELEMETRY_PERIOD_MS * 1000,
+                  "The control ring must hold the trace through a blocking broker connect");
+
     const char* ssid;
     const char* password;
     const char* mqtt_server;
@@ -44,29 +78,38 @@ private:
     WiFiClient espClient;
     PubSubClient client;
 
-    String lastReceivedTopic;
-    String lastReceivedMessage;
+    SampleRing<ControlSample, 1024>::Reader traceReader; /**< Position of the control trace on the sensor bus. */
+    TelemetryBatcher traceBatcher;                       /**< Control trace batch being filled. */
+    StoreAndForward outbox;                              /**< Control trace waiting for the broker. */
+
+    LinkState linkState;            /**< Step of the connection, owned by the MQTT task. */
+    std::atomic<bool> wifiUp;       /**< Station has an IP address, set by the WiFi event task. */
+    int64_t joinStarted;            /**< Time the current join attempt began. */
+    Backoff wifiBackoff;            /**< Delay between attempts to join the network. */
+    Backoff brokerBackoff;          /**< Delay between attempts to connect to the broker. */
 
     /**
-     *  @brief Configures WiFi connection based on the mode (hotspot or client).
+     *  @brief Tracks whether the station has an IP address; called from the WiFi event task.
+     *  @param event WiFi event.
      */
-    void setupWifi();
+    void onWifiEvent(arduino_event_id_t event);
 
     /**
-     *  @brief Reconnects to the MQTT server if the connection is lost.
+     *  @brief Advances the connection state machine by one step without waiting on the network.
      */
-    void reconnect();
+    void pollLink();
 
     /**
-     *  @brief Static callback for handling MQTT messages.
-     *  @param topic The topic of the received message.
-     *  @param message The message payload.
-     *  @param length The length of the message payload.
+     *  @brief Moves the connection state machine to a new state and logs the change.
+     *  @param state New state.
      */
-    static void staticCallback(char* topic, byte* message, uint16_t length);
+    void setLinkState(LinkState state);
 
     /**
-     *  @brief Instance-specific handler for MQTT messages.
+     *  @brief Instance-specific handler for MQTT messages, queueing each valid command for the motor control loop.
+     *
+     *  A log upload command is passed to the flight recorder instead.
+     *
      *  @param topic The topic of the received message.
      *  @param message The message payload.
      *  @param length The length of the message payload.
@@ -89,7 +132,7 @@ public:
                     IPAddress local_ip = IPAddress(192, 168, 5, 1), IPAddress gateway = IPAddress(192, 168, 5, 1), IPAddress subnet = IPAddress(255, 255, 255, 0));
 
     /**
-     *  @brief Initializes the MQTT client and establishes WiFi connection.
+     *  @brief Initializes the MQTT client and starts bringing up the network, without waiting for it.
      */
     void begin();
 
@@ -99,16 +142,23 @@ public:
     void mqttLoop();
 
     /**
-     *  @brief Gets the last received MQTT topic.
-     *  @return Last received topic as a string.
+     *  @brief Checks if the client is connected to the MQTT broker.
+     *  @return True if connected.
      */
-    String getLastReceivedTopic() const;
+    bool connected() override;
 
     /**
-     *  @brief Gets the last received MQTT message.
-     *  @return Last received message as a string.
+     *  @brief Publishes a message to the MQTT broker.
+     *
+     *  Messages larger than the client's buffer, such as flight log blocks,
+     *  are streamed to the connection instead of copied into the buffer.
+     *
+     *  @param topic The topic to publish to.
+     *  @param payload Pointer to the message payload.
+     *  @param length Length of the payload in bytes.
+     *  @return True if the message was handed to the broker connection.
      */
-    String getLastReceivedMessage() const;
+    bool publish(const char* topic, const uint8_t* payload, size_t length) override;
 };
 
 #endif
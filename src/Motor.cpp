@@ -1,4 +1,10 @@
 #include "Motor.h"
+#include <soc/pcnt_struct.h>
+
+Motor *Motor::unitOwners[PCNT_UNIT_MAX] = {};
+pcnt_isr_handle_t Motor::isrHandle = NULL;
+portMUX_TYPE Motor::carryLock = portMUX_INITIALIZER_UNLOCKED;
+
 /**
  * @brief Constructs a Motor object.
  * 
@@ -7,17 +13,23 @@
  * @param encAPin Encoder A pin for position feedback.
  * @param encBPin Encoder B pin for position feedback.
  * @param pcntUnit PCNT unit used for encoder feedback.
+ * @param ledcChannel LEDC channel generating the PWM.
+ * @param output PWM frequency, resolution and command shaping, the same for every motor.
  */
-Motor::Motor(uint8_t pwmPin, uint8_t dirPin, uint8_t encAPin, uint8_t encBPin, pcnt_unit_t pcntUnit)
-    : pwmPin(pwmPin), dirPin(dirPin), encAPin(encAPin), encBPin(encBPin), pcntUnit(pcntUnit), encoderCount(0) {}
+Motor::Motor(uint8_t pwmPin, uint8_t dirPin, uint8_t encAPin, uint8_t encBPin, pcnt_unit_t pcntUnit,
+             ledc_channel_t ledcChannel, const MotorOutputParams &output)
+    : pwmPin(pwmPin), dirPin(dirPin), encAPin(encAPin), encBPin(encBPin), pcntUnit(pcntUnit),
+      ledcChannel(ledcChannel), output(output), forward(true), loadedDuty(0), pinForward(true), latchedOff(false),
+      carriedCount(0), carrySequence(0) {}
 /**
  * @brief Initializes the motor control pins and sets up the Pulse Counter (PCNT) for the encoder.
  */
 void Motor::begin()
 {
     // Motor control pin setup
-    pinMode(pwmPin, OUTPUT);
     pinMode(dirPin, OUTPUT);
+    digitalWrite(dirPin, pinForward ? HIGH : LOW);
+    setupLEDC();
     stop();
 
     // Setup PCNT for encoder
@@ -38,62 +50,174 @@ void Motor::setupPCNT()
     pcntConfig.neg_mode = PCNT_COUNT_DEC;       // Count down on falling edge
     pcntConfig.lctrl_mode = PCNT_MODE_KEEP;     // Keep the primary count direction
     pcntConfig.hctrl_mode = PCNT_MODE_REVERSE;  // Reverse direction when CTRL is high
-    pcntConfig.counter_h_lim = 32767;           // High limit for counter
-    pcntConfig.counter_l_lim = -32768;          // Low limit for counter
+    pcntConfig.counter_h_lim = COUNT_LIMIT;     // High limit for counter
+    pcntConfig.counter_l_lim = -COUNT_LIMIT;    // Low limit for counter
 
     // Configure PCNT unit
     pcnt_unit_config(&pcntConfig);
 
+    // Carry the count out of the counter whenever it reaches a limit and restarts at zero. The ISR
+    // is in IRAM so it also runs while a flash write has the cache off, and no wrap is carried late.
+    unitOwners[pcntUnit] = this;
+    if (isrHandle == NULL) {
+        pcnt_isr_register(onCounterLimit, NULL, ESP_INTR_FLAG_IRAM, &isrHandle);
+    }
+    pcnt_event_enable(pcntUnit, PCNT_EVT_H_LIM);
+    pcnt_event_enable(pcntUnit, PCNT_EVT_L_LIM);
+
     // Initialize PCNT counter
     pcnt_counter_pause(pcntUnit);
     pcnt_counter_clear(pcntUnit);
+    pcnt_intr_enable(pcntUnit);
     pcnt_counter_resume(pcntUnit);
 }
 
+/**
+ * @brief Handles PCNT limit events of every unit by carrying the limit into the owner's count.
+ *
+ * The interrupt is cleared while the carry sequence is odd, so a reader sees
+ * either the pending interrupt and the old carried count, or neither. Only
+ * registers and inline code are used, as the handler runs from IRAM.
+ *
+ * @param arg Unused.
+ */
+void IRAM_ATTR Motor::onCounterLimit(void *arg)
+{
+    uint32_t pending = PCNT.int_st.val;
+    portENTER_CRITICAL_ISR(&carryLock);
+    for (int unit = 0; unit < PCNT_UNIT_MAX; unit++) {
+        if (!(pending & BIT(unit))) {
+            continue;
+        }
+        Motor *motor = unitOwners[unit];
+        if (motor == NULL) {
+            PCNT.int_clr.val = BIT(unit);
+            continue;
+        }
+        uint32_t status = PCNT.status_unit[unit].val;
+        uint32_t sequence = motor->carrySequence.load(std::memory_order_relaxed);
+        motor->carrySequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        motor->carriedCount += (status & PCNT_EVT_H_LIM) ? COUNT_LIMIT : -COUNT_LIMIT;
+        PCNT.int_clr.val = BIT(unit);
+        motor->carrySequence.store(sequence + 2, std::memory_order_release);
+    }
+    portEXIT_CRITICAL_ISR(&carryLock);
+}
+
 
 /**
- * @brief Sets the speed of the motor.
+ * @brief Configures the shared LEDC timer and this motor's channel.
+ */
+void Motor::setupLEDC()
+{
+    const MotorOutputParams &params = output.getParams();
+    ledc_timer_config_t timerConfig = {};
+    timerConfig.speed_mode = LEDC_HIGH_SPEED_MODE;
+    timerConfig.duty_resolution = (ledc_timer_bit_t)params.resolutionBits;
+    timerConfig.timer_num = LEDC_TIMER_0;       // Shared by both motors
+    timerConfig.freq_hz = params.frequencyHz;
+    timerConfig.clk_cfg = LEDC_AUTO_CLK;
+    ledc_timer_config(&timerConfig);
+
+    ledc_channel_config_t channelConfig = {};
+    channelConfig.gpio_num = pwmPin;
+    channelConfig.speed_mode = LEDC_HIGH_SPEED_MODE;
+    channelConfig.channel = ledcChannel;
+    channelConfig.intr_type = LEDC_INTR_DISABLE;
+    channelConfig.timer_sel = LEDC_TIMER_0;
+    channelConfig.duty = 0;
+    channelConfig.hpoint = 0;
+    ledc_channel_config(&channelConfig);
+}
+
+/**
+ * @brief Shapes a new duty and loads it into the LEDC channel, to take effect at applyDuty().
  * 
- * @param speed Speed value ranging from -255 to 255. Positive values indicate forward direction,
- *              negative values indicate reverse direction, and zero stops the motor.
+ * @param duty Duty from -1 to 1. Positive values indicate forward direction,
+ *             negative values indicate reverse direction, and zero stops the motor.
  */
-void Motor::setSpeed(int speed)
+void Motor::setDuty(float duty)
 {
-    speed = constrain(speed, -255, 255); // Ensure speed is within valid range
-
-    if (speed > 0) {
-        digitalWrite(dirPin, HIGH); // Forward direction
-    } else if (speed < 0) {
-        digitalWrite(dirPin, LOW);  // Reverse direction
-        speed = -speed;            // Use absolute value for PWM
-    } else {
-        stop();
-        return;
-    }
+    int32_t compare = output.update(duty, nowMicros()); // Clamp, slew, deadband and quantize
+    forward = compare >= 0;
+    loadedDuty = (uint32_t)(forward ? compare : -compare);
+    ledc_set_duty(LEDC_HIGH_SPEED_MODE, ledcChannel, loadedDuty);
+}
 
-    analogWrite(pwmPin, speed); // Set PWM duty cycle
+/**
+ * @brief Latches the loaded duty and sets the direction pin to match.
+ *
+ * The duty latches at the start of the next PWM period but the pin switches
+ * at once, so flipping the pin with the duty would drive the old duty the
+ * wrong way for up to a period. A reversal therefore latches zero first,
+ * and the pin flips at the next call, when the zero is on the output.
+ */
+void Motor::applyDuty()
+{
+    if (forward != pinForward && loadedDuty != 0) {
+        if (!latchedOff) {
+            ledc_set_duty(LEDC_HIGH_SPEED_MODE, ledcChannel, 0);
+            ledc_update_duty(LEDC_HIGH_SPEED_MODE, ledcChannel);
+            latchedOff = true;
+            return;
+        }
+        digitalWrite(dirPin, forward ? HIGH : LOW);
+        pinForward = forward;
+        ledc_set_duty(LEDC_HIGH_SPEED_MODE, ledcChannel, loadedDuty);
+    }
+    ledc_update_duty(LEDC_HIGH_SPEED_MODE, ledcChannel);
+    latchedOff = loadedDuty == 0;
 }
 
 /**
- * @brief Stops the motor by setting the PWM duty cycle to zero.
+ * @brief Stops the motor by setting the PWM duty cycle to zero at once.
+ *
+ * The zero is latched as on a reversal, so the next applyDuty() may set the
+ * direction pin straight away, and the duty ramps up again from zero.
  */
 void Motor::stop()
 {
-    analogWrite(pwmPin, 0); // Set PWM duty cycle to 0
+    output.reset();
+    loadedDuty = 0;
+    ledc_set_duty(LEDC_HIGH_SPEED_MODE, ledcChannel, 0);
+    ledc_update_duty(LEDC_HIGH_SPEED_MODE, ledcChannel);
+    latchedOff = true;
 }
 
 /**
  * @brief Gets the current position of the motor based on encoder feedback.
+ *
+ * Lock-free: retries only if the ISR changed the carried count meanwhile. A
+ * limit the counter has reached but the ISR has not yet carried (it may be
+ * held off by a critical section on this core) is added here instead.
  * 
  * @return The accumulated encoder count representing the motor position.
  */
-int32_t Motor::getPosition()
+int64_t Motor::getPosition() const
 {
-    int16_t count;
-    pcnt_get_counter_value(pcntUnit, &count); // Get current PCNT count
-    encoderCount += count;                   // Accumulate total position
-    pcnt_counter_clear(pcntUnit);            // Clear PCNT counter
-    return encoderCount;
+    const uint32_t unitBit = BIT(pcntUnit);
+    for (;;) {
+        uint32_t before = carrySequence.load(std::memory_order_acquire);
+        bool pendingBefore = (PCNT.int_raw.val & unitBit) != 0;
+        int16_t count;
+        pcnt_get_counter_value(pcntUnit, &count); // Get current PCNT count, left running
+        bool pendingAfter = (PCNT.int_raw.val & unitBit) != 0;
+        int64_t carried = carriedCount;
+        uint32_t status = 0;
+        if (pendingBefore) {
+            pcnt_get_event_status(pcntUnit, &status);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t after = carrySequence.load(std::memory_order_relaxed);
+        if ((before & 1) || before != after || pendingBefore != pendingAfter) {
+            continue;
+        }
+        if (pendingBefore) {
+            carried += (status & PCNT_EVT_H_LIM) ? COUNT_LIMIT : -COUNT_LIMIT;
+        }
+        return carried + count;
+    }
 }
 
 /**
@@ -101,6 +225,13 @@ int32_t Motor::getPosition()
  */
 void Motor::resetPosition()
 {
-    encoderCount = 0;            // Reset accumulated position
-    pcnt_counter_clear(pcntUnit); // Clear PCNT counter
+    portENTER_CRITICAL(&carryLock);
+    uint32_t sequence = carrySequence.load(std::memory_order_relaxed);
+    carrySequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    pcnt_counter_clear(pcntUnit);  // Clear PCNT counter
+    PCNT.int_clr.val = BIT(pcntUnit); // and any limit it reached that is not carried yet
+    carriedCount = 0;              // Reset accumulated position
+    carrySequence.store(sequence + 2, std::memory_order_release);
+    portEXIT_CRITICAL(&carryLock);
 }
@@ -2,12 +2,29 @@
 #define MOTOR_H
 
 #include <Arduino.h>
+#include <atomic>
+#include <driver/ledc.h>
 #include <driver/pcnt.h>
+#include "HAL.h"
+#include "MotorOutput.h"
 
 /**
  * @brief Motor class to control motor speed, direction, and read encoder feedback.
+ *
+ * The PCNT counter runs freely between -COUNT_LIMIT and COUNT_LIMIT. Reaching
+ * either limit restarts it at zero and raises an interrupt, which carries the
+ * limit into a 64-bit count. Reads never clear the counter, so they lose no
+ * pulses and may come from any task or core without a lock.
+ *
+ * The PWM comes from an LEDC channel. All motors share one LEDC timer, so
+ * duties applied together by driveMotors() switch in the same PWM period.
+ * LEDC latches a new duty only at the start of the next PWM period, while
+ * the direction pin switches at once, so a reversal first applies zero
+ * duty and flips the direction pin at the following applyDuty(), once the
+ * zero has latched. This assumes the PWM period is shorter than the time
+ * between applyDuty() calls (50 us at 20 kHz against 1 ms).
  */
-class Motor
+class Motor : public MotorInterface
 {
 public:
 /**
@@ -18,33 +35,43 @@ public:
      * @param encAPin Encoder A pin for position feedback.
      * @param encBPin Encoder B pin for position feedback.
      * @param pcntUnit PCNT unit used for encoder feedback.
+     * @param ledcChannel LEDC channel generating the PWM.
+     * @param output PWM frequency, resolution and command shaping, the same for every motor.
      */
-    Motor(uint8_t pwmPin, uint8_t dirPin, uint8_t encAPin, uint8_t encBPin, pcnt_unit_t pcntUnit);
+    Motor(uint8_t pwmPin, uint8_t dirPin, uint8_t encAPin, uint8_t encBPin, pcnt_unit_t pcntUnit,
+          ledc_channel_t ledcChannel, const MotorOutputParams &output = MotorOutputParams::defaults());
  /**
      * @brief Initializes the motor by setting up control pins and configuring the encoder.
      */
     void begin();
 /**
-     * @brief Sets the speed of the motor.
+     * @brief Shapes a new duty and loads it into the LEDC channel, to take effect at applyDuty().
      * 
-     * @param speed Speed value ranging from -255 to 255. Positive values indicate forward direction,
-     *              negative values indicate reverse direction, and zero stops the motor.
+     * @param duty Duty from -1 to 1. Positive values indicate forward direction,
+     *             negative values indicate reverse direction, and zero stops the motor.
      */
-    void setSpeed(int speed);   // Speed range: -255 to 255
+    void setDuty(float duty) override;   // Duty range: -1 to 1
+/**
+     * @brief Latches the loaded duty and sets the direction pin to match.
+     *
+     * On a reversal the output is switched off first, and the direction pin
+     * and the new duty follow at the next call.
+     */
+    void applyDuty() override;
 /**
      * @brief Stops the motor.
      */
-    void stop();                // Stop the motor
+    void stop() override;                // Stop the motor
  /**
      * @brief Gets the current encoder position.
      * 
      * @return The accumulated encoder count representing the motor position.
      */
-    int32_t getPosition();      // Get encoder position
+    int64_t getPosition() const override; // Get encoder position
 /**
      * @brief Resets the encoder position to zero.
      */
-    void resetPosition();       // Reset encoder position to zero
+    void resetPosition() override;       // Reset encoder position to zero
 
 private:
     uint8_t pwmPin;             // PWM pin for speed control
@@ -52,12 +79,33 @@ private:
     uint8_t encAPin;            // Encoder A pin
     uint8_t encBPin;            // Encoder B pin
     pcnt_unit_t pcntUnit;       // PCNT unit for encoder
-    volatile int32_t encoderCount; // Total encoder position
+    ledc_channel_t ledcChannel; // LEDC channel for PWM
+    MotorOutput output;         // Deadband, slew and resolution of the PWM duty
+    bool forward;               // Direction of the loaded duty
+    uint32_t loadedDuty;        // Duty loaded into the LEDC channel, not yet latched
+    bool pinForward;            // Direction the direction pin is set to
+    bool latchedOff;            // Zero duty was latched by the previous applyDuty()
+    volatile int64_t carriedCount; // Counts carried out of the PCNT counter at its limits
+    std::atomic<uint32_t> carrySequence; // Odd while carriedCount is being changed
+
+    static const int16_t COUNT_LIMIT = 32767;       // PCNT counter limit, both directions
+    static Motor *unitOwners[PCNT_UNIT_MAX];        // Motor using each PCNT unit, for the shared ISR
+    static pcnt_isr_handle_t isrHandle;             // Shared PCNT ISR, registered by the first motor
+    static portMUX_TYPE carryLock;                  // Serializes the ISR and resetPosition()
 
 /**
      * @brief Configures the Pulse Counter (PCNT) unit for encoder feedback.
      */
     void setupPCNT();           // PCNT configuration for encoder
+/**
+     * @brief Configures the shared LEDC timer and this motor's channel.
+     */
+    void setupLEDC();           // LEDC configuration for PWM
+
+/**
+     * @brief Handles PCNT limit events of every unit by carrying the limit into the owner's count.
+     */
+    static void IRAM_ATTR onCounterLimit(void *arg);
 };
 
 #endif
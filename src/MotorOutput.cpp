@@ -0,0 +1,69 @@
+/** @file MotorOutput.cpp
+ *  @brief Implementation of the motor duty shaping.
+ */
+
+#include "MotorOutput.h"
+
+#include <math.h>
+
+MotorOutputParams MotorOutputParams::defaults() {
+    MotorOutputParams p;
+    p.frequencyHz = 20000;
+    p.resolutionBits = 11;
+    p.deadband = 0.05f;
+    p.slewRate = 50.0f;
+    p.periodMicros = 1000;  // The wheel speed loop
+    return p;
+}
+
+MotorOutput::MotorOutput(const MotorOutputParams &params)
+    : params(params), maxCompare((int32_t)(1u << params.resolutionBits) - 1) {
+    reset();
+}
+
+void MotorOutput::reset() {
+    command = 0.0f;
+    compare = 0;
+    lastTimestamp = 0;
+    primed = false;
+}
+
+int32_t MotorOutput::update(float duty, int64_t timestamp) {
+    duty = duty > 1.0f ? 1.0f : (duty < -1.0f ? -1.0f : duty);
+    if (params.slewRate > 0.0f) {
+        // From rest the output starts at zero, so the first step is one period's worth
+        int64_t elapsed = primed ? timestamp - lastTimestamp : (int64_t)params.periodMicros;
+        float step = params.slewRate * (float)elapsed * 1e-6f;
+        if (duty > command + step) {
+            duty = command + step;
+        } else if (duty < command - step) {
+            duty = command - step;
+        }
+    }
+    command = duty;
+    lastTimestamp = timestamp;
+    primed = true;
+
+    // Commands below half a step of the resolution stay off rather than jumping to the deadband
+    float magnitude = fabsf(command);
+    if (magnitude * maxCompare < 0.5f) {
+        compare = 0;
+        return compare;
+    }
+    float lifted = params.deadband + (1.0f - params.deadband) * magnitude;
+    int32_t value = (int32_t)lrintf(lifted * maxCompare);
+    compare = command > 0.0f ? value : -value;
+    return compare;
+}
+
+float MotorOutput::getDuty() const {
+    return (float)compare / (float)maxCompare;
+}
+
+int32_t MotorOutput::getMaxCompare() const {
+    return maxCompare;
+}
+
+const MotorOutputParams &MotorOutput::getParams() const {
+    return params;
+}
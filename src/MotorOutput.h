@@ -0,0 +1,84 @@
+/** @file MotorOutput.h
+ *  @brief Shaping of motor duty commands into PWM compare values.
+ */
+
+#ifndef MOTOR_OUTPUT_H
+#define MOTOR_OUTPUT_H
+
+#include <stdint.h>
+
+/**
+ *  @brief PWM configuration and command shaping of one motor output.
+ */
+struct MotorOutputParams {
+    uint32_t frequencyHz;   /**< PWM frequency in Hz, 20 kHz or more to stay inaudible. */
+    uint8_t resolutionBits; /**< Duty resolution in bits; frequency times 2^bits may not exceed 80 MHz. */
+    float deadband;         /**< Duty the motor needs to overcome static friction, 0 to 1. */
+    float slewRate;         /**< Largest change of the commanded duty per second, 0 for no limit. */
+    uint32_t periodMicros;  /**< Nominal time between updates, the slew interval of the first update after a reset. */
+
+    /**
+     *  @brief Gets parameters for the ConeBot drive motors on the ESP32 LEDC.
+     */
+    static MotorOutputParams defaults();
+};
+
+/**
+ *  @class MotorOutput
+ *  @brief Turns a duty command into the signed PWM compare value of one motor.
+ *
+ *  The command is clamped to -1..1 and rate limited to slewRate. A nonzero
+ *  command is then lifted past the deadband, so the wheel responds to small
+ *  commands instead of sitting still until friction gives way, and finally
+ *  quantized to the PWM resolution. Slew limiting comes before the deadband
+ *  so that a reversal steps straight across it.
+ */
+class MotorOutput {
+public:
+    /**
+     *  @brief Constructor for the MotorOutput class.
+     *  @param params PWM configuration and shaping.
+     */
+    MotorOutput(const MotorOutputParams &params = MotorOutputParams::defaults());
+
+    /**
+     *  @brief Sets the output to zero at once, bypassing the slew limit.
+     *
+     *  The next update ramps up from zero as if one periodMicros had passed,
+     *  however long the output was held at zero.
+     */
+    void reset();
+
+    /**
+     *  @brief Shapes a new duty command.
+     *  @param duty Commanded duty in -1..1, forward positive.
+     *  @param timestamp Time of the command, from nowMicros().
+     *  @return PWM compare value, negative for reverse, at most getMaxCompare() in magnitude.
+     */
+    int32_t update(float duty, int64_t timestamp);
+
+    /**
+     *  @brief Gets the duty applied after shaping and quantization, in -1..1.
+     */
+    float getDuty() const;
+
+    /**
+     *  @brief Gets the PWM compare value at full duty.
+     */
+    int32_t getMaxCompare() const;
+
+    /**
+     *  @brief Gets the configuration the output was built with.
+     */
+    const MotorOutputParams &getParams() const;
+
+private:
+    MotorOutputParams params;
+    int32_t maxCompare;
+    float command;          /**< Rate-limited duty command before the deadband. */
+    int32_t compare;        /**< Latest PWM compare value. */
+    int64_t lastTimestamp;  /**< Time of the latest update. */
+    bool primed;            /**< An update has happened since the reset, so lastTimestamp bounds the next step. */
+};
+
+#endif
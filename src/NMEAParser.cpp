@@ -0,0 +1,359 @@
+#include "NMEAParser.h"
+
+#include <string.h>
+
+namespace {
+
+/** Longest number parseFixed() accepts, counting integer digits plus the kept decimals, so the scaled
+ *  value and the unit conversions applied to it stay well inside int64_t. */
+const uint8_t MAX_FIXED_DIGITS = 12;
+
+/**
+ * @brief Convert a hexadecimal digit to its value.
+ * @return The digit value, or -1 if @p c is not a hexadecimal digit.
+ */
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * @brief Parse a decimal number into an integer scaled by 10^decimals.
+ *
+ * Extra fractional digits are truncated, so "12.3456" with two decimals
+ * yields 1234.
+ *
+ * @param s Null-terminated field text.
+ * @param decimals Number of fractional digits to keep.
+ * @param out Receives the scaled value.
+ * @return True if the field held a number, false if it was empty, malformed or longer than MAX_FIXED_DIGITS.
+ */
+bool parseFixed(const char *s, uint8_t decimals, int64_t *out)
+{
+    bool negative = false;
+    if (*s == '-' || *s == '+') {
+        negative = (*s == '-');
+        s++;
+    }
+    if (*s == '\0') return false;
+
+    int64_t value = 0;
+    bool fraction = false;
+    uint8_t integerDigits = 0;
+    uint8_t fractionDigits = 0;
+    for (; *s != '\0'; s++) {
+        if (*s == '.' && !fraction) {
+            fraction = true;
+        } else if (*s >= '0' && *s <= '9') {
+            if (!fraction) {
+                if (++integerDigits + decimals > MAX_FIXED_DIGITS) return false;
+                value = value * 10 + (*s - '0');
+            } else if (fractionDigits < decimals) {
+                value = value * 10 + (*s - '0');
+                fractionDigits++;
+            }
+        } else {
+            return false;
+        }
+    }
+    for (; fractionDigits < decimals; fractionDigits++) {
+        value *= 10;
+    }
+    *out = negative ? -value : value;
+    return true;
+}
+
+/**
+ * @brief Parse an NMEA "DDDMM.MMMM" coordinate into 1e-7 degrees.
+ * @param s Null-terminated coordinate field.
+ * @param hemisphere Hemisphere field ('N', 'S', 'E' or 'W').
+ * @param out Receives the signed coordinate.
+ * @return True if both fields were valid.
+ */
+bool parseCoordinate(const char *s, const char *hemisphere, int32_t *out)
+{
+    const char *dot = strchr(s, '.');
+    size_t integerDigits = dot ? (size_t)(dot - s) : strlen(s);
+    if (integerDigits < 3 || integerDigits > 5) return false; // DDMM or DDDMM
+
+    int64_t degrees = 0;
+    for (size_t i = 0; i < integerDigits - 2; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        degrees = degrees * 10 + (s[i] - '0');
+    }
+
+    int64_t minutes; // Minutes scaled by 1e7
+    if (!parseFixed(s + integerDigits - 2, 7, &minutes)) return false;
+
+    int64_t value = degrees * 10000000 + (minutes + 30) / 60;
+    if (hemisphere[0] == 'S' || hemisphere[0] == 'W') {
+        value = -value;
+    } else if (hemisphere[0] != 'N' && hemisphere[0] != 'E') {
+        return false;
+    }
+    *out = (int32_t)value;
+    return true;
+}
+
+/**
+ * @brief Parse an NMEA "hhmmss.sss" time into milliseconds since midnight.
+ */
+bool parseTime(const char *s, uint32_t *out)
+{
+    int64_t hhmmss; // hhmmss scaled by 1e3
+    if (!parseFixed(s, 3, &hhmmss) || hhmmss < 0) return false;
+    int64_t seconds = hhmmss / 1000;
+    *out = (uint32_t)((seconds / 10000) * 3600000 + ((seconds / 100) % 100) * 60000 +
+                      (seconds % 100) * 1000 + hhmmss % 1000);
+    return true;
+}
+
+/**
+ * @brief Parse a speed in knots into millimeters per second.
+ */
+bool parseKnots(const char *s, uint32_t *out)
+{
+    int64_t knots; // Knots scaled by 1e3
+    if (!parseFixed(s, 3, &knots) || knots < 0) return false;
+    *out = (uint32_t)((knots * 514444 + 500000) / 1000000); // 1 kn = 514.444 mm/s
+    return true;
+}
+
+/**
+ * @brief Parse a course in degrees into hundredths of a degree.
+ */
+bool parseCourse(const char *s, uint16_t *out)
+{
+    int64_t course;
+    if (!parseFixed(s, 2, &course) || course < 0 || course >= 36000) return false;
+    *out = (uint16_t)course;
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief Constructor for the NMEAParser class.
+ */
+NMEAParser::NMEAParser()
+{
+    reset();
+}
+
+/**
+ * @brief Discard any partial sentence and clear the fix and counters.
+ */
+void NMEAParser::reset()
+{
+    state = WAIT_START;
+    length = 0;
+    checksum = 0;
+    receivedChecksum = 0;
+    checksumDigits = 0;
+    memset(&fix, 0, sizeof(fix));
+    sentenceCount = 0;
+    checksumErrors = 0;
+    overflowCount = 0;
+}
+
+/**
+ * @brief Feed one character of the NMEA stream to the parser.
+ * @param c The received character.
+ * @return True if this character completed a sentence that updated the fix.
+ */
+bool NMEAParser::encode(char c)
+{
+    // A '$' always starts a new sentence, resynchronizing after line noise
+    if (c == '$') {
+        state = IN_BODY;
+        length = 0;
+        checksum = 0;
+        return false;
+    }
+
+    switch (state) {
+        case WAIT_START:
+            return false;
+
+        case IN_BODY:
+            if (c == '*') {
+                state = IN_CHECKSUM;
+                receivedChecksum = 0;
+                checksumDigits = 0;
+            } else if (c == '\r' || c == '\n') {
+                checksumErrors++; // Sentence without a checksum
+                state = WAIT_START;
+            } else if (length >= MAX_SENTENCE) {
+                overflowCount++;
+                state = WAIT_START;
+            } else {
+                buffer[length++] = c;
+                checksum ^= (uint8_t)c;
+            }
+            return false;
+
+        case IN_CHECKSUM: {
+            int digit = hexValue(c);
+            if (digit < 0) {
+                checksumErrors++;
+                state = WAIT_START;
+                return false;
+            }
+            receivedChecksum = (uint8_t)((receivedChecksum << 4) | digit);
+            if (++checksumDigits < 2) {
+                return false;
+            }
+            state = WAIT_START;
+            if (receivedChecksum != checksum) {
+                checksumErrors++;
+                return false;
+            }
+            sentenceCount++;
+            return decodeSentence();
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Feed a block of characters of the NMEA stream to the parser.
+ * @param data Pointer to the received characters.
+ * @param length Number of characters in @p data.
+ * @return Number of sentences in the block that updated the fix.
+ */
+size_t NMEAParser::encode(const char *data, size_t length)
+{
+    size_t decoded = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (encode(data[i])) {
+            decoded++;
+        }
+    }
+    return decoded;
+}
+
+/**
+ * @brief Get the fix assembled from the sentences decoded so far.
+ * @return Reference to the current fix.
+ */
+const GpsFix &NMEAParser::getFix() const
+{
+    return fix;
+}
+
+/**
+ * @brief Get the number of sentences that passed the checksum.
+ */
+uint32_t NMEAParser::getSentenceCount() const
+{
+    return sentenceCount;
+}
+
+/**
+ * @brief Get the number of sentences rejected for a bad or missing checksum.
+ */
+uint32_t NMEAParser::getChecksumErrors() const
+{
+    return checksumErrors;
+}
+
+/**
+ * @brief Get the number of sentences discarded for exceeding the buffer.
+ */
+uint32_t NMEAParser::getOverflowCount() const
+{
+    return overflowCount;
+}
+
+/**
+ * @brief Tokenize the buffered sentence in place and decode it.
+ * @return True if the sentence type is supported and updated the fix.
+ */
+bool NMEAParser::decodeSentence()
+{
+    buffer[length] = '\0';
+
+    char *fields[MAX_FIELDS];
+    size_t count = 0;
+    fields[count++] = buffer;
+    for (size_t i = 0; i < length && count < MAX_FIELDS; i++) {
+        if (buffer[i] == ',') {
+            buffer[i] = '\0';
+            fields[count++] = &buffer[i + 1];
+        }
+    }
+
+    // The address field is a two-letter talker ID followed by the sentence type
+    const char *type = fields[0];
+    if (strlen(type) != 5) return false;
+    type += 2;
+
+    if (strcmp(type, "GGA") == 0) return decodeGGA(fields, count);
+    if (strcmp(type, "RMC") == 0) return decodeRMC(fields, count);
+    if (strcmp(type, "VTG") == 0) return decodeVTG(fields, count);
+    return false;
+}
+
+/**
+ * @brief Decode a GGA (fix data) sentence.
+ * @return True if the sentence had enough fields to update the fix.
+ */
+bool NMEAParser::decodeGGA(char *const *fields, size_t count)
+{
+    if (count < 10) return false;
+
+    parseTime(fields[1], &fix.utcMillis);
+    parseCoordinate(fields[2], fields[3], &fix.latitude);
+    parseCoordinate(fields[4], fields[5], &fix.longitude);
+
+    int64_t value;
+    if (parseFixed(fields[6], 0, &value)) fix.fixQuality = (uint8_t)value;
+    if (parseFixed(fields[7], 0, &value)) fix.satellites = (uint8_t)value;
+    if (parseFixed(fields[8], 2, &value)) fix.hdop = (uint16_t)value;
+    if (parseFixed(fields[9], 3, &value)) fix.altitude = (int32_t)value;
+
+    fix.valid = fix.fixQuality > 0;
+    return true;
+}
+
+/**
+ * @brief Decode an RMC (recommended minimum) sentence.
+ * @return True if the sentence had enough fields to update the fix.
+ */
+bool NMEAParser::decodeRMC(char *const *fields, size_t count)
+{
+    if (count < 10) return false;
+
+    parseTime(fields[1], &fix.utcMillis);
+    fix.valid = (fields[2][0] == 'A');
+    parseCoordinate(fields[3], fields[4], &fix.latitude);
+    parseCoordinate(fields[5], fields[6], &fix.longitude);
+    parseKnots(fields[7], &fix.speed);
+    parseCourse(fields[8], &fix.course);
+
+    int64_t value;
+    if (parseFixed(fields[9], 0, &value)) fix.date = (uint32_t)value;
+    return true;
+}
+
+/**
+ * @brief Decode a VTG (track and ground speed) sentence.
+ * @return True if the sentence had enough fields to update the fix.
+ */
+bool NMEAParser::decodeVTG(char *const *fields, size_t count)
+{
+    if (count < 8) return false;
+
+    parseCourse(fields[1], &fix.course);
+
+    int64_t kmh; // km/h scaled by 1e3
+    if (parseFixed(fields[7], 3, &kmh) && kmh >= 0) {
+        fix.speed = (uint32_t)((kmh * 10 + 18) / 36); // 1 km/h = 1000/3.6 mm/s
+    } else {
+        parseKnots(fields[5], &fix.speed);
+    }
+    return true;
+}
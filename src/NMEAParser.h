@@ -0,0 +1,114 @@
+#ifndef NMEA_PARSER_H
+#define NMEA_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Position fix decoded from NMEA sentences.
+ *
+ * Plain-old-data so it can be copied between tasks without allocation. Angles
+ * are fixed point in units of 1e-7 degrees, which keeps centimeter resolution
+ * in an int32_t.
+ */
+typedef struct {
+    uint32_t utcMillis;   /**< UTC time of day in milliseconds. */
+    uint32_t date;        /**< UTC date as DDMMYY (RMC only), 0 if unknown. */
+    int32_t latitude;     /**< Latitude in 1e-7 degrees, north positive. */
+    int32_t longitude;    /**< Longitude in 1e-7 degrees, east positive. */
+    int32_t altitude;     /**< Altitude above mean sea level in millimeters. */
+    uint32_t speed;       /**< Speed over ground in millimeters per second. */
+    uint16_t course;      /**< Course over ground in hundredths of a degree. */
+    uint16_t hdop;        /**< Horizontal dilution of precision times 100. */
+    uint8_t fixQuality;   /**< GGA fix quality, 0 when there is no fix. */
+    uint8_t satellites;   /**< Number of satellites in use. */
+    bool valid;           /**< True when the receiver reports a usable fix. */
+} GpsFix;
+
+/**
+ * @class NMEAParser
+ * @brief Incremental, allocation-free NMEA 0183 parser.
+ *
+ * Characters are fed one at a time into a fixed sentence buffer. When the
+ * checksum of a complete sentence matches, the sentence is tokenized in place
+ * and GGA, RMC and VTG sentences from any talker are decoded into a GpsFix.
+ */
+class NMEAParser
+{
+public:
+    static const size_t MAX_SENTENCE = 82; /**< NMEA 0183 sentence length limit. */
+    static const size_t MAX_FIELDS = 24;   /**< Maximum number of comma-separated fields. */
+
+    /**
+     * @brief Constructor for the NMEAParser class.
+     */
+    NMEAParser();
+
+    /**
+     * @brief Feed one character of the NMEA stream to the parser.
+     * @param c The received character.
+     * @return True if this character completed a sentence that updated the fix.
+     */
+    bool encode(char c);
+
+    /**
+     * @brief Feed a block of characters of the NMEA stream to the parser.
+     * @param data Pointer to the received characters.
+     * @param length Number of characters in @p data.
+     * @return Number of sentences in the block that updated the fix.
+     */
+    size_t encode(const char *data, size_t length);
+
+    /**
+     * @brief Get the fix assembled from the sentences decoded so far.
+     * @return Reference to the current fix.
+     */
+    const GpsFix &getFix() const;
+
+    /**
+     * @brief Get the number of sentences that passed the checksum.
+     */
+    uint32_t getSentenceCount() const;
+
+    /**
+     * @brief Get the number of sentences rejected for a bad or missing checksum.
+     */
+    uint32_t getChecksumErrors() const;
+
+    /**
+     * @brief Get the number of sentences discarded for exceeding the buffer.
+     */
+    uint32_t getOverflowCount() const;
+
+    /**
+     * @brief Discard any partial sentence and clear the fix and counters.
+     */
+    void reset();
+
+private:
+    enum State { WAIT_START, IN_BODY, IN_CHECKSUM };
+
+    State state;                      /**< Current position within a sentence. */
+    char buffer[MAX_SENTENCE + 1];    /**< Sentence body between '$' and '*'. */
+    size_t length;                    /**< Number of characters in the buffer. */
+    uint8_t checksum;                 /**< Running XOR of the sentence body. */
+    uint8_t receivedChecksum;         /**< Checksum digits received after '*'. */
+    uint8_t checksumDigits;           /**< Number of checksum digits received. */
+
+    GpsFix fix;                       /**< Fix assembled from decoded sentences. */
+    uint32_t sentenceCount;           /**< Sentences with a matching checksum. */
+    uint32_t checksumErrors;          /**< Sentences with a bad checksum. */
+    uint32_t overflowCount;           /**< Sentences longer than the buffer. */
+
+    /**
+     * @brief Tokenize the buffered sentence in place and decode it.
+     * @return True if the sentence type is supported and updated the fix.
+     */
+    bool decodeSentence();
+
+    bool decodeGGA(char *const *fields, size_t count);
+    bool decodeRMC(char *const *fields, size_t count);
+    bool decodeVTG(char *const *fields, size_t count);
+};
+
+#endif
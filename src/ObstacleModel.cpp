@@ -0,0 +1,121 @@
+/** @file ObstacleModel.cpp
+ *  @brief Implementation of the TOF obstacle model.
+ */
+
+#include "ObstacleModel.h"
+
+#include <math.h>
+
+ObstacleParams ObstacleParams::defaults() {
+    ObstacleParams p;
+    p.minSignalRate = 0.5f;
+    p.maxSigma = 30.0f;
+    p.alpha = 0.5f;
+    p.beta = 0.15f;
+    p.enterDistance = 150.0f;
+    p.exitDistance = 200.0f;
+    p.enterTimeToCollision = 0.8f;
+    p.exitTimeToCollision = 1.2f;
+    p.minClosingSpeed = 20.0f;
+    p.maxMissedFrames = 3;
+    return p;
+}
+
+ObstacleModel::ObstacleModel(const ObstacleParams &params) : params(params) {
+    reset();
+}
+
+void ObstacleModel::reset() {
+    state.tracking = false;
+    state.detected = false;
+    state.validTargets = 0;
+    state.distance = 0;
+    state.closingSpeed = 0;
+    state.timeToCollision = INFINITY;
+    windowCount = 0;
+    windowIndex = 0;
+    missedFrames = 0;
+    lastTimestamp = 0;
+}
+
+bool ObstacleModel::isValidStatus(uint8_t status) {
+    // Valid, valid but clipped at minimum range, valid without wrap check, valid merged pulse
+    return status == 0 || status == 3 || status == 6 || status == 11;
+}
+
+static float median3(float a, float b, float c) {
+    if (a > b) {
+        float t = a;
+        a = b;
+        b = t;
+    }
+    return c < a ? a : (c > b ? b : c);
+}
+
+const ObstacleState &ObstacleModel::update(const TofFrame &frame) {
+    // Nearest target that passes every check
+    float nearest = INFINITY;
+    uint8_t valid = 0;
+    uint8_t count = frame.count < TOF_MAX_TARGETS ? frame.count : TOF_MAX_TARGETS;
+    for (uint8_t i = 0; i < count; i++) {
+        const TofTarget &target = frame.targets[i];
+        if (!isValidStatus(target.status) || target.signalRate < params.minSignalRate ||
+            target.sigma > params.maxSigma) {
+            continue;
+        }
+        valid++;
+        if (target.distance < nearest) {
+            nearest = target.distance;
+        }
+    }
+    state.validTargets = valid;
+
+    if (valid == 0) {
+        if (missedFrames < 255) {
+            missedFrames++;
+        }
+        if (missedFrames > params.maxMissedFrames) {
+            // Nothing in view any more: forget the track and clear the obstacle
+            reset();
+        }
+        return state;
+    }
+    missedFrames = 0;
+
+    window[windowIndex] = nearest;
+    windowIndex = (uint8_t)((windowIndex + 1) % 3);
+    if (windowCount < 3) {
+        windowCount++;
+    }
+    float measured = windowCount >= 3 ? median3(window[0], window[1], window[2]) : nearest;
+
+    if (!state.tracking) {
+        state.tracking = true;
+        state.distance = measured;
+        state.closingSpeed = 0;
+    } else {
+        float dt = (frame.timestamp - lastTimestamp) * 1e-6f;
+        if (dt > 0) {
+            // Alpha-beta filter: predict with the closing speed, then correct with the residual
+            float predicted = state.distance - state.closingSpeed * dt;
+            float residual = measured - predicted;
+            state.distance = predicted + params.alpha * residual;
+            state.closingSpeed -= params.beta * residual / dt;
+        }
+    }
+    lastTimestamp = frame.timestamp;
+
+    state.timeToCollision = state.closingSpeed > params.minClosingSpeed ? state.distance / state.closingSpeed
+                                                                        : INFINITY;
+
+    if (state.detected) {
+        state.detected = state.distance <= params.exitDistance || state.timeToCollision <= params.exitTimeToCollision;
+    } else {
+        state.detected = state.distance <= params.enterDistance || state.timeToCollision <= params.enterTimeToCollision;
+    }
+    return state;
+}
+
+const ObstacleState &ObstacleModel::getState() const {
+    return state;
+}
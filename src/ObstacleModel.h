@@ -0,0 +1,97 @@
+/** @file ObstacleModel.h
+ *  @brief Obstacle tracking from multi-target TOF ranges.
+ */
+
+#ifndef OBSTACLE_MODEL_H
+#define OBSTACLE_MODEL_H
+
+#include <stdint.h>
+#include "HAL.h"
+
+/**
+ *  @brief Tuning of the obstacle model.
+ */
+struct ObstacleParams {
+    float minSignalRate;        /**< Weakest accepted return signal in mega counts per second. */
+    float maxSigma;             /**< Largest accepted distance uncertainty in mm. */
+    float alpha;                /**< Alpha-beta filter position gain, 0 to 1. */
+    float beta;                 /**< Alpha-beta filter rate gain, 0 to 1. */
+    float enterDistance;        /**< Obstacle reported at or below this distance in mm. */
+    float exitDistance;         /**< Obstacle cleared above this distance in mm. */
+    float enterTimeToCollision; /**< Obstacle reported at or below this time to collision in s. */
+    float exitTimeToCollision;  /**< Obstacle cleared above this time to collision in s. */
+    float minClosingSpeed;      /**< Closing speed in mm/s below which the time to collision is infinite. */
+    uint8_t maxMissedFrames;    /**< Frames without a valid target before the track is dropped. */
+
+    /**
+     *  @brief Gets parameters suited to the VL53L4CX in long distance mode at 20 Hz.
+     */
+    static ObstacleParams defaults();
+};
+
+/**
+ *  @brief Output of the obstacle model.
+ */
+typedef struct {
+    bool tracking;          /**< A valid target has been seen within maxMissedFrames. */
+    bool detected;          /**< Obstacle ahead, with hysteresis between the enter and exit thresholds. */
+    uint8_t validTargets;   /**< Targets in the latest frame that passed the status and signal checks. */
+    float distance;         /**< Filtered distance to the nearest valid target in mm. */
+    float closingSpeed;     /**< Filtered closing speed in mm/s, positive when approaching. */
+    float timeToCollision;  /**< Time to collision in s at the current closing speed, or INFINITY. */
+} ObstacleState;
+
+/**
+ *  @class ObstacleModel
+ *  @brief Turns raw TOF frames into a stable obstacle distance, closing speed and time to collision.
+ *
+ *  Each frame is reduced to the nearest target whose range status is valid
+ *  and whose signal rate and sigma pass the thresholds. That distance goes
+ *  through a 3-sample median, which removes single-frame spikes, and then an
+ *  alpha-beta filter, which tracks distance and closing speed. The detected
+ *  flag has separate enter and exit thresholds, so it does not flicker
+ *  around a single limit. All state is fixed size and update() does no
+ *  allocation.
+ */
+class ObstacleModel {
+public:
+    /**
+     *  @brief Constructor for the ObstacleModel class.
+     *  @param params Tuning of the model.
+     */
+    ObstacleModel(const ObstacleParams &params = ObstacleParams::defaults());
+
+    /**
+     *  @brief Drops the track and clears the detected flag.
+     */
+    void reset();
+
+    /**
+     *  @brief Adds a TOF frame.
+     *  @param frame Newly completed range.
+     *  @return The updated obstacle state.
+     */
+    const ObstacleState &update(const TofFrame &frame);
+
+    /**
+     *  @brief Gets the obstacle state after the latest frame.
+     */
+    const ObstacleState &getState() const;
+
+    /**
+     *  @brief Checks if a VL53L4CX range status describes a usable distance.
+     *  @param status Range status reported with the target.
+     */
+    static bool isValidStatus(uint8_t status);
+
+private:
+    ObstacleParams params;
+    ObstacleState state;
+    float window[3];        /**< Latest nearest-target distances for the median. */
+    uint8_t windowCount;    /**< Number of valid entries in window. */
+    uint8_t windowIndex;    /**< Entry of window written next. */
+    uint8_t missedFrames;   /**< Consecutive frames without a valid target. */
+    int64_t lastTimestamp;  /**< Time of the latest frame with a valid target. */
+};
+
+#endif
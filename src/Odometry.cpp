@@ -0,0 +1,119 @@
+/** @file Odometry.cpp
+ *  @brief Implementation of the differential-drive odometry.
+ */
+
+#include "Odometry.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "ConeBot.h"
+
+static const float PI_F = 3.14159265f;
+
+OdometryParams OdometryParams::defaults() {
+    OdometryParams p;
+    p.metersPerCount = 2.0f * PI_F * WHEEL_RADIUS_M / ENCODER_COUNTS_PER_REV;
+    p.trackWidth = WHEEL_TRACK_M;
+    p.windowMicros = 5 * CONTROL_PERIOD_US;
+    p.minWindowCounts = 4;
+    p.stopTimeoutMicros = 250000;
+    return p;
+}
+
+Odometry::Odometry(const OdometryParams &params) : params(params) {
+    reset();
+}
+
+void Odometry::reset() {
+    memset(&state, 0, sizeof(state));
+    memset(&left, 0, sizeof(left));
+    memset(&right, 0, sizeof(right));
+    head = 0;
+    count = 0;
+    windowBack = 0;
+}
+
+const OdometryState &Odometry::update(int64_t timestamp, int64_t leftCount, int64_t rightCount) {
+    int32_t leftStep = count ? (int32_t)(leftCount - left.lastCount) : 0;
+    int32_t rightStep = count ? (int32_t)(rightCount - right.lastCount) : 0;
+    head = (head + 1) % HISTORY;
+    record(left, timestamp, leftCount);
+    record(right, timestamp, rightCount);
+    if (count < HISTORY) {
+        count++;
+    }
+
+    // Pose, integrated along the mean heading of the step
+    float leftTravel = leftStep * params.metersPerCount;
+    float rightTravel = rightStep * params.metersPerCount;
+    float travel = 0.5f * (leftTravel + rightTravel);
+    float turn = (rightTravel - leftTravel) / params.trackWidth;
+    float midHeading = state.heading + 0.5f * turn;
+    state.x += travel * cosf(midHeading);
+    state.y += travel * sinf(midHeading);
+    state.heading += turn;
+    if (state.heading > PI_F) {
+        state.heading -= 2.0f * PI_F;
+    } else if (state.heading <= -PI_F) {
+        state.heading += 2.0f * PI_F;
+    }
+    state.distance += travel;
+
+    state.timestamp = timestamp;
+    advanceWindow(timestamp);
+    state.leftVelocity = wheelSpeed(left, timestamp) * params.metersPerCount;
+    state.rightVelocity = wheelSpeed(right, timestamp) * params.metersPerCount;
+    state.velocity = 0.5f * (state.leftVelocity + state.rightVelocity);
+    state.yawRate = (state.rightVelocity - state.leftVelocity) / params.trackWidth;
+    return state;
+}
+
+const OdometryState &Odometry::getState() const {
+    return state;
+}
+
+void Odometry::record(Wheel &wheel, int64_t timestamp, int64_t value) {
+    if (count > 0 && value != wheel.lastCount) {
+        int32_t step = (int32_t)(value - wheel.lastCount);
+        // A reversal, or an encoder dithering on an edge, says nothing about speed
+        wheel.previousChange = (step > 0) == (wheel.lastStep > 0) ? wheel.lastChange : 0;
+        wheel.lastChange = timestamp;
+        wheel.lastStep = step;
+    }
+    wheel.counts[head] = value;
+    wheel.times[head] = timestamp;
+    wheel.lastCount = value;
+}
+
+void Odometry::advanceWindow(int64_t now) {
+    // The previous start is one sample further back now; move it forward while the next newer sample is old
+    // enough. Both wheels share their sample times.
+    windowBack = windowBack + 1 < count ? windowBack + 1 : count - 1;
+    while (windowBack > 1 && now - left.times[(head + HISTORY - windowBack + 1) % HISTORY] >= params.windowMicros) {
+        windowBack--;
+    }
+}
+
+float Odometry::wheelSpeed(const Wheel &wheel, int64_t now) const {
+    // Counts over the window, reaching back to the newest sample at least windowMicros old
+    uint32_t oldest = (head + HISTORY - windowBack) % HISTORY;
+    int32_t counts = (int32_t)(wheel.counts[head] - wheel.counts[oldest]);
+    int64_t span = wheel.times[head] - wheel.times[oldest];
+    if (span > 0 && (counts >= params.minWindowCounts || counts <= -params.minWindowCounts)) {
+        return counts * 1e6f / (float)span;
+    }
+
+    // Too few counts: time between count changes, decaying while no new count arrives
+    if (wheel.lastChange == 0 || now - wheel.lastChange > params.stopTimeoutMicros) {
+        return 0.0f;
+    }
+    if (wheel.previousChange == 0) {
+        return span > 0 ? counts * 1e6f / (float)span : 0.0f;
+    }
+    int64_t interval = wheel.lastChange - wheel.previousChange;
+    if (now - wheel.lastChange > interval) {
+        interval = now - wheel.lastChange;
+    }
+    return wheel.lastStep * 1e6f / (float)interval;
+}
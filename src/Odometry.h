@@ -0,0 +1,120 @@
+/** @file Odometry.h
+ *  @brief Differential-drive odometry and wheel velocity estimation from encoder counts.
+ */
+
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <stdint.h>
+
+/**
+ *  @brief Geometry and tuning of the odometry.
+ */
+struct OdometryParams {
+    float metersPerCount;        /**< Wheel travel per encoder count in m. */
+    float trackWidth;            /**< Distance between the wheel contact points in m. */
+    int64_t windowMicros;        /**< Span of the counts-over-time velocity window. */
+    int32_t minWindowCounts;     /**< Fewest counts in the window for the counts-over-time estimate. */
+    int64_t stopTimeoutMicros;   /**< Time without a count after which a wheel reads as stopped. */
+
+    /**
+     *  @brief Gets parameters for the ConeBot wheels, encoders and control rate.
+     */
+    static OdometryParams defaults();
+};
+
+/**
+ *  @brief Pose and velocities of the robot after one encoder sample.
+ */
+typedef struct {
+    int64_t timestamp;      /**< Time of the encoder sample, from nowMicros(). */
+    float x;                /**< Position along the initial heading in m. */
+    float y;                /**< Position to the left of the initial heading in m. */
+    float heading;          /**< Heading in rad, counterclockwise from the initial heading. */
+    float distance;         /**< Mean travel of both wheels in m, forward positive. */
+    float leftVelocity;     /**< Left wheel speed in m/s. */
+    float rightVelocity;    /**< Right wheel speed in m/s. */
+    float velocity;         /**< Forward speed in m/s, the mean of both wheels. */
+    float yawRate;          /**< Turn rate in rad/s, counterclockwise positive. */
+} OdometryState;
+
+/**
+ *  @class Odometry
+ *  @brief Tracks pose and wheel speeds from simultaneous samples of both encoders.
+ *
+ *  Each wheel speed is the count change over a short window of recent
+ *  samples. Below minWindowCounts per window that estimate is too coarse, so
+ *  the speed comes instead from the time between the last two samples at
+ *  which the count changed in the same direction, which resolves speeds down
+ *  to one count per stopTimeoutMicros. The pose is integrated with the midpoint heading of
+ *  each step. The start of the window only moves forward in time, so it is
+ *  carried from one sample to the next instead of searched for; update()
+ *  takes a constant number of operations on average, at most HISTORY
+ *  comparisons, and does no allocation.
+ */
+class Odometry {
+public:
+    /**
+     *  @brief Constructor for the Odometry class.
+     *  @param params Geometry and tuning.
+     */
+    Odometry(const OdometryParams &params = OdometryParams::defaults());
+
+    /**
+     *  @brief Resets the pose to the origin and forgets the velocity history.
+     */
+    void reset();
+
+    /**
+     *  @brief Adds a sample of both encoders.
+     *  @param timestamp Time both encoders were read, from nowMicros().
+     *  @param left Left encoder count.
+     *  @param right Right encoder count.
+     *  @return The updated pose and velocities.
+     */
+    const OdometryState &update(int64_t timestamp, int64_t left, int64_t right);
+
+    /**
+     *  @brief Gets the pose and velocities after the latest sample.
+     */
+    const OdometryState &getState() const;
+
+private:
+    static const uint32_t HISTORY = 32; /**< Samples kept per wheel, enough for the window at 1 kHz. */
+
+    /**
+     *  @brief Velocity estimator of one wheel.
+     */
+    struct Wheel {
+        int64_t counts[HISTORY];    /**< Recent counts, oldest overwritten first. */
+        int64_t times[HISTORY];     /**< Sample times of counts. */
+        int64_t lastCount;          /**< Count at the latest sample. */
+        int64_t lastChange;         /**< Time of the latest sample whose count differed from the one before. */
+        int64_t previousChange;     /**< Time of the change before that, or 0 if it went the other way. */
+        int32_t lastStep;           /**< Count difference at lastChange. */
+    };
+
+    OdometryParams params;
+    OdometryState state;
+    Wheel left, right;
+    uint32_t head;          /**< Index of the latest sample in the wheel histories. */
+    uint32_t count;         /**< Samples in the histories, up to HISTORY. */
+    uint32_t windowBack;    /**< Samples from head back to the start of the velocity window. */
+
+    /**
+     *  @brief Moves the start of the velocity window to the newest sample at least windowMicros old.
+     */
+    void advanceWindow(int64_t now);
+
+    /**
+     *  @brief Estimates one wheel's speed in counts per second from its history.
+     */
+    float wheelSpeed(const Wheel &wheel, int64_t now) const;
+
+    /**
+     *  @brief Records a new count of one wheel.
+     */
+    void record(Wheel &wheel, int64_t timestamp, int64_t value);
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @class SampleRing
+ * @brief Fixed-capacity, single-writer ring of the most recent N samples of type T.
+ *
+ * The writer never waits: push() overwrites the oldest sample once the ring
+ * is full. Every consumer keeps its own Reader cursor, so the controller,
+ * logger and telemetry each see the full sample stream at their own pace,
+ * and for each of them the ring behaves as its own single-producer,
+ * single-consumer queue. A consumer that falls more than N samples behind
+ * skips to the oldest sample still held and counts the ones it lost.
+ *
+ * Each slot carries the sequence number of the sample in it, set odd while
+ * the slot is being written. A reader checks it before and after copying and
+ * treats a mismatch as the sample having been overwritten, so readers take no
+ * lock, never wait for a preempted writer and never see a torn sample. T must be
+ * trivially copyable and push() must only ever be called from one task.
+ *
+ * @tparam T Sample type.
+ * @tparam N Capacity in samples, a power of two.
+ */
+template <typename T, uint32_t N>
+class SampleRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Ring capacity must be a power of two");
+
+public:
+    static const uint32_t CAPACITY = N; /**< Capacity in samples. */
+
+    /**
+     * @brief Read position of one consumer.
+     */
+    struct Reader {
+        uint32_t next;      /**< Sequence number of the next sample to read. */
+        uint32_t dropped;   /**< Samples overwritten before this consumer read them. */
+    };
+
+    /**
+     * @brief Constructor for the SampleRing class; the ring starts empty.
+     */
+    SampleRing() : head(0)
+    {
+        for (uint32_t i = 0; i < N; i++) {
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Appends a sample, overwriting the oldest one if the ring is full.
+     * @param sample The sample to append.
+     */
+    void push(const T &sample)
+    {
+        uint32_t index = head.load(std::memory_order_relaxed);
+        Slot &slot = slots[index & (N - 1)];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.value = sample;
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Creates a reader that starts with the next sample pushed.
+     */
+    Reader reader() const
+    {
+        Reader r;
+        r.next = head.load(std::memory_order_acquire);
+        r.dropped = 0;
+        return r;
+    }
+
+    /**
+     * @brief Reads the next sample a consumer has not seen yet.
+     * @param r Cursor of the consumer; advanced on success.
+     * @param out Receives the sample.
+     * @return True if a sample was copied, false if the consumer is up to date.
+     */
+    bool read(Reader &r, T &out) const
+    {
+        while (1) {
+            uint32_t end = head.load(std::memory_order_acquire);
+            if (r.next == end) {
+                return false;
+            }
+            if (end - r.next > N) {
+                r.dropped += end - r.next - N;
+                r.next = end - N;
+            }
+            bool copied = copy(r.next, out);
+            r.next++;
+            if (copied) {
+                return true;
+            }
+            // The writer lapped us and is overwriting this slot; the sample is gone
+            r.dropped++;
+        }
+    }
+
+    /**
+     * @brief Reads the newest sample without affecting any reader.
+     * @param out Receives the sample.
+     * @return True if a sample was copied, false if nothing was pushed yet.
+     */
+    bool latest(T &out) const
+    {
+        while (1) {
+            uint32_t end = head.load(std::memory_order_acquire);
+            if (end == 0) {
+                return false;
+            }
+            if (copy(end - 1, out)) {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * @brief Gets the newest sample, or a value-initialized one if nothing was pushed yet.
+     */
+    T latest() const
+    {
+        T out = T();
+        latest(out);
+        return out;
+    }
+
+    /**
+     * @brief Gets the number of samples pushed so far.
+     */
+    uint32_t count() const
+    {
+        return head.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence; /**< 2n + 2 once sample n is in the slot, odd while it is written. */
+        T value;                        /**< The sample. */
+    };
+
+    std::atomic<uint32_t> head; /**< Sequence number of the next sample to push. */
+    Slot slots[N];
+
+    /**
+     * @brief Copies sample @p index out of its slot.
+     * @return False if the slot no longer, or not yet, holds that sample.
+     */
+    bool copy(uint32_t index, T &out) const
+    {
+        const Slot &slot = slots[index & (N - 1)];
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != 2 * index + 2) {
+            return false;
+        }
+        out = slot.value;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == before;
+    }
+};
+
+#endif
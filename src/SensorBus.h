@@ -0,0 +1,80 @@
+/** @file SensorBus.h
+ *  @brief Recent timestamped samples of every sensor, shared between producer and consumer tasks.
+ */
+
+#ifndef SENSOR_BUS_H
+#define SENSOR_BUS_H
+
+#include <stdint.h>
+#include "SampleRing.h"
+#include "Command.h"
+#include "NMEAParser.h"
+#include "ObstacleModel.h"
+#include "Odometry.h"
+#include "Telemetry.h"
+
+/**
+ *  @brief One IMU reading.
+ */
+typedef struct {
+    int64_t timestamp;   /**< Time of the reading, from nowMicros(). */
+    float pitch;         /**< Pitch in degrees, leaning forward positive. */
+    float pitchRate;     /**< Pitch rate in degrees per second. */
+} ImuSample;
+
+/**
+ *  @brief One reading of both wheel encoders.
+ */
+typedef struct {
+    int64_t timestamp;   /**< Time of the reading, from nowMicros(). */
+    int64_t left;        /**< Left encoder count. */
+    int64_t right;       /**< Right encoder count. */
+} EncoderSample;
+
+/**
+ *  @brief Obstacle model output after one TOF range.
+ */
+typedef struct {
+    int64_t timestamp;       /**< Time the range was read, from nowMicros(). */
+    ObstacleState obstacle;  /**< Filtered obstacle state. */
+} ObstacleSample;
+
+/**
+ *  @brief One GPS fix.
+ */
+typedef struct {
+    int64_t timestamp;   /**< Time the fix was decoded, from nowMicros(). */
+    GpsFix fix;          /**< The fix. */
+} GpsSample;
+
+/**
+ *  @brief One command as applied by the motor control loop.
+ */
+typedef struct {
+    int64_t timestamp;   /**< Time the command was applied, from nowMicros(). */
+    Command command;     /**< The command. */
+} CommandSample;
+
+/**
+ *  @brief Recent samples of each sensor, and of the control loop's inputs and output.
+ *
+ *  Every ring has exactly one writer, the producer task of that sensor, which
+ *  publishes at the sensor's own rate. Any number of consumers read the rings
+ *  without locks and without waiting on the producers, so a slow sensor never
+ *  holds up the others or the control loop. The control loop takes the newest
+ *  sample of each ring; a consumer that needs every sample, such as a logger,
+ *  keeps its own SampleRing::Reader. The rings hold at least half a second of
+ *  samples at the nominal sensor rates.
+ */
+struct SensorBus {
+    SampleRing<ImuSample, 64> imu;            /**< Written by the IMU task at 100 Hz. */
+    SampleRing<EncoderSample, 512> encoders;  /**< Written by the wheel speed loop every cycle. */
+    SampleRing<OdometryState, 512> odometry;  /**< Written by the wheel speed loop with every encoder sample. */
+    SampleRing<TofFrame, 16> tof;             /**< Written by the TOF ranging task at 20 Hz. */
+    SampleRing<ObstacleSample, 16> obstacle;  /**< Written by the TOF ranging task with every TOF frame. */
+    SampleRing<GpsSample, 8> gps;             /**< Written by the GPS ingest task at 1 to 10 Hz. */
+    SampleRing<CommandSample, 16> commands;   /**< Written by the motor control loop with every command it applies. */
+    SampleRing<ControlSample, 1024> control;  /**< Written by the motor control loop every cycle; 2 s, see MQTTClientESP32. */
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @class SpscQueue
+ * @brief Fixed-capacity, lock-free queue from exactly one producer task to exactly one consumer task.
+ *
+ * Unlike SampleRing, nothing is ever overwritten: push() fails when the
+ * queue is full, so every item that was accepted is delivered exactly once,
+ * in order. The producer only writes the tail and the consumer only writes
+ * the head, so neither ever takes a lock or waits for the other, and both
+ * ends are safe to call from a task that must not block. T must be
+ * trivially copyable.
+ *
+ * @tparam T Item type.
+ * @tparam N Capacity in items, a power of two.
+ */
+template <typename T, uint32_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Queue capacity must be a power of two");
+
+public:
+    /**
+     * @brief Constructor for the SpscQueue class; the queue starts empty.
+     */
+    SpscQueue() : head(0), tail(0), rejected(0)
+    {
+    }
+
+    /**
+     * @brief Appends an item; only call from the producer.
+     * @param item Item to append.
+     * @return False if the queue is full and the item was not added.
+     */
+    bool push(const T &item)
+    {
+        uint32_t end = tail.load(std::memory_order_relaxed);
+        if (end - head.load(std::memory_order_acquire) >= N) {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[end & (N - 1)] = item;
+        tail.store(end + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item; only call from the consumer.
+     * @param out Receives the item.
+     * @return False if the queue is empty.
+     */
+    bool pop(T &out)
+    {
+        uint32_t start = head.load(std::memory_order_relaxed);
+        if (start == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = items[start & (N - 1)];
+        head.store(start + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Gets the number of items push() turned away because the queue was full.
+     */
+    uint32_t getRejected() const
+    {
+        return rejected.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint32_t> head;     /**< Count of items popped. */
+    std::atomic<uint32_t> tail;     /**< Count of items pushed. */
+    std::atomic<uint32_t> rejected; /**< Count of items turned away. */
+    T items[N];
+};
+
+#endif
@@ -0,0 +1,95 @@
+/** @file StoreAndForward.cpp
+ *  @brief Implementation of the store-and-forward broker link.
+ */
+
+#include "StoreAndForward.h"
+
+#include <string.h>
+
+StoreAndForward::StoreAndForward(MQTTInterface &link)
+    : link(link), head(0), tail(0), wrapAt(STORE_AND_FORWARD_CAPACITY), wrapped(false) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool StoreAndForward::connected() {
+    return link.connected();
+}
+
+bool StoreAndForward::publish(const char* topic, const uint8_t* payload, size_t length) {
+    if (stats.pending == 0 && link.connected() && link.publish(topic, payload, length)) {
+        return true;
+    }
+    return store(topic, payload, length);
+}
+
+uint32_t StoreAndForward::flush(uint32_t maxMessages) {
+    uint32_t sent = 0;
+    while (sent < maxMessages && stats.pending > 0 && link.connected()) {
+        Entry entry;
+        memcpy(&entry, buffer + head, sizeof(entry));
+        if (!link.publish(entry.topic, buffer + head + sizeof(entry), entry.length)) {
+            break;
+        }
+        dropOldest();
+        stats.replayed++;
+        sent++;
+    }
+    return sent;
+}
+
+StoreAndForwardStats StoreAndForward::getStats() const {
+    return stats;
+}
+
+bool StoreAndForward::store(const char *topic, const uint8_t *payload, size_t length) {
+    size_t size = sizeof(Entry) + length;
+    if (size > STORE_AND_FORWARD_CAPACITY) {
+        return false;
+    }
+    size_t offset;
+    while (1) {
+        if (stats.pending == 0) {
+            head = tail = 0;
+            wrapAt = STORE_AND_FORWARD_CAPACITY;
+            wrapped = false;
+        }
+        if (wrapped) {
+            if (head - tail >= size) {
+                offset = tail;
+                break;
+            }
+        } else if (STORE_AND_FORWARD_CAPACITY - tail >= size) {
+            offset = tail;
+            break;
+        } else if (head >= size) {
+            wrapAt = tail;
+            wrapped = true;
+            offset = 0;
+            break;
+        }
+        dropOldest();
+        stats.dropped++;
+    }
+
+    Entry entry = {topic, length};
+    memcpy(buffer + offset, &entry, sizeof(entry));
+    memcpy(buffer + offset + sizeof(entry), payload, length);
+    tail = offset + size;
+    stats.pending++;
+    stats.pendingBytes += size;
+    stats.stored++;
+    return true;
+}
+
+void StoreAndForward::dropOldest() {
+    Entry entry;
+    memcpy(&entry, buffer + head, sizeof(entry));
+    head += sizeof(entry) + entry.length;
+    stats.pending--;
+    stats.pendingBytes -= sizeof(entry) + entry.length;
+    if (wrapped && head >= wrapAt) {
+        head = 0;
+        wrapAt = STORE_AND_FORWARD_CAPACITY;
+        wrapped = false;
+    }
+}
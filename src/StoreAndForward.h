@@ -0,0 +1,94 @@
+/** @file StoreAndForward.h
+ *  @brief Bounded buffering of MQTT messages while the broker is unreachable.
+ */
+
+#ifndef STORE_AND_FORWARD_H
+#define STORE_AND_FORWARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "HAL.h"
+
+/** @brief Bytes of messages a StoreAndForward holds, including a small header per message. */
+static const size_t STORE_AND_FORWARD_CAPACITY = 32768;
+
+/**
+ *  @brief Message counts of a StoreAndForward.
+ */
+typedef struct {
+    uint32_t stored;        /**< Messages buffered because the link was down or busy with the backlog. */
+    uint32_t replayed;      /**< Buffered messages sent once the link returned. */
+    uint32_t dropped;       /**< Buffered messages discarded to make room for newer ones. */
+    uint32_t pending;       /**< Messages buffered now. */
+    size_t pendingBytes;    /**< Bytes buffered now, headers included. */
+} StoreAndForwardStats;
+
+/**
+ *  @class StoreAndForward
+ *  @brief Broker link that buffers messages while the underlying link is down and replays them in order.
+ *
+ *  While the link is up and nothing is buffered, publish() passes messages
+ *  straight through. Otherwise they are copied into a fixed ring, which
+ *  drops the oldest messages to make room once it is full, so an outage
+ *  costs the start of the gap rather than the newest data. flush() sends
+ *  the backlog oldest first, a bounded number of messages per call, and
+ *  new messages queue behind it so the broker sees them in order. Topics
+ *  are kept by pointer, so they must be string literals or otherwise
+ *  outlive the buffer. Nothing is allocated. Use from one task only.
+ */
+class StoreAndForward : public MQTTInterface {
+public:
+    /**
+     *  @brief Constructor for the StoreAndForward class; the buffer starts empty.
+     *  @param link Link the messages are sent over.
+     */
+    StoreAndForward(MQTTInterface &link);
+
+    /**
+     *  @brief Checks if the underlying link is up.
+     */
+    bool connected() override;
+
+    /**
+     *  @brief Sends a message, or buffers it if the link is down or a backlog is waiting.
+     *  @param topic The topic to publish to; must outlive the buffer.
+     *  @param payload Pointer to the message payload.
+     *  @param length Length of the payload in bytes.
+     *  @return True if the message was sent or buffered, false if it is larger than the buffer.
+     */
+    bool publish(const char* topic, const uint8_t* payload, size_t length) override;
+
+    /**
+     *  @brief Sends buffered messages, oldest first, while the link is up.
+     *  @param maxMessages Most messages to send in this call.
+     *  @return Number of messages sent.
+     */
+    uint32_t flush(uint32_t maxMessages);
+
+    /**
+     *  @brief Gets the message counts.
+     */
+    StoreAndForwardStats getStats() const;
+
+private:
+    /**
+     *  @brief Header stored in front of each message.
+     */
+    struct Entry {
+        const char *topic;      /**< Topic of the message. */
+        size_t length;          /**< Payload bytes following the header. */
+    };
+
+    MQTTInterface &link;
+    uint8_t buffer[STORE_AND_FORWARD_CAPACITY];
+    size_t head;                /**< Offset of the oldest message. */
+    size_t tail;                /**< Offset the next message is written at. */
+    size_t wrapAt;              /**< End of the messages before the write position wrapped to 0. */
+    bool wrapped;               /**< Messages run from head to wrapAt and then from 0 to tail. */
+    StoreAndForwardStats stats;
+
+    bool store(const char *topic, const uint8_t *payload, size_t length);
+    void dropOldest();
+};
+
+#endif
@@ -1,11 +1,50 @@
 #include "TOF.h"
+#include <esp_timer.h>
 
 /**
  * @brief Constructor for the TOF class.
  * 
  * Initializes the TOF instance but does not perform sensor initialization.
+ *
+ * @param interruptPin GPIO connected to the sensor's GPIO1 output, or -1 to poll for data.
  */
-TOF::TOF() {}
+TOF::TOF(int interruptPin)
+    : interruptPin(interruptPin), task(NULL), starter(NULL), sensorReady(false), edgeTime(0), readyTime(0),
+      listener(NULL), listenerContext(NULL), counters(), frameVersion(0), frame() {}
+
+/**
+ * @brief Sets a function the ranging task calls with every new range; call before begin().
+ * @param listener Function to call, or NULL for none.
+ * @param context Argument passed to @p listener.
+ */
+void TOF::setListener(FrameListener listener, void *context)
+{
+    this->listener = listener;
+    listenerContext = context;
+}
+
+/**
+ * @brief Starts the ranging task and waits for it to initialize the VL53L4CX sensor.
+ * 
+ * @param priority FreeRTOS priority of the ranging task.
+ * @param core Core the ranging task is pinned to.
+ * @param stackSize Stack size of the ranging task in bytes.
+ * @return True if the task was started and the sensor initialized, false otherwise.
+ */
+bool TOF::begin(UBaseType_t priority, BaseType_t core, uint32_t stackSize)
+{
+    starter = xTaskGetCurrentTaskHandle();
+    if (xTaskCreatePinnedToCore(rangingTask, "TOFTask", stackSize, this, priority, &task, core) != pdPASS) {
+        Serial.println("Failed to start TOF task.");
+        return false;
+    }
+    // The task notifies once initSensor() has finished, successfully or not
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(INIT_TIMEOUT_MS)) == 0) {
+        Serial.println("Timed out initializing VL53L4CX sensor.");
+        return false;
+    }
+    return sensorReady;
+}
 
 /**
  * @brief Initializes the VL53L4CX sensor with default settings.
@@ -15,7 +54,7 @@ TOF::TOF() {}
  * 
  * @return True if initialization is successful, false otherwise.
  */
-bool TOF::begin() 
+bool TOF::initSensor()
 {
     // Initialize the sensor with the default I2C address (0x29)
     if (sensor.InitSensor(0x29) != VL53L4CX_ERROR_NONE) {
@@ -25,7 +64,13 @@ bool TOF::begin()
 
     // Configure the sensor
     sensor.VL53L4CX_SetDistanceMode(VL53L4CX_DISTANCEMODE_LONG);
-    sensor.VL53L4CX_SetMeasurementTimingBudgetMicroSeconds(50000); // 50ms timing budget
+    sensor.VL53L4CX_SetMeasurementTimingBudgetMicroSeconds(TIMING_BUDGET_US); // 50ms timing budget
+
+    // GPIO1 is open drain and pulled low when a range is ready
+    if (interruptPin >= 0) {
+        pinMode(interruptPin, INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(interruptPin), onDataReady, this, FALLING);
+    }
     sensor.VL53L4CX_StartMeasurement(); // Start continuous measurement
 
     Serial.println("VL53L4CX sensor initialized successfully.");
@@ -33,45 +78,133 @@ bool TOF::begin()
 }
 
 /**
- * @brief Retrieves the measured distance from the TOF sensor.
- * 
- * This method waits for measurement data to be ready, fetches the multi-ranging data,
- * and clears the interrupt to prepare for the next measurement.
+ * @brief Fetches the range most recently published by the ranging task.
+ * @return True if a new range arrived since the previous call.
+ */
+bool TOF::update()
+{
+    return latestFrame.getIfNewer(frame, frameVersion);
+}
+
+/**
+ * @brief Gets the most recent range.
+ * @return Every target of the range, with its status, signal rate and sigma.
+ */
+const TofFrame &TOF::getFrame() const
+{
+    return frame;
+}
+
+/**
+ * @brief Gets the ranging counters.
+ */
+TofStats TOF::getStats() const
+{
+    return stats.get();
+}
+
+/**
+ * @brief Waits until the sensor has a range ready.
  * 
- * @return The distance to the first detected target in millimeters, or 0 if an error occurs.
+ * With an interrupt pin the task sleeps until GPIO1 falls. If no edge arrives
+ * within READY_TIMEOUT_MS the sensor is asked directly, which recovers from an
+ * edge that was missed while the previous range was being read.
+ *
+ * @return True if a range is ready.
  */
-uint16_t TOF::getDistance()
+bool TOF::waitForData()
 {
     uint8_t isDataReady = 0;
-    const TickType_t timeout = pdMS_TO_TICKS(100); // 100ms timeout
-    TickType_t startTime = xTaskGetTickCount();
-
-    // Wait until data is ready or timeout occurs
-    while (!isDataReady) {
+    if (interruptPin >= 0) {
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(READY_TIMEOUT_MS)) > 0) {
+            readyTime = edgeTime;
+            return true;
+        }
+        counters.timeouts++;
         sensor.VL53L4CX_GetMeasurementDataReady(&isDataReady);
+        readyTime = nowMicros();
+        return isDataReady != 0;
+    }
 
-        if (xTaskGetTickCount() - startTime > timeout) {
-            Serial.println("Timeout waiting for measurement data.");
-            return 0; // Timeout occurred
+    // No interrupt line: poll, sleeping in between so other tasks run
+    TickType_t startTime = xTaskGetTickCount();
+    while (!isDataReady) {
+        if (xTaskGetTickCount() - startTime > pdMS_TO_TICKS(READY_TIMEOUT_MS)) {
+            counters.timeouts++;
+            return false;
         }
-
-        vTaskDelay(pdMS_TO_TICKS(5)); // Yield to other tasks
+        vTaskDelay(pdMS_TO_TICKS(POLL_INTERVAL_MS));
+        sensor.VL53L4CX_GetMeasurementDataReady(&isDataReady);
     }
+    readyTime = nowMicros();
+    return true;
+}
 
+/**
+ * @brief Reads the ready range, restarts the measurement and publishes the range.
+ */
+void TOF::readRange()
+{
     // Fetch the multi-ranging data
     if (sensor.VL53L4CX_GetMultiRangingData(&multiRangingData) != VL53L4CX_ERROR_NONE) {
-        Serial.println("Failed to fetch ranging data.");
-        return 0;
+        counters.errors++;
+        sensor.VL53L4CX_ClearInterruptAndStartMeasurement();
+        return;
     }
 
     // Clear interrupt and prepare for the next measurement
     sensor.VL53L4CX_ClearInterruptAndStartMeasurement();
 
-    // Return the distance to the first target
-    if (multiRangingData.NumberOfObjectsFound > 0) {
-        return multiRangingData.RangeData[0].RangeMilliMeter; // First target distance
-    } else {
-        Serial.println("No target detected.");
-        return 0;
+    TofFrame range = {};
+    range.timestamp = readyTime;
+    range.count = multiRangingData.NumberOfObjectsFound < TOF_MAX_TARGETS ? multiRangingData.NumberOfObjectsFound
+                                                                          : TOF_MAX_TARGETS;
+    for (uint8_t i = 0; i < range.count; i++) {
+        const VL53L4CX_TargetRangeData_t &data = multiRangingData.RangeData[i];
+        range.targets[i].distance = data.RangeMilliMeter > 0 ? (uint16_t)data.RangeMilliMeter : 0;
+        range.targets[i].status = data.RangeStatus;
+        // Signal rate and sigma are 16.16 fixed point
+        range.targets[i].signalRate = data.SignalRateRtnMegaCps / 65536.0f;
+        range.targets[i].sigma = data.SigmaMilliMeter / 65536.0f;
+    }
+    latestFrame.put(range);
+    counters.ranges++;
+    if (listener) {
+        listener(range, listenerContext);
+    }
+}
+
+/**
+ * @brief Data-ready interrupt handler that stamps the range and wakes the ranging task.
+ * @param arg Pointer to the TOF instance.
+ */
+void IRAM_ATTR TOF::onDataReady(void *arg)
+{
+    TOF *tof = static_cast<TOF *>(arg);
+    // Same clock as nowMicros(), which is not in IRAM
+    tof->edgeTime = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(tof->task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief Ranging task entry point.
+ * @param parameter Pointer to the TOF instance.
+ */
+void TOF::rangingTask(void *parameter)
+{
+    TOF *tof = static_cast<TOF *>(parameter);
+    tof->sensorReady = tof->initSensor();
+    xTaskNotifyGive(tof->starter);
+    if (!tof->sensorReady) {
+        vTaskDelete(NULL);
+        return;
+    }
+    while (1) {
+        if (tof->waitForData()) {
+            tof->readRange();
+        }
+        tof->stats.put(tof->counters);
     }
 }
@@ -3,6 +3,17 @@
 
 #include <Arduino.h>
 #include <vl53l4cx_class.h> // Include STM32Duino VL53L4CX library
+#include "LatestValue.h"
+#include "HAL.h"
+
+/**
+ * @brief Ranging counters of the TOF task.
+ */
+typedef struct {
+    uint32_t ranges;     /**< Ranges read and published. */
+    uint32_t errors;     /**< Failed reads of the ranging data. */
+    uint32_t timeouts;   /**< Data-ready interrupts that did not arrive in time. */
+} TofStats;
 
 /**
  * @class TOF
@@ -10,39 +21,112 @@
  * 
  * The TOF class provides methods to initialize the sensor and measure distances.
  * It uses the STM32Duino VL53L4CX library for communication and configuration.
+ * Ranging runs in its own task, woken by the sensor's GPIO1 data-ready
+ * interrupt, which publishes each completed range with all of its targets
+ * through a lock-free slot, so reading a range never waits for the sensor.
  */
-class TOF
+class TOF : public TOFInterface
 {
 public:
+    typedef void (*FrameListener)(const TofFrame &frame, void *context); /**< Called by the ranging task with each new range. */
+
     /**
      * @brief Constructor for the TOF class.
      * 
      * Initializes the class instance but does not start the sensor.
+     *
+     * @param interruptPin GPIO connected to the sensor's GPIO1 output, or -1 to poll for data.
      */
-    TOF();
+    TOF(int interruptPin = -1);
 
     /**
-     * @brief Initializes the VL53L4CX sensor with default settings.
-     * 
-     * Configures the sensor to use long-distance mode and sets the measurement timing budget.
-     * 
-     * @return True if initialization is successful, false otherwise.
+     * @brief Sets a function the ranging task calls with every new range; call before begin().
+     * @param listener Function to call, or NULL for none.
+     * @param context Argument passed to @p listener.
      */
-    bool begin();
+    void setListener(FrameListener listener, void *context = NULL);
 
     /**
-     * @brief Retrieves the measured distance from the TOF sensor.
+     * @brief Starts the ranging task and waits for it to initialize the VL53L4CX sensor.
      * 
-     * This method waits for measurement data to be ready and fetches the distance
-     * to the closest detected target in millimeters.
-     * 
-     * @return The distance to the first detected target in millimeters, or 0 if an error occurs.
+     * The task configures the sensor to use long-distance mode, sets the measurement
+     * timing budget and then ranges continuously. The calling task is blocked for
+     * up to INIT_TIMEOUT_MS while the sensor is initialized.
+     *
+     * @param priority FreeRTOS priority of the ranging task.
+     * @param core Core the ranging task is pinned to.
+     * @param stackSize Stack size of the ranging task in bytes.
+     * @return True if the task was started and the sensor initialized, false otherwise.
+     */
+    bool begin(UBaseType_t priority, BaseType_t core, uint32_t stackSize = 4096);
+
+    /**
+     * @brief Fetches the range most recently published by the ranging task.
+     * @return True if a new range arrived since the previous call.
+     */
+    bool update() override;
+
+    /**
+     * @brief Gets the most recent range.
+     * @return Every target of the range, with its status, signal rate and sigma.
+     */
+    const TofFrame &getFrame() const override;
+
+    /**
+     * @brief Gets the ranging counters.
      */
-    uint16_t getDistance();
+    TofStats getStats() const;
 
 private:
+    static const uint32_t TIMING_BUDGET_US = 50000;   /**< Measurement timing budget. */
+    static const uint32_t READY_TIMEOUT_MS = 200;     /**< Wait for data-ready before checking the sensor. */
+    static const uint32_t POLL_INTERVAL_MS = 5;       /**< Data-ready poll interval without an interrupt pin. */
+    static const uint32_t INIT_TIMEOUT_MS = 2000;     /**< Wait in begin() for the sensor to initialize. */
+
     VL53L4CX sensor; /**< Instance of the VL53L4CX sensor. */
     VL53L4CX_MultiRangingData_t multiRangingData; /**< Structure to store ranging results. */
+    int interruptPin;                 /**< GPIO wired to GPIO1, or -1. */
+    TaskHandle_t task;                /**< Ranging task woken by the interrupt. */
+    TaskHandle_t starter;             /**< Task waiting in begin() for initSensor() to finish. */
+    volatile bool sensorReady;        /**< Result of initSensor(), set before starter is notified. */
+    volatile int64_t edgeTime;        /**< Time of the last data-ready edge, set by the interrupt. */
+    int64_t readyTime;                /**< Time the range being read became ready, from nowMicros(). */
+    FrameListener listener;           /**< Called with each new range, or NULL. */
+    void *listenerContext;            /**< Argument passed to the listener. */
+    TofStats counters;                /**< Counters owned by the ranging task. */
+    LatestValue<TofFrame> latestFrame; /**< Newest range, written by the ranging task. */
+    LatestValue<TofStats> stats;      /**< Counters, written by the ranging task. */
+    uint32_t frameVersion;            /**< Version of latestFrame last copied by update(). */
+    TofFrame frame;                   /**< Range returned by getFrame(). */
+
+    /**
+     * @brief Initializes the sensor and starts continuous ranging.
+     * @return True if initialization is successful, false otherwise.
+     */
+    bool initSensor();
+
+    /**
+     * @brief Waits until the sensor has a range ready.
+     * @return True if a range is ready.
+     */
+    bool waitForData();
+
+    /**
+     * @brief Reads the ready range, restarts the measurement and publishes the range.
+     */
+    void readRange();
+
+    /**
+     * @brief Data-ready interrupt handler that stamps the range and wakes the ranging task.
+     * @param arg Pointer to the TOF instance.
+     */
+    static void IRAM_ATTR onDataReady(void *arg);
+
+    /**
+     * @brief Ranging task entry point.
+     * @param parameter Pointer to the TOF instance.
+     */
+    static void rangingTask(void *parameter);
 };
 
 #endif
@@ -0,0 +1,66 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Placement of a FreeRTOS task.
+ */
+typedef struct {
+    const char *name;       /**< Task name, as shown in the task report. */
+    uint32_t stackSize;     /**< Stack size in bytes. */
+    UBaseType_t priority;   /**< FreeRTOS priority. */
+    BaseType_t core;        /**< Core the task is pinned to. */
+} TaskConfig;
+
+/*
+ * Task topology. The APP core runs only the control path: the motor control
+ * loop and the sensor reads that feed it, above the Arduino loop task (priority
+ * 1). Everything that waits on the network or on slow serial data runs on the
+ * PRO core, next to the WiFi and lwIP tasks the framework already pins there.
+ *
+ * Stack sizes are set from measurement: the TaskMonitor report prints, for
+ * every task below, the most stack it has used since boot and the size that
+ * fits it, that peak plus STACK_MARGIN_BYTES rounded up to 256 bytes. Run the
+ * robot through a full session (boot, WiFi and broker connect, balance, drive,
+ * avoid and a flight log flush), then set each size to the largest fit seen
+ * and record the measured peak in the comment next to it. A task below its
+ * margin is flagged in every report. No session has been measured yet, so the
+ * sizes below are still the ones in use when the topology was introduced.
+ */
+
+/** @brief Stack left unused above a task's measured peak, for paths the measurement run missed. */
+static const uint32_t STACK_MARGIN_BYTES = 512;
+
+/** @brief Timer-released wheel speed loop, the innermost loop. */
+static const TaskConfig WHEEL_TASK = {"WheelSpeedTask", 2048, configMAX_PRIORITIES - 1, APP_CPU_NUM};
+
+/** @brief Timer-released motor control loop. */
+static const TaskConfig CONTROL_TASK = {"MotorControlTask", 2048, configMAX_PRIORITIES - 2, APP_CPU_NUM};
+
+/** @brief IMU producer feeding the control loop through the sensor bus. */
+static const TaskConfig IMU_TASK = {"IMUTask", 4096, configMAX_PRIORITIES - 5, APP_CPU_NUM};
+
+/** @brief TOF ranging and obstacle model, woken by the sensor's data-ready interrupt. */
+static const TaskConfig TOF_TASK = {"TOFTask", 4096, 6, PRO_CPU_NUM};
+
+/** @brief GPS UART ingest and NMEA parsing. */
+static const TaskConfig GPS_TASK = {"GPSTask", 3072, 5, PRO_CPU_NUM};
+
+/** @brief WiFi/MQTT connection and telemetry publishing. */
+static const TaskConfig MQTT_TASK = {"MQTTTask", 4096, 3, PRO_CPU_NUM};
+
+/** @brief Flight recorder draining the sensor bus into log blocks. */
+static const TaskConfig RECORD_TASK = {"RecordTask", 3072, 2, PRO_CPU_NUM};
+
+/** @brief Flight log writes to flash, the slowest I/O, below everything else. */
+static const TaskConfig LOG_FLUSH_TASK = {"LogFlushTask", 4096, 1, PRO_CPU_NUM};
+
+/** @brief Periodic stack and loop timing report. */
+static const TaskConfig MONITOR_TASK = {"TaskMonitor", 3072, 1, PRO_CPU_NUM};
+
+/** @brief Every task above, for the stack column of the TaskMonitor report. */
+static const TaskConfig *const TASK_CONFIGS[] = {&WHEEL_TASK, &CONTROL_TASK, &IMU_TASK, &TOF_TASK, &GPS_TASK,
+                                                 &MQTT_TASK, &RECORD_TASK, &LOG_FLUSH_TASK, &MONITOR_TASK};
+
+#endif
@@ -0,0 +1,163 @@
+#include "TaskMonitor.h"
+
+/**
+ * @brief Constructor for the TaskMonitor class.
+ * @param out Stream the reports are printed to.
+ * @param periodMs Time between reports in milliseconds.
+ */
+TaskMonitor::TaskMonitor(Print &out, uint32_t periodMs)
+    : out(out), periodMs(periodMs), loopCount(0), latencyCount(0), fsm(NULL), recorder(NULL) {}
+
+/**
+ * @brief Adds the timing statistics of a control loop to the report.
+ * @param loop Control loop to report on.
+ */
+void TaskMonitor::watch(const ControlLoop &loop)
+{
+    if (loopCount < MAX_LOOPS) {
+        loops[loopCount++] = &loop;
+    }
+}
+
+/**
+ * @brief Adds latency statistics to the report.
+ * @param latency Latency monitor to report on.
+ * @param name Label of the statistics in the report.
+ */
+void TaskMonitor::watch(const LatencyMonitor &latency, const char *name)
+{
+    if (latencyCount < MAX_LATENCIES) {
+        latencies[latencyCount] = &latency;
+        latencyNames[latencyCount++] = name;
+    }
+}
+
+/**
+ * @brief Adds the time in each state of the motor control FSM and its transition count to the report.
+ * @param fsm Motor control FSM to report on; a later call replaces it.
+ */
+void TaskMonitor::watch(const ConeBotFsm &fsm)
+{
+    this->fsm = &fsm;
+}
+
+/**
+ * @brief Adds the flight recorder's counters and longest flash write to the report.
+ * @param recorder Flight recorder to report on; a later call replaces it.
+ */
+void TaskMonitor::watch(const FlightRecorder &recorder)
+{
+    this->recorder = &recorder;
+}
+
+/**
+ * @brief Creates the reporting task.
+ * @param config Placement of the reporting task.
+ * @return True if the task was started.
+ */
+bool TaskMonitor::begin(const TaskConfig &config)
+{
+    if (xTaskCreatePinnedToCore(monitorTask, config.name, config.stackSize, this, config.priority, NULL,
+                                config.core) != pdPASS) {
+        out.println("Failed to create task monitor.");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Prints one report.
+ */
+void TaskMonitor::report()
+{
+    UBaseType_t count = uxTaskGetSystemState(status, MAX_TASKS, NULL);
+    if (count == 0) {
+        out.println("Task report: more tasks than the monitor can track.");
+        return;
+    }
+
+    out.println("Task                Core Prio  Free stack   Used/size    Fit");
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t &task = status[i];
+        BaseType_t core = xTaskGetAffinity(task.xHandle);
+        out.printf("%-18s  %4s %4u  %10u", task.pcTaskName,
+                   core == tskNO_AFFINITY ? "any" : (core == PRO_CPU_NUM ? "PRO" : "APP"),
+                   (unsigned)task.uxCurrentPriority, (unsigned)task.usStackHighWaterMark);
+        // The high-water mark is the least free stack since the task started, in bytes on ESP32
+        const TaskConfig *config = findConfig(task.pcTaskName);
+        if (config) {
+            uint32_t used = config->stackSize - task.usStackHighWaterMark;
+            uint32_t fit = (used + STACK_MARGIN_BYTES + 255) & ~255u;
+            out.printf("  %5u/%-5u %5u%s\n", (unsigned)used, (unsigned)config->stackSize, (unsigned)fit,
+                       task.usStackHighWaterMark < STACK_MARGIN_BYTES ? "!" : "");
+        } else {
+            out.println();
+        }
+    }
+
+    for (uint8_t i = 0; i < loopCount; i++) {
+        // The loop's share of its core is its mean execution time over its period
+        LoopStats stats = loops[i]->getStats();
+        out.printf("%s: %u cycles, %u overruns, %u missed, jitter %d..%d us (mean %u), "
+                   "execution max %u us (mean %u), load %.1f%%\n",
+                   loops[i]->getName(), (unsigned)stats.cycles, (unsigned)stats.overruns, (unsigned)stats.missedCycles,
+                   (int)stats.minJitter, (int)stats.maxJitter, (unsigned)stats.meanAbsJitter,
+                   (unsigned)stats.maxExecution, (unsigned)stats.meanExecution,
+                   100.0f * stats.meanExecution / loops[i]->getPeriodMicros());
+    }
+    for (uint8_t i = 0; i < latencyCount; i++) {
+        LatencyStats stats = latencies[i]->getStats();
+        out.printf("%s: %u samples, latency %u..%u us (mean %u)\n", latencyNames[i], (unsigned)stats.samples,
+                   (unsigned)stats.minLatency, (unsigned)stats.maxLatency, (unsigned)stats.meanLatency);
+    }
+    if (fsm) {
+        // Totals since boot, so the share of time spent moving shows how much avoidance and balancing cost
+        FsmStats stats = fsm->getStats();
+        uint32_t transitions = 0;
+        out.print("FSM:");
+        for (uint8_t from = 0; from < CONEBOT_STATE_COUNT; from++) {
+            out.printf(" %s %.1f s", getStateName(from), stats.dwellMicros[from] * 1e-6);
+            for (uint8_t to = 0; to < CONEBOT_STATE_COUNT; to++) {
+                transitions += stats.transitions[from][to];
+            }
+        }
+        out.printf(", %u transitions, %u commands rejected\n", (unsigned)transitions,
+                   (unsigned)stats.rejectedRequests);
+    }
+    if (recorder) {
+        FlightRecorderStats stats = recorder->getStats();
+        out.printf("Flight log: %u blocks, %u dropped, %u samples lost, write max %u us, "
+                   "%u longer than a control period\n",
+                   (unsigned)stats.blocks, (unsigned)stats.droppedBlocks, (unsigned)stats.lostSamples,
+                   (unsigned)stats.maxWriteMicros, (unsigned)stats.slowWrites);
+    }
+}
+
+/**
+ * @brief Finds the configuration a task was created from.
+ * @param name Task name.
+ * @return The entry of TASK_CONFIGS with that name, or NULL for framework tasks.
+ */
+const TaskConfig *TaskMonitor::findConfig(const char *name)
+{
+    for (size_t i = 0; i < sizeof(TASK_CONFIGS) / sizeof(TASK_CONFIGS[0]); i++) {
+        if (strcmp(TASK_CONFIGS[i]->name, name) == 0) {
+            return TASK_CONFIGS[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Task entry point that prints a report every period.
+ * @param parameter Pointer to the TaskMonitor instance.
+ */
+void TaskMonitor::monitorTask(void *parameter)
+{
+    TaskMonitor *monitor = static_cast<TaskMonitor *>(parameter);
+    TickType_t lastWake = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(monitor->periodMs));
+        monitor->report();
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+#include "TaskConfig.h"
+#include "ControlLoop.h"
+#include "LatencyMonitor.h"
+#include "ConeBot.h"
+#include "FlightRecorder.h"
+
+/**
+ * @class TaskMonitor
+ * @brief Periodically reports per-task stack high-water marks and control loop timing.
+ *
+ * Each report lists every FreeRTOS task with its core, priority and unused
+ * stack. For the tasks in TASK_CONFIGS it also prints the peak stack use
+ * against the configured size and the size that fits the peak with
+ * STACK_MARGIN_BYTES to spare, and marks tasks that have eaten into that
+ * margin with "!". Each control loop's line gives its CPU load, its mean
+ * execution time over its period, next to its jitter and overrun counters,
+ * which shows whether the APP core has time to spare and whether anything on
+ * it delays or preempts the loops.
+ *
+ * Per-task CPU shares would need configGENERATE_RUN_TIME_STATS, which the
+ * stock Arduino core leaves off, so they are not reported. The task list
+ * itself needs configUSE_TRACE_FACILITY, which the Arduino core enables.
+ */
+class TaskMonitor
+{
+public:
+    /**
+     * @brief Constructor for the TaskMonitor class.
+     * @param out Stream the reports are printed to.
+     * @param periodMs Time between reports in milliseconds.
+     */
+    TaskMonitor(Print &out, uint32_t periodMs = 5000);
+
+    /**
+     * @brief Adds the timing statistics of a control loop to the report.
+     *
+     * Up to MAX_LOOPS loops can be watched; further ones are ignored.
+     *
+     * @param loop Control loop to report on.
+     */
+    void watch(const ControlLoop &loop);
+
+    /**
+     * @brief Adds latency statistics to the report.
+     *
+     * Up to MAX_LATENCIES monitors can be watched; further ones are ignored.
+     *
+     * @param latency Latency monitor to report on.
+     * @param name Label of the statistics in the report.
+     */
+    void watch(const LatencyMonitor &latency, const char *name);
+
+    /**
+     * @brief Adds the time in each state of the motor control FSM and its transition count to the report.
+     * @param fsm Motor control FSM to report on; a later call replaces it.
+     */
+    void watch(const ConeBotFsm &fsm);
+
+    /**
+     * @brief Adds the flight recorder's counters and longest flash write to the report.
+     *
+     * Flash writes stall both cores, so a long write next to a control loop's
+     * late wake-ups shows the log is what delayed it.
+     *
+     * @param recorder Flight recorder to report on; a later call replaces it.
+     */
+    void watch(const FlightRecorder &recorder);
+
+    /**
+     * @brief Creates the reporting task.
+     * @param config Placement of the reporting task.
+     * @return True if the task was started.
+     */
+    bool begin(const TaskConfig &config);
+
+    /**
+     * @brief Prints one report.
+     */
+    void report();
+
+private:
+    static const UBaseType_t MAX_TASKS = 32; /**< Tasks tracked per report. */
+    static const uint8_t MAX_LOOPS = 4;      /**< Control loops reported on. */
+    static const uint8_t MAX_LATENCIES = 2;  /**< Latency monitors reported on. */
+
+    Print &out;                              /**< Stream the reports are printed to. */
+    uint32_t periodMs;                       /**< Time between reports in milliseconds. */
+    const ControlLoop *loops[MAX_LOOPS];     /**< Control loops to report on. */
+    uint8_t loopCount;                       /**< Number of entries in loops. */
+    const LatencyMonitor *latencies[MAX_LATENCIES]; /**< Latency monitors to report on. */
+    const char *latencyNames[MAX_LATENCIES]; /**< Labels of the entries in latencies. */
+    uint8_t latencyCount;                    /**< Number of entries in latencies. */
+    const ConeBotFsm *fsm;                   /**< Motor control FSM to report on, or NULL. */
+    const FlightRecorder *recorder;          /**< Flight recorder to report on, or NULL. */
+    TaskStatus_t status[MAX_TASKS];          /**< Task states from the latest report. */
+
+    /**
+     * @brief Finds the configuration a task was created from.
+     * @param name Task name.
+     * @return The entry of TASK_CONFIGS with that name, or NULL for framework tasks.
+     */
+    static const TaskConfig *findConfig(const char *name);
+
+    /**
+     * @brief Task entry point that prints a report every period.
+     * @param parameter Pointer to the TaskMonitor instance.
+     */
+    static void monitorTask(void *parameter);
+};
+
+#endif
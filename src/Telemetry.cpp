@@ -0,0 +1,289 @@
+/** @file Telemetry.cpp
+ *  @brief Implementation of the binary telemetry encoder and decoder.
+ */
+
+#include "Telemetry.h"
+
+#include <math.h>
+
+#include "Crc16.h"
+#include "Varint.h"
+
+static const uint8_t FLAG_OBSTACLE = 0x01;
+static const uint8_t FLAG_GPS_VALID = 0x02;
+
+static void putU16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void putU32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static uint16_t getU16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int16_t scale16(float value, float scale) {
+    float scaled = roundf(value * scale);
+    if (!(scaled > -32768.0f)) {
+        return scaled != scaled ? 0 : -32768;
+    }
+    return scaled < 32767.0f ? (int16_t)scaled : 32767;
+}
+
+static int32_t scale32(float value, float scale) {
+    float scaled = roundf(value * scale);
+    if (!(scaled > -2147483648.0f)) {
+        return scaled != scaled ? 0 : INT32_MIN;
+    }
+    return scaled < 2147483520.0f ? (int32_t)scaled : INT32_MAX;
+}
+
+static void putHeader(uint8_t *frame, TelemetryType type, size_t payloadLength) {
+    frame[0] = TELEMETRY_MAGIC;
+    frame[1] = TELEMETRY_VERSION;
+    frame[2] = (uint8_t)type;
+    putU16(frame + 3, (uint16_t)payloadLength);
+}
+
+static size_t putTrailer(uint8_t *frame, size_t payloadLength) {
+    size_t crcOffset = TELEMETRY_HEADER_SIZE + payloadLength;
+    putU16(frame + crcOffset, crc16(frame, crcOffset));
+    return crcOffset + TELEMETRY_TRAILER_SIZE;
+}
+
+// Returns the payload length of an intact frame of the given type, or -1
+static long checkFrame(const uint8_t *frame, size_t length, TelemetryType type) {
+    if (length < TELEMETRY_HEADER_SIZE + TELEMETRY_TRAILER_SIZE || frame[0] != TELEMETRY_MAGIC ||
+        frame[1] != TELEMETRY_VERSION || frame[2] != (uint8_t)type) {
+        return -1;
+    }
+    size_t payloadLength = getU16(frame + 3);
+    size_t crcOffset = TELEMETRY_HEADER_SIZE + payloadLength;
+    if (length < crcOffset + TELEMETRY_TRAILER_SIZE || getU16(frame + crcOffset) != crc16(frame, crcOffset)) {
+        return -1;
+    }
+    return (long)payloadLength;
+}
+
+size_t encodeTelemetry(const BotState &state, uint8_t *buffer, size_t capacity) {
+    if (capacity < TELEMETRY_STATE_FRAME_SIZE) {
+        return 0;
+    }
+    putHeader(buffer, TELEMETRY_STATE, TELEMETRY_STATE_PAYLOAD_SIZE);
+
+    uint8_t *p = buffer + TELEMETRY_HEADER_SIZE;
+    putU32(p + 0, (uint32_t)(state.timestamp / 1000));
+    p[4] = state.state;
+    p[5] = (state.obstacleDetected ? FLAG_OBSTACLE : 0) | (state.gpsValid ? FLAG_GPS_VALID : 0);
+    putU16(p + 6, (uint16_t)scale16(state.tilt_angle, 100.0f));
+    putU16(p + 8, (uint16_t)scale16(state.pitchRate, 10.0f));
+    putU32(p + 10, (uint32_t)scale32(state.position, 1000.0f));
+    putU16(p + 14, (uint16_t)scale16(state.velocity, 1000.0f));
+    putU32(p + 16, (uint32_t)scale32(state.x, 1000.0f));
+    putU32(p + 20, (uint32_t)scale32(state.y, 1000.0f));
+    putU16(p + 24, (uint16_t)scale16(state.heading, 10000.0f));
+    putU16(p + 26, (uint16_t)scale16(state.yawRate, 1000.0f));
+    putU16(p + 28, (uint16_t)scale16(state.leftVelocity, 1000.0f));
+    putU16(p + 30, (uint16_t)scale16(state.rightVelocity, 1000.0f));
+    putU16(p + 32, (uint16_t)scale16(state.leftSetpoint, 1000.0f));
+    putU16(p + 34, (uint16_t)scale16(state.rightSetpoint, 1000.0f));
+    putU16(p + 36, state.obstacleDistance);
+    putU32(p + 38, (uint32_t)state.latitude);
+    putU32(p + 42, (uint32_t)state.longitude);
+    return putTrailer(buffer, TELEMETRY_STATE_PAYLOAD_SIZE);
+}
+
+bool decodeTelemetry(const uint8_t *frame, size_t length, BotState &state) {
+    long payloadLength = checkFrame(frame, length, TELEMETRY_STATE);
+    if (payloadLength < (long)TELEMETRY_STATE_PAYLOAD_SIZE) {
+        return false;
+    }
+
+    const uint8_t *p = frame + TELEMETRY_HEADER_SIZE;
+    state.timestamp = (int64_t)getU32(p + 0) * 1000;
+    state.state = p[4];
+    state.obstacleDetected = (p[5] & FLAG_OBSTACLE) != 0;
+    state.gpsValid = (p[5] & FLAG_GPS_VALID) != 0;
+    state.tilt_angle = (int16_t)getU16(p + 6) * 0.01f;
+    state.pitchRate = (int16_t)getU16(p + 8) * 0.1f;
+    state.position = (int32_t)getU32(p + 10) * 0.001f;
+    state.velocity = (int16_t)getU16(p + 14) * 0.001f;
+    state.x = (int32_t)getU32(p + 16) * 0.001f;
+    state.y = (int32_t)getU32(p + 20) * 0.001f;
+    state.heading = (int16_t)getU16(p + 24) * 0.0001f;
+    state.yawRate = (int16_t)getU16(p + 26) * 0.001f;
+    state.leftVelocity = (int16_t)getU16(p + 28) * 0.001f;
+    state.rightVelocity = (int16_t)getU16(p + 30) * 0.001f;
+    state.leftSetpoint = (int16_t)getU16(p + 32) * 0.001f;
+    state.rightSetpoint = (int16_t)getU16(p + 34) * 0.001f;
+    state.obstacleDistance = getU16(p + 36);
+    state.latitude = (int32_t)getU32(p + 38);
+    state.longitude = (int32_t)getU32(p + 42);
+    return true;
+}
+
+// Fields of a control sample in batch order, with their raw widths in bytes
+static const uint8_t BATCH_FIELDS = 8;
+static const uint8_t BATCH_FIELD_SIZES[BATCH_FIELDS] = {4, 1, 2, 2, 4, 2, 2, 2};
+
+static void scaleControlSample(const ControlSample &sample, int32_t interval, int32_t fields[BATCH_FIELDS]) {
+    fields[0] = interval;
+    fields[1] = sample.state;
+    fields[2] = scale16(sample.pitch, 100.0f);
+    fields[3] = scale16(sample.pitchRate, 10.0f);
+    fields[4] = scale32(sample.position, 1000.0f);
+    fields[5] = scale16(sample.velocity, 1000.0f);
+    fields[6] = scale16(sample.leftSetpoint, 1000.0f);
+    fields[7] = scale16(sample.rightSetpoint, 1000.0f);
+}
+
+TelemetryBatchParams TelemetryBatchParams::defaults() {
+    TelemetryBatchParams p;
+    p.maxSamples = 50;
+    p.maxAgeMicros = 100000;
+    p.deltaEncoding = true;
+    return p;
+}
+
+TelemetryBatcher::TelemetryBatcher(const TelemetryBatchParams &params) : params(params) {
+    clear();
+}
+
+void TelemetryBatcher::clear() {
+    length = TELEMETRY_HEADER_SIZE + TELEMETRY_BATCH_HEADER_SIZE;
+    count = 0;
+    firstTimestamp = 0;
+    lastTimestamp = 0;
+    for (uint8_t i = 0; i < BATCH_FIELDS; i++) {
+        previous[i] = 0;
+    }
+}
+
+void TelemetryBatcher::add(const ControlSample &sample) {
+    if (count == 0) {
+        firstTimestamp = sample.timestamp;
+        lastTimestamp = sample.timestamp;
+    }
+    int64_t interval = sample.timestamp - lastTimestamp;
+    interval = interval < 0 ? 0 : (interval > INT32_MAX ? INT32_MAX : interval);
+    lastTimestamp = sample.timestamp;
+
+    int32_t fields[BATCH_FIELDS];
+    scaleControlSample(sample, (int32_t)interval, fields);
+    uint8_t *p = frame + length;
+    for (uint8_t i = 0; i < BATCH_FIELDS; i++) {
+        if (params.deltaEncoding) {
+            p += putVarint(p, (int64_t)fields[i] - previous[i]);
+        } else if (BATCH_FIELD_SIZES[i] == 4) {
+            putU32(p, (uint32_t)fields[i]);
+            p += 4;
+        } else if (BATCH_FIELD_SIZES[i] == 2) {
+            putU16(p, (uint16_t)fields[i]);
+            p += 2;
+        } else {
+            *p++ = (uint8_t)fields[i];
+        }
+        previous[i] = fields[i];
+    }
+    length = p - frame;
+    count++;
+}
+
+bool TelemetryBatcher::isFull() const {
+    return count >= params.maxSamples ||
+           length + TELEMETRY_BATCH_MAX_SAMPLE_SIZE + TELEMETRY_TRAILER_SIZE > TELEMETRY_BATCH_FRAME_CAPACITY;
+}
+
+bool TelemetryBatcher::isDue(int64_t now) const {
+    return count > 0 && (isFull() || now - firstTimestamp >= (int64_t)params.maxAgeMicros);
+}
+
+size_t TelemetryBatcher::finish(uint32_t dropped) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t payloadLength = length - TELEMETRY_HEADER_SIZE;
+    putHeader(frame, TELEMETRY_CONTROL_BATCH, payloadLength);
+    uint8_t *p = frame + TELEMETRY_HEADER_SIZE;
+    p[0] = params.deltaEncoding ? TELEMETRY_BATCH_DELTA : TELEMETRY_BATCH_RAW;
+    putU16(p + 1, count);
+    putU32(p + 3, dropped);
+    putU32(p + 7, (uint32_t)firstTimestamp);
+    putU32(p + 11, (uint32_t)((uint64_t)firstTimestamp >> 32));
+    return putTrailer(frame, payloadLength);
+}
+
+const uint8_t *TelemetryBatcher::getFrame() const {
+    return frame;
+}
+
+uint16_t TelemetryBatcher::getCount() const {
+    return count;
+}
+
+bool decodeTelemetryBatch(const uint8_t *frame, size_t length, ControlSample *samples, size_t capacity,
+                          size_t &count, uint32_t &dropped) {
+    long payloadLength = checkFrame(frame, length, TELEMETRY_CONTROL_BATCH);
+    if (payloadLength < (long)TELEMETRY_BATCH_HEADER_SIZE) {
+        return false;
+    }
+    const uint8_t *p = frame + TELEMETRY_HEADER_SIZE;
+    const uint8_t *end = p + payloadLength;
+    uint8_t encoding = p[0];
+    size_t total = getU16(p + 1);
+    if ((encoding != TELEMETRY_BATCH_RAW && encoding != TELEMETRY_BATCH_DELTA) || total > capacity) {
+        return false;
+    }
+    dropped = getU32(p + 3);
+    int64_t timestamp = (int64_t)((uint64_t)getU32(p + 7) | ((uint64_t)getU32(p + 11) << 32));
+    p += TELEMETRY_BATCH_HEADER_SIZE;
+
+    int64_t fields[BATCH_FIELDS] = {0};
+    for (size_t n = 0; n < total; n++) {
+        for (uint8_t i = 0; i < BATCH_FIELDS; i++) {
+            if (encoding == TELEMETRY_BATCH_DELTA) {
+                int64_t change;
+                size_t used = getVarint(p, end, change);
+                if (used == 0) {
+                    return false;
+                }
+                fields[i] += change;
+                p += used;
+            } else {
+                if (p + BATCH_FIELD_SIZES[i] > end) {
+                    return false;
+                }
+                if (BATCH_FIELD_SIZES[i] == 4) {
+                    fields[i] = i == 0 ? (int64_t)getU32(p) : (int64_t)(int32_t)getU32(p);
+                } else if (BATCH_FIELD_SIZES[i] == 2) {
+                    fields[i] = (int16_t)getU16(p);
+                } else {
+                    fields[i] = *p;
+                }
+                p += BATCH_FIELD_SIZES[i];
+            }
+        }
+        timestamp += fields[0];
+        ControlSample &sample = samples[n];
+        sample.timestamp = timestamp;
+        sample.state = (uint8_t)fields[1];
+        sample.pitch = fields[2] * 0.01f;
+        sample.pitchRate = fields[3] * 0.1f;
+        sample.position = fields[4] * 0.001f;
+        sample.velocity = fields[5] * 0.001f;
+        sample.leftSetpoint = fields[6] * 0.001f;
+        sample.rightSetpoint = fields[7] * 0.001f;
+    }
+    count = total;
+    return true;
+}
@@ -0,0 +1,263 @@
+/** @file Telemetry.h
+ *  @brief Binary telemetry frames: the robot state and control trace schemas, their encoders and decoders.
+ *
+ *  This header and Telemetry.cpp depend only on the C library and Crc16.h,
+ *  so ground tools can build the same decoder the robot encodes with.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  @brief Snapshot of the robot's sensor and controller state, as published.
+ */
+typedef struct {
+    int64_t timestamp;      /**< Time of the IMU sample the tilt angle came from, from nowMicros(). */
+    uint8_t state;          /**< ConeBotState of the motor control FSM. */
+    float tilt_angle;       /**< Pitch in degrees, leaning forward positive. */
+    float pitchRate;        /**< Pitch rate in degrees per second. */
+    float position;         /**< Odometry travel in m, the mean of both wheels. */
+    float velocity;         /**< Odometry forward speed in m/s. */
+    float x;                /**< Odometry position along the initial heading in m. */
+    float y;                /**< Odometry position to the left of the initial heading in m. */
+    float heading;          /**< Odometry heading in rad, counterclockwise from the initial heading. */
+    float yawRate;          /**< Odometry turn rate in rad/s. */
+    float leftVelocity;     /**< Left wheel speed in m/s. */
+    float rightVelocity;    /**< Right wheel speed in m/s. */
+    float leftSetpoint;     /**< Left wheel speed commanded by the control loop in m/s. */
+    float rightSetpoint;    /**< Right wheel speed commanded by the control loop in m/s. */
+    bool obstacleDetected;  /**< Obstacle flag of the obstacle model. */
+    uint16_t obstacleDistance; /**< Filtered distance to the nearest obstacle in mm, or 0 if none. */
+    bool gpsValid;          /**< The latest GPS fix is usable. */
+    int32_t latitude;       /**< Latitude from GPS in 1e-7 degrees. */
+    int32_t longitude;      /**< Longitude from GPS in 1e-7 degrees. */
+} BotState;
+
+/**
+ *  @brief Output of one motor control cycle and the measurement it acted on.
+ */
+typedef struct {
+    int64_t timestamp;       /**< Time of the cycle, from nowMicros(). */
+    uint8_t state;           /**< ConeBotState after the cycle. */
+    float pitch;             /**< Measured pitch in degrees, leaning forward positive. */
+    float pitchRate;         /**< Measured pitch rate in degrees per second. */
+    float position;          /**< Measured wheel travel in m, the mean of both wheels. */
+    float velocity;          /**< Measured wheel speed in m/s, the mean of both wheels. */
+    float leftSetpoint;      /**< Commanded left wheel speed in m/s. */
+    float rightSetpoint;     /**< Commanded right wheel speed in m/s. */
+    int64_t imuTimestamp;       /**< Timestamp of the IMU sample the cycle used, or 0 if none. */
+    int64_t encoderTimestamp;   /**< Timestamp of the encoder sample the cycle used, or 0 if none. */
+    int64_t obstacleTimestamp;  /**< Timestamp of the obstacle sample the cycle used, or 0 if none. */
+    int64_t gpsTimestamp;       /**< Timestamp of the GPS sample the cycle used, or 0 if none. */
+} ControlSample;
+
+/** @brief First byte of every telemetry frame. */
+static const uint8_t TELEMETRY_MAGIC = 0xCB;
+
+/**
+ *  @brief Telemetry format version.
+ *
+ *  Fields are only ever appended to a payload, and decoders skip bytes they
+ *  do not know, so appending needs no new version. Any other change does.
+ */
+static const uint8_t TELEMETRY_VERSION = 2;
+
+/**
+ *  @brief Payload types of telemetry frames.
+ */
+enum TelemetryType {
+    TELEMETRY_STATE = 1,        /**< One BotState. */
+    TELEMETRY_CONTROL_BATCH = 2 /**< Consecutive ControlSamples, see TelemetryBatcher. */
+};
+
+/** @brief Bytes before the payload: magic, version, type and payload length (u16). */
+static const size_t TELEMETRY_HEADER_SIZE = 5;
+
+/** @brief Bytes after the payload: CRC-16/CCITT-FALSE of header and payload, little-endian. */
+static const size_t TELEMETRY_TRAILER_SIZE = 2;
+
+/** @brief Payload bytes of a TELEMETRY_STATE frame. */
+static const size_t TELEMETRY_STATE_PAYLOAD_SIZE = 46;
+
+/** @brief Total bytes of a TELEMETRY_STATE frame. */
+static const size_t TELEMETRY_STATE_FRAME_SIZE =
+    TELEMETRY_HEADER_SIZE + TELEMETRY_STATE_PAYLOAD_SIZE + TELEMETRY_TRAILER_SIZE;
+
+/**
+ *  @brief Encodes a robot state into a TELEMETRY_STATE frame.
+ *
+ *  All fields are little-endian. Physical values are sent as scaled
+ *  integers and saturate at the ends of their range:
+ *
+ *  | Offset | Type | Field                | Unit        |
+ *  |--------|------|----------------------|-------------|
+ *  | 0      | u32  | timestamp            | ms          |
+ *  | 4      | u8   | state                |             |
+ *  | 5      | u8   | flags: bit 0 obstacleDetected, bit 1 gpsValid | |
+ *  | 6      | i16  | tilt_angle           | 0.01 deg    |
+ *  | 8      | i16  | pitchRate            | 0.1 deg/s   |
+ *  | 10     | i32  | position             | mm          |
+ *  | 14     | i16  | velocity             | mm/s        |
+ *  | 16     | i32  | x                    | mm          |
+ *  | 20     | i32  | y                    | mm          |
+ *  | 24     | i16  | heading              | 1e-4 rad    |
+ *  | 26     | i16  | yawRate              | mrad/s      |
+ *  | 28     | i16  | leftVelocity         | mm/s        |
+ *  | 30     | i16  | rightVelocity        | mm/s        |
+ *  | 32     | i16  | leftSetpoint         | mm/s        |
+ *  | 34     | i16  | rightSetpoint        | mm/s        |
+ *  | 36     | u16  | obstacleDistance     | mm          |
+ *  | 38     | i32  | latitude             | 1e-7 deg    |
+ *  | 42     | i32  | longitude            | 1e-7 deg    |
+ *
+ *  Offsets are from the start of the payload. Nothing is allocated.
+ *
+ *  @param state State to encode.
+ *  @param buffer Buffer receiving the frame.
+ *  @param capacity Size of @p buffer in bytes.
+ *  @return Frame length in bytes, or 0 if @p buffer is too small.
+ */
+size_t encodeTelemetry(const BotState &state, uint8_t *buffer, size_t capacity);
+
+/**
+ *  @brief Decodes a TELEMETRY_STATE frame.
+ *  @param frame Frame bytes.
+ *  @param length Number of bytes in @p frame.
+ *  @param state Receives the decoded state, at the resolution it was sent with.
+ *  @return True if the frame is a complete, intact TELEMETRY_STATE frame of this version.
+ */
+bool decodeTelemetry(const uint8_t *frame, size_t length, BotState &state);
+
+/** @brief Largest TELEMETRY_CONTROL_BATCH frame in bytes, header and CRC included. */
+static const size_t TELEMETRY_BATCH_FRAME_CAPACITY = 1024;
+
+/** @brief Bytes of a TELEMETRY_CONTROL_BATCH payload before the first sample. */
+static const size_t TELEMETRY_BATCH_HEADER_SIZE = 15;
+
+/** @brief Largest encoding of one sample in a TELEMETRY_CONTROL_BATCH payload, in either encoding. */
+static const size_t TELEMETRY_BATCH_MAX_SAMPLE_SIZE = 27;
+
+/**
+ *  @brief Encodings of the samples in a TELEMETRY_CONTROL_BATCH payload.
+ */
+enum TelemetryBatchEncoding {
+    TELEMETRY_BATCH_RAW = 0,    /**< Fixed 19-byte samples. */
+    TELEMETRY_BATCH_DELTA = 1   /**< Each field as a varint of its change since the previous sample. */
+};
+
+/**
+ *  @brief When a TelemetryBatcher closes a batch, and how it encodes it.
+ */
+struct TelemetryBatchParams {
+    uint16_t maxSamples;        /**< Batch is sent once it holds this many samples. */
+    uint32_t maxAgeMicros;      /**< Batch is sent once its first sample is this old, in microseconds. */
+    bool deltaEncoding;         /**< Use TELEMETRY_BATCH_DELTA rather than TELEMETRY_BATCH_RAW. */
+
+    /**
+     *  @brief Gets parameters for one batch per 100 ms of the motor control loop.
+     */
+    static TelemetryBatchParams defaults();
+};
+
+/**
+ *  @class TelemetryBatcher
+ *  @brief Packs consecutive control samples into TELEMETRY_CONTROL_BATCH frames.
+ *
+ *  Each sample is encoded into the frame as it is added, so the frame is the
+ *  only buffer and nothing is allocated. A batch is ready once it holds
+ *  maxSamples samples, its first sample is maxAgeMicros old, or the frame
+ *  has no room for another sample. The payload is:
+ *
+ *  | Offset | Type | Field                                     |
+ *  |--------|------|-------------------------------------------|
+ *  | 0      | u8   | TelemetryBatchEncoding                    |
+ *  | 1      | u16  | sample count                              |
+ *  | 3      | u32  | samples the sender dropped since it began |
+ *  | 7      | i64  | timestamp of the first sample in us       |
+ *  | 15     |      | samples                                   |
+ *
+ *  A sample holds, in order, its timestamp as the change in us since the
+ *  previous sample (since the first sample for the first), state, pitch in
+ *  0.01 deg, pitchRate in 0.1 deg/s, position in mm, velocity in mm/s and
+ *  both setpoints in mm/s. TELEMETRY_BATCH_RAW stores these as u32, u8,
+ *  i16, i16, i32, i16, i16 and i16. TELEMETRY_BATCH_DELTA stores each as a
+ *  zigzag LEB128 varint of its change from the previous sample, the first
+ *  sample changing from zero; a steady loop then takes about 10 bytes a
+ *  sample instead of 19.
+ */
+class TelemetryBatcher {
+public:
+    /**
+     *  @brief Constructor for the TelemetryBatcher class; the batch starts empty.
+     *  @param params When to close a batch, and how to encode it.
+     */
+    TelemetryBatcher(const TelemetryBatchParams &params = TelemetryBatchParams::defaults());
+
+    /**
+     *  @brief Discards the batch.
+     */
+    void clear();
+
+    /**
+     *  @brief Appends a sample; call only while the batch is not full.
+     *  @param sample Control cycle to add, not older than the previous one.
+     */
+    void add(const ControlSample &sample);
+
+    /**
+     *  @brief Checks if the batch has reached maxSamples or has no room for another sample.
+     */
+    bool isFull() const;
+
+    /**
+     *  @brief Checks if the batch should be sent.
+     *  @param now Current time from nowMicros().
+     *  @return True if the batch is full, or holds a sample at least maxAgeMicros old.
+     */
+    bool isDue(int64_t now) const;
+
+    /**
+     *  @brief Completes the frame header and CRC.
+     *  @param dropped Samples the sender dropped since it began.
+     *  @return Frame length in bytes, or 0 if the batch is empty.
+     */
+    size_t finish(uint32_t dropped);
+
+    /**
+     *  @brief Gets the frame, complete after finish().
+     */
+    const uint8_t *getFrame() const;
+
+    /**
+     *  @brief Gets the number of samples in the batch.
+     */
+    uint16_t getCount() const;
+
+private:
+    TelemetryBatchParams params;
+    uint8_t frame[TELEMETRY_BATCH_FRAME_CAPACITY];
+    size_t length;              /**< Bytes of frame written. */
+    uint16_t count;             /**< Samples in the batch. */
+    int64_t firstTimestamp;     /**< Timestamp of the first sample. */
+    int64_t lastTimestamp;      /**< Timestamp of the latest sample. */
+    int32_t previous[8];        /**< Scaled fields of the latest sample, interval first. */
+};
+
+/**
+ *  @brief Decodes a TELEMETRY_CONTROL_BATCH frame.
+ *  @param frame Frame bytes.
+ *  @param length Number of bytes in @p frame.
+ *  @param samples Receives the decoded samples, at the resolution they were sent with.
+ *  @param capacity Number of entries in @p samples.
+ *  @param count Receives the number of samples decoded.
+ *  @param dropped Receives the samples the sender dropped since it began.
+ *  @return True if the frame is a complete, intact TELEMETRY_CONTROL_BATCH frame of this
+ *          version and all of its samples fit in @p samples.
+ */
+bool decodeTelemetryBatch(const uint8_t *frame, size_t length, ControlSample *samples, size_t capacity,
+                          size_t &count, uint32_t &dropped);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Writes a signed integer as a zigzag LEB128 varint.
+ *
+ * Values near zero, of either sign, take the fewest bytes: one byte up to
+ * plus or minus 63, and at most 10 bytes.
+ *
+ * @param p Buffer with room for 10 bytes.
+ * @param value Value to write.
+ * @return Number of bytes written.
+ */
+inline size_t putVarint(uint8_t *p, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t n = 0;
+    while (zigzag >= 0x80) {
+        p[n++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    p[n++] = (uint8_t)zigzag;
+    return n;
+}
+
+/**
+ * @brief Reads a zigzag LEB128 varint written by putVarint().
+ * @param p First byte of the varint.
+ * @param end End of the readable bytes.
+ * @param value Receives the value.
+ * @return Number of bytes read, or 0 if the varint runs past @p end or is too long.
+ */
+inline size_t getVarint(const uint8_t *p, const uint8_t *end, int64_t &value)
+{
+    uint64_t zigzag = 0;
+    for (size_t n = 0; n < 10 && p + n < end; n++) {
+        zigzag |= (uint64_t)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/** @file WheelSpeedController.cpp
+ *  @brief Implementation of the wheel speed loop.
+ */
+
+#include "WheelSpeedController.h"
+
+#include "ConeBot.h"
+
+WheelSpeedParams WheelSpeedParams::defaults() {
+    WheelSpeedParams p;
+    p.gains.kp = 1.0f;
+    p.gains.ki = 10.0f;
+    p.gains.kd = 0.0f;
+    p.gains.outputLimit = 8.0f;
+    p.derivativeFilter = 0.0f;
+    p.backEmf = 7.5f;
+    p.minBatteryVoltage = 5.0f;
+    p.dt = WHEEL_PERIOD_US * 1e-6f;
+    return p;
+}
+
+WheelSpeedController::WheelSpeedController(const WheelSpeedParams &params) : params(params) {
+    feedback.configure(params.gains, params.derivativeFilter, params.dt);
+    reset();
+}
+
+void WheelSpeedController::reset() {
+    feedback.reset();
+    voltage = 0.0f;
+}
+
+float WheelSpeedController::update(float setpoint, float speed, float batteryVoltage) {
+    voltage = params.backEmf * setpoint + feedback.step(setpoint, speed);
+    if (batteryVoltage < params.minBatteryVoltage) {
+        batteryVoltage = params.minBatteryVoltage;
+    }
+    float duty = voltage / batteryVoltage;
+    return duty > 1.0f ? 1.0f : (duty < -1.0f ? -1.0f : duty);
+}
+
+float WheelSpeedController::getVoltage() const {
+    return voltage;
+}
@@ -0,0 +1,70 @@
+/** @file WheelSpeedController.h
+ *  @brief Closed-loop speed control of one drive wheel.
+ */
+
+#ifndef WHEEL_SPEED_CONTROLLER_H
+#define WHEEL_SPEED_CONTROLLER_H
+
+#include "Controller.h"
+
+/**
+ *  @brief Motor model and gains of a wheel speed loop.
+ */
+struct WheelSpeedParams {
+    PIDGains gains;             /**< Speed error (m/s) to motor voltage (V), on top of the feed-forward. */
+    float derivativeFilter;     /**< Weight of the previous derivative term, 0 (no filter) to below 1. */
+    float backEmf;              /**< Motor voltage per wheel surface speed in V s/m, the feed-forward. */
+    float minBatteryVoltage;    /**< Lowest battery reading used to turn voltage into duty, in V. */
+    float dt;                   /**< Loop period in s. */
+
+    /**
+     *  @brief Gets parameters for the ConeBot drive motors at WHEEL_RATE_HZ.
+     */
+    static WheelSpeedParams defaults();
+};
+
+/**
+ *  @class WheelSpeedController
+ *  @brief Regulates the surface speed of one wheel by setting its motor duty.
+ *
+ *  The loop works in volts. The feed-forward is the back-EMF of the
+ *  commanded speed, and a PI term on the measured speed adds the voltage
+ *  that drives torque and makes up for model error. The sum is divided by
+ *  the measured battery voltage, so a sagging battery or a weaker motor
+ *  changes the duty, not the speed the outer loop gets. update() takes a
+ *  fixed number of operations and does no allocation.
+ */
+class WheelSpeedController {
+public:
+    /**
+     *  @brief Constructor for the WheelSpeedController class.
+     *  @param params Motor model and gains.
+     */
+    WheelSpeedController(const WheelSpeedParams &params = WheelSpeedParams::defaults());
+
+    /**
+     *  @brief Clears the integrator, for when the motor has been stopped.
+     */
+    void reset();
+
+    /**
+     *  @brief Runs one sample of the loop.
+     *  @param setpoint Commanded wheel speed in m/s, forward positive.
+     *  @param speed Measured wheel speed in m/s.
+     *  @param batteryVoltage Measured motor supply voltage in V.
+     *  @return Motor duty from -1 to 1.
+     */
+    float update(float setpoint, float speed, float batteryVoltage);
+
+    /**
+     *  @brief Gets the motor voltage requested by the latest update, before saturation.
+     */
+    float getVoltage() const;
+
+private:
+    WheelSpeedParams params;
+    PID<float> feedback;
+    float voltage;
+};
+
+#endif
@@ -15,60 +15,109 @@
  */
 
 #include <Arduino.h>
+#include <Wire.h>
 #include "Motor.h"
 #include "IMU.h"
 #include "GPS.h"
 #include "TOF.h"
 #include "MQTTClientESP32.h"
+#include "ConeBot.h"
+#include "ControlLoop.h"
+#include "TaskConfig.h"
+#include "TaskMonitor.h"
+#include "LatencyMonitor.h"
+#include "FlightRecorder.h"
 
 // Object instantiation
-Motor motorLeft(25, 26, 34, 35, PCNT_UNIT_0);
-Motor motorRight(27, 14, 36, 39, PCNT_UNIT_1);
+Motor motorLeft(25, 26, 34, 35, PCNT_UNIT_0, LEDC_CHANNEL_0);
+Motor motorRight(27, 14, 36, 39, PCNT_UNIT_1, LEDC_CHANNEL_1);
 IMU imuSensor(0x28);
-TOF tofSensor;
-GPS gpsSensor(Serial2, 9600);
+TOF tofSensor(13); // GPIO1 (data ready) of the VL53L4CX on GPIO 13
+GPS gpsSensor(UART_NUM_2, 16, 17, 9600);
 MQTTClientESP32 mqttClient("SpectrumSetup-C8", "Pong_pang2499", "192.168.1.37", 1883);
 
-/**
- * @brief Structure to store sensor measurements.
- */
-typedef struct {
-    float position;      /**< Robot's position. */
-    float angle;         /**< Robot's tilt angle. */
-    int32_t latitude;    /**< Latitude from GPS. */
-    int32_t longtitude;  /**< Longitude from GPS. */
-    uint32_t attitude;   /**< Placeholder for additional attitude data. */
-    uint16_t distance;   /**< Distance from TOF sensor. */
-} Measurement;
-
 // Shared variables
-Share<BotState> botState; /**< Shared variable for robot's state. */
-Share<Measurement> measurement; /**< Shared variable for sensor measurements. */
-Share<bool> obstacleDetected; /**< Shared variable for obstacle detection. */
-
-// FSM States
-/**
- * @brief Finite State Machine (FSM) states for the robot.
- */
-enum ConeBotState {
-    IDLE,               /**< Robot is idle. */
-    CORRECTING_TILT,    /**< Robot is correcting tilt. */
-    MOVING_FORWARD,     /**< Robot is moving forward. */
-    MOVING_BACKWARD,    /**< Robot is moving backward. */
-};
+SensorBus sensorBus; /**< Newest sample of every sensor, one producer task each. */
+LatestValue<ConeBotState> controlState; /**< FSM state, published by the motor control loop when it changes. */
+ObstacleModel obstacleModel; /**< Obstacle model, owned by the TOF ranging task. */
+Odometry odometry; /**< Wheel odometry, owned by the wheel speed loop. */
+LatestValue<WheelSetpoint> wheelSetpoint; /**< Wheel speeds, published by the motor control loop every cycle. */
+CommandQueue commandQueue; /**< Validated commands, from the MQTT task to the motor control loop. */
 
 // Function prototypes
-void motorControlTask(void *parameter);
-void measurementTask(void *parameter);
+void wheelCycle(void *parameter);
+void motorControlCycle(void *parameter);
+void imuTask(void *parameter);
+void onTofFrame(const TofFrame &frame, void *context);
+void onGpsFix(const GpsFix &fix, void *context);
 void mqttTask(void *parameter);
 
+/** @brief Motor control FSM, owned by the motor control loop; its statistics can be read from any task. */
+ConeBotFsm motorFsm;
+
+/** @brief Balance controller, owned by the motor control loop. */
+ConeBotController balanceController;
+
+/** @brief Gains of the balance controller, changed by commands in the motor control loop. */
+BalanceGains balanceGains = DEFAULT_BALANCE_GAINS;
+
+/** @brief Speed loops of the left and right wheel, owned by the wheel speed loop. */
+WheelSpeedController leftSpeedLoop, rightSpeedLoop;
+
+/** @brief Timer-driven loop regulating both wheel speeds at WHEEL_RATE_HZ. */
+ControlLoop wheelLoop(WHEEL_TASK.name, WHEEL_RATE_HZ, wheelCycle);
+
+/** @brief Timer-driven loop running the motor control FSM at CONTROL_RATE_HZ. */
+ControlLoop motorControlLoop(CONTROL_TASK.name, CONTROL_RATE_HZ, motorControlCycle);
+
+/** @brief Age of the IMU sample behind each motor command, recorded by the motor control loop. */
+LatencyMonitor sensorLatency;
+
+/** @brief Time from parsing each command to the wheel setpoint it affected, recorded by the motor control loop. */
+LatencyMonitor commandLatency(1);
+
+/** @brief Black-box log of the sensor bus on LittleFS. */
+FlightRecorder flightRecorder(sensorBus);
+
+/** @brief Periodic report of stack usage and control loop timing. */
+TaskMonitor taskMonitor(Serial);
+
 void setup() {
     Serial.begin(115200);
-
-    // Start FreeRTOS tasks
-    xTaskCreate(motorControlTask, "MotorControlTask", 2048, NULL, 1, NULL);
-    xTaskCreate(measurementTask, "MeasurementTask", 4096, NULL, 1, NULL);
-    xTaskCreate(mqttTask, "MQTTTask", 4096, NULL, 1, NULL);
+    Wire.begin(); // Shared by the IMU and TOF tasks, so bring it up before either starts
+    Wire.setClock(IMU::I2C_CLOCK_HZ);
+#ifdef CONEBOT_RAW_IMU
+    imuSensor.setEstimator(AttitudeParams::defaults());
+#endif
+    motorLeft.begin();
+    motorRight.begin();
+    balanceController.configure(balanceGains, CONTROL_PERIOD_US * 1e-6f);
+
+    // Start FreeRTOS tasks, control path on the APP core and I/O on the PRO core (see TaskConfig.h)
+    wheelLoop.begin(WHEEL_TASK.priority, WHEEL_TASK.core, WHEEL_TASK.stackSize);
+    motorControlLoop.begin(CONTROL_TASK.priority, CONTROL_TASK.core, CONTROL_TASK.stackSize);
+    xTaskCreatePinnedToCore(imuTask, IMU_TASK.name, IMU_TASK.stackSize, NULL, IMU_TASK.priority, NULL,
+                            IMU_TASK.core);
+    tofSensor.setListener(onTofFrame);
+    if (!tofSensor.begin(TOF_TASK.priority, TOF_TASK.core, TOF_TASK.stackSize)) {
+        Serial.println("Failed to initialize TOF sensor");
+    }
+    gpsSensor.setListener(onGpsFix);
+    if (!gpsSensor.begin(GPS_TASK.priority, GPS_TASK.core, GPS_TASK.stackSize)) {
+        Serial.println("Failed to initialize GPS");
+    }
+    if (!flightRecorder.begin(RECORD_TASK, LOG_FLUSH_TASK)) {
+        Serial.println("Failed to start flight recorder");
+    }
+    xTaskCreatePinnedToCore(mqttTask, MQTT_TASK.name, MQTT_TASK.stackSize, NULL, MQTT_TASK.priority, NULL,
+                            MQTT_TASK.core);
+    taskMonitor.watch(wheelLoop);
+    taskMonitor.watch(motorControlLoop);
+    taskMonitor.watch(sensorLatency, "Sensor to actuator");
+    taskMonitor.watch(commandLatency, "Command to actuator");
+    taskMonitor.watch(motorFsm);
+    taskMonitor.watch(flightRecorder);
+    taskMonitor.begin(MONITOR_TASK);
 }
 
 void loop() {
@@ -76,87 +125,103 @@ void loop() {
 }
 
 /**
- * @brief Motor control task to drive the robot forward or backward based on the FSM state.
+ * @brief One cycle of the wheel speed loop, sampling the encoders and regulating both wheels.
+ *
+ * Reads the battery every BATTERY_PERIOD_MS rather than every cycle, since
+ * an ADC conversion costs a noticeable part of the period.
  * 
- * @param parameter FreeRTOS task parameter (unused).
+ * @param parameter Loop context (unused).
  */
-void motorControlTask(void *parameter) {
-    motorLeft.begin();
-    motorRight.begin();
-    ConeBotState currentState = IDLE;
-    while (1) {
-        switch (currentState) {
-            case IDLE:
-                motorLeft.stop();
-                motorRight.stop();
-                break;
-
-            case MOVING_FORWARD:
-                if (obstacleDetected.get()) {
-                    currentState = IDLE;
-                } else {
-                    motorLeft.setSpeed(255);
-                    motorRight.setSpeed(255);
-                }
-                break;
-
-            case MOVING_BACKWARD:
-                if (obstacleDetected.get()) {
-                    currentState = IDLE;
-                }
-                else {
-                    motorLeft.setSpeed(-256);
-                    motorRight.setSpeed(-256);
-                }
-                break;
-
-            case CORRECTING_TILT:
-                if (abs(measurement.get().angle) < 5.0) {
-                    motorLeft.setSpeed(50);
-                    motorRight.setSpeed(50);
-                }
-                break;
-        }
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+void wheelCycle(void *parameter) {
+    static const uint32_t batteryCycles = BATTERY_PERIOD_MS * WHEEL_RATE_HZ / 1000;
+    static uint32_t cycle = 0;
+    static float batteryVoltage = 0.0f;
+    if (cycle++ % batteryCycles == 0) {
+        batteryVoltage = readBatteryVoltage();
+    }
+    encoderStep(motorLeft, motorRight, odometry, sensorBus);
+    wheelStep(wheelSetpoint.get(), odometry.getState(), batteryVoltage, leftSpeedLoop, rightSpeedLoop,
+              motorLeft, motorRight);
+}
+
+/**
+ * @brief One cycle of the motor control loop, setting the wheel speeds based on the FSM state.
+ *
+ * Applies up to MAX_COMMANDS_PER_CYCLE queued commands first, so a command
+ * takes effect within one cycle of arriving unless a burst is queued ahead
+ * of it.
+ * 
+ * @param parameter Loop context (unused).
+ */
+void motorControlCycle(void *parameter) {
+    static Measurement measurement = {};
+    bool obstacleDetected = false;
+    WheelSetpoint setpoint;
+    ConeBotState previousState = motorFsm.getState();
+    int64_t commandTimes[MAX_COMMANDS_PER_CYCLE];
+    uint8_t commandCount = 0;
+    Command command;
+    while (commandCount < MAX_COMMANDS_PER_CYCLE && commandQueue.pop(command)) {
+        commandStep(motorFsm, command, balanceController, balanceGains);
+        CommandSample applied = {nowMicros(), command};
+        sensorBus.commands.push(applied);
+        commandTimes[commandCount++] = command.receivedAt;
+    }
+    readMeasurement(sensorBus, measurement, obstacleDetected);
+    int64_t cycleTime = nowMicros();
+    ConeBotState currentState = motorControlStep(motorFsm, measurement, obstacleDetected, cycleTime,
+                                                 balanceController, setpoint);
+    wheelSetpoint.put(setpoint);
+    int64_t actuationTime = nowMicros();
+    for (uint8_t i = 0; i < commandCount; i++) {
+        commandLatency.record(commandTimes[i], actuationTime);
+    }
+    controlStep(currentState, measurement, setpoint, cycleTime, sensorBus);
+    if (currentState != previousState) {
+        controlState.put(currentState);
+    }
+    if (measurement.imuTimestamp != 0) {
+        sensorLatency.record(measurement.imuTimestamp, nowMicros());
     }
 }
 
 /**
- * @brief Measurement task to handle IMU, TOF, and GPS sensor updates.
+ * @brief IMU producer task, publishing a sample on the sensor bus every IMU_PERIOD_MS.
+ *
+ * Also lets the IMU save its refined calibration while the robot is idle.
  * 
  * @param parameter FreeRTOS task parameter (unused).
  */
-void measurementTask(void *parameter) {
-    Measurement local_measurement;
-    obstacleDetected.put(false);
+void imuTask(void *parameter) {
     if (!imuSensor.begin()) {
         Serial.println("Failed to initialize IMU");
     }
-    if (!tofSensor.begin()) {
-        Serial.println("Failed to initialize TOF sensor");
-    }
-    gpsSensor.begin();
+    TickType_t lastWake = xTaskGetTickCount();
     while (1) {
-        local_measurement = measurement.get();
-        // IMU Update
-        imuSensor.update();
-        local_measurement.angle = imuSensor.getPitch();
-
-        // TOF Update
-        uint16_t distance = tofSensor.getDistance();
-        obstacleDetected.put(distance > 0 && distance < 10);
-
-        // Update the shared state
-        BotState local_state = botState.get();
-        local_state.position = gpsSensor.getLatitude().toFloat();
-        local_state.tilt_angle = local_measurement.angle;
-        botState.put(local_state);
+        imuStep(imuSensor, sensorBus);
+        imuSensor.refineCalibration(controlState.get() == IDLE);
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(IMU_PERIOD_MS));
+    }
+}
 
-        // GPS Update
-        gpsSensor.update();
+/**
+ * @brief Runs the obstacle model on each TOF range, in the TOF ranging task.
+ * 
+ * @param frame Newly completed range.
+ * @param context Listener context (unused).
+ */
+void onTofFrame(const TofFrame &frame, void *context) {
+    obstacleStep(frame, obstacleModel, sensorBus);
+}
 
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
+/**
+ * @brief Publishes each GPS fix on the sensor bus, in the GPS ingest task.
+ * 
+ * @param fix Newly decoded fix.
+ * @param context Listener context (unused).
+ */
+void onGpsFix(const GpsFix &fix, void *context) {
+    gpsStep(fix, sensorBus);
 }
 
 /**
@@ -0,0 +1,86 @@
+/** @file AttitudeReplay.cpp
+ *  @brief Implementation of the attitude estimator replay.
+ */
+
+#include "AttitudeReplay.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+bool loadAttitudeRecording(const char *path, std::vector<AttitudeRecord> &records) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        double values[8];
+        int count = 0;
+        char *cursor = line;
+        while (count < 8) {
+            char *end;
+            values[count] = strtod(cursor, &end);
+            if (end == cursor) {
+                break;
+            }
+            count++;
+            cursor = end;
+            while (*cursor == ',' || *cursor == ' ' || *cursor == '\t') {
+                cursor++;
+            }
+        }
+        if (count < 7) {
+            continue;
+        }
+        AttitudeRecord record;
+        record.time = values[0];
+        for (int i = 0; i < 3; i++) {
+            record.sample.gyro[i] = (float)values[1 + i];
+            record.sample.accel[i] = (float)values[4 + i];
+        }
+        record.referencePitch = count > 7 ? (float)values[7] : NAN;
+        records.push_back(record);
+    }
+    fclose(file);
+    return !records.empty();
+}
+
+AttitudeReport replayAttitude(const std::vector<AttitudeRecord> &records, const AttitudeParams &params,
+                              double settleSeconds, FILE *trace) {
+    AttitudeReport report = {};
+    AttitudeEstimator estimator(params);
+    double errorSum = 0, squareSum = 0;
+    double start = records.empty() ? 0 : records[0].time;
+    double previous = start;
+
+    if (trace) {
+        fprintf(trace, "time,reference_pitch,pitch,pitch_rate\n");
+    }
+    for (size_t i = 0; i < records.size(); i++) {
+        const AttitudeRecord &record = records[i];
+        estimator.update(record.sample, (float)(record.time - previous));
+        previous = record.time;
+        report.samples++;
+
+        float pitch = estimator.getPitch();
+        if (trace) {
+            fprintf(trace, "%.6f,%.4f,%.4f,%.4f\n", record.time, record.referencePitch, pitch,
+                    estimator.getPitchRate());
+        }
+        if (isnan(record.referencePitch) || record.time - start < settleSeconds) {
+            continue;
+        }
+        float error = pitch - record.referencePitch;
+        errorSum += error;
+        squareSum += (double)error * error;
+        if (fabsf(error) > report.maxError) {
+            report.maxError = fabsf(error);
+        }
+        report.compared++;
+    }
+    if (report.compared) {
+        report.meanError = (float)(errorSum / report.compared);
+        report.rmsError = (float)sqrt(squareSum / report.compared);
+    }
+    return report;
+}
@@ -0,0 +1,59 @@
+/** @file AttitudeReplay.h
+ *  @brief Runs the attitude estimator over recorded raw IMU data for validation.
+ */
+
+#ifndef ATTITUDE_REPLAY_H
+#define ATTITUDE_REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "AttitudeEstimator.h"
+
+/**
+ *  @brief One row of a raw IMU recording.
+ */
+struct AttitudeRecord {
+    double time;             /**< Sample time in s. */
+    InertialSample sample;   /**< Raw gyro and accelerometer reading. */
+    float referencePitch;    /**< Pitch from a reference in degrees, or NAN if the recording has none. */
+};
+
+/**
+ *  @brief Agreement of the estimator with the reference pitch.
+ */
+struct AttitudeReport {
+    uint64_t samples;    /**< Samples fed to the estimator. */
+    uint64_t compared;   /**< Samples compared against the reference, after the settling time. */
+    float meanError;     /**< Mean of estimate minus reference in degrees. */
+    float rmsError;      /**< RMS of estimate minus reference in degrees. */
+    float maxError;      /**< Largest absolute difference in degrees. */
+};
+
+/**
+ *  @brief Reads a CSV recording.
+ *
+ *  Each row is time in s, gyro x, y, z in deg/s, accelerometer x, y, z in
+ *  m/s^2 and optionally a reference pitch in degrees. Lines that do not
+ *  start with a number, such as a header, are skipped.
+ *
+ *  @param path File to read.
+ *  @param records Receives the rows.
+ *  @return True if the file was read and had at least one row.
+ */
+bool loadAttitudeRecording(const char *path, std::vector<AttitudeRecord> &records);
+
+/**
+ *  @brief Feeds a recording through an estimator and compares it with the reference pitch.
+ *
+ *  @param records Recording to replay.
+ *  @param params Tuning of the estimator.
+ *  @param settleSeconds Time from the first sample before errors are counted.
+ *  @param trace If set, a CSV row of time, reference, estimated pitch and pitch rate is written here per sample.
+ *  @return Agreement with the reference.
+ */
+AttitudeReport replayAttitude(const std::vector<AttitudeRecord> &records, const AttitudeParams &params,
+                              double settleSeconds, FILE *trace);
+
+#endif
@@ -0,0 +1,111 @@
+/** @file Benchmark.cpp
+ *  @brief Implementation of the native microbenchmarks.
+ */
+
+#include "Benchmark.h"
+
+#include <chrono>
+#include <math.h>
+
+#include "ConeBot.h"
+#include "FixedPoint.h"
+#include "PendulumSim.h"
+
+typedef std::chrono::steady_clock WallClock;
+
+/** @brief Number of distinct input samples, cycled through during a run. */
+static const uint32_t INPUT_COUNT = 1024;
+
+/** @brief Receives each run's output so the timed loop is not optimized away. */
+static volatile float benchSink;
+
+template <typename T>
+static BenchResult timeController(BalanceMode mode, uint64_t calls) {
+    // Inputs in the range seen while balancing: a few cm, a few degrees and tens of degrees per second
+    static T position[INPUT_COUNT], pitch[INPUT_COUNT], pitchRate[INPUT_COUNT];
+    SimRandom random(1);
+    for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+        position[i] = T(0.05f * random.gaussian());
+        pitch[i] = T(3.0f * random.gaussian());
+        pitchRate[i] = T(30.0f * random.gaussian());
+    }
+
+    BalanceGains gains = DEFAULT_BALANCE_GAINS;
+    gains.mode = mode;
+    BalanceController<T> controller;
+    controller.configure(gains, CONTROL_PERIOD_US * 1e-6f);
+
+    T sum = T(0);
+    WallClock::time_point start = WallClock::now();
+    for (uint64_t i = 0; i < calls; i++) {
+        uint32_t index = (uint32_t)i & (INPUT_COUNT - 1);
+        sum += controller.step(position[index], pitch[index], pitchRate[index]);
+    }
+    double seconds = std::chrono::duration<double>(WallClock::now() - start).count();
+    benchSink = (float)sum;
+
+    BenchResult result;
+    result.calls = calls;
+    result.nanosPerCall = calls ? seconds * 1e9 / calls : 0.0;
+    return result;
+}
+
+BenchResult benchmarkController(BalanceMode mode, bool fixedPoint, uint64_t calls) {
+    return fixedPoint ? timeController<Q16>(mode, calls) : timeController<float>(mode, calls);
+}
+
+BenchResult benchmarkEstimator(AttitudeFilter filter, uint64_t calls) {
+    // A robot rocking a few degrees about upright, with gyro and accelerometer noise
+    static InertialSample samples[INPUT_COUNT];
+    SimRandom random(1);
+    for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+        float pitch = 0.05f * random.gaussian();
+        for (int axis = 0; axis < 3; axis++) {
+            samples[i].gyro[axis] = 20.0f * random.gaussian();
+        }
+        samples[i].accel[0] = -9.81f * sinf(pitch) + 0.5f * random.gaussian();
+        samples[i].accel[1] = 0.2f * random.gaussian();
+        samples[i].accel[2] = 9.81f * cosf(pitch) + 0.2f * random.gaussian();
+    }
+
+    AttitudeParams params = AttitudeParams::defaults();
+    params.filter = filter;
+    AttitudeEstimator estimator(params);
+
+    float sum = 0;
+    WallClock::time_point start = WallClock::now();
+    for (uint64_t i = 0; i < calls; i++) {
+        estimator.update(samples[(uint32_t)i & (INPUT_COUNT - 1)], 0.001f);
+        sum += estimator.getPitch();
+    }
+    double seconds = std::chrono::duration<double>(WallClock::now() - start).count();
+    benchSink = sum;
+
+    BenchResult result;
+    result.calls = calls;
+    result.nanosPerCall = calls ? seconds * 1e9 / calls : 0.0;
+    return result;
+}
+
+NmeaBenchResult benchmarkNmea(const std::vector<char> &capture, uint32_t passes) {
+    static const size_t READ_CHUNK = 128;
+    NMEAParser parser;
+    NmeaBenchResult result = {};
+
+    WallClock::time_point start = WallClock::now();
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        parser.reset();
+        for (size_t offset = 0; offset < capture.size(); offset += READ_CHUNK) {
+            size_t length = capture.size() - offset < READ_CHUNK ? capture.size() - offset : READ_CHUNK;
+            parser.encode(&capture[offset], length);
+        }
+        result.sentences += parser.getSentenceCount();
+    }
+    result.seconds = std::chrono::duration<double>(WallClock::now() - start).count();
+    benchSink = (float)parser.getFix().latitude;
+
+    result.bytes = (uint64_t)capture.size() * passes;
+    result.checksumErrors = parser.getChecksumErrors();
+    result.overflows = parser.getOverflowCount();
+    return result;
+}
@@ -0,0 +1,69 @@
+/** @file Benchmark.h
+ *  @brief Microbenchmarks of the control code for the native build.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "AttitudeEstimator.h"
+#include "Controller.h"
+#include "NMEAParser.h"
+
+/**
+ *  @brief Timing of one benchmarked function.
+ */
+struct BenchResult {
+    uint64_t calls;       /**< Number of timed calls. */
+    double nanosPerCall;  /**< Mean wall time per call in ns. */
+};
+
+/**
+ *  @brief Times BalanceController::step() on a fixed set of recorded-like inputs.
+ *
+ *  The inputs are generated before the clock starts, so the result is the
+ *  cost of the controller alone. The gains are DEFAULT_BALANCE_GAINS with
+ *  the mode replaced by @p mode.
+ *
+ *  @param mode Controller structure to time.
+ *  @param fixedPoint True to time the Q15.16 controller, false for float.
+ *  @param calls Number of steps to time.
+ *  @return Timing of the step.
+ */
+BenchResult benchmarkController(BalanceMode mode, bool fixedPoint, uint64_t calls);
+
+/**
+ *  @brief Times AttitudeEstimator::update() on synthetic raw IMU samples.
+ *
+ *  @param filter Algorithm to time.
+ *  @param calls Number of updates to time.
+ *  @return Timing of the update.
+ */
+BenchResult benchmarkEstimator(AttitudeFilter filter, uint64_t calls);
+
+/**
+ *  @brief Throughput of the NMEA parser over a capture.
+ */
+struct NmeaBenchResult {
+    uint64_t bytes;           /**< Characters fed, over all passes. */
+    uint64_t sentences;       /**< Sentences that passed the checksum, over all passes. */
+    uint32_t checksumErrors;  /**< Sentences rejected in one pass. */
+    uint32_t overflows;       /**< Sentences too long for the buffer in one pass. */
+    double seconds;           /**< Wall time of all passes. */
+};
+
+/**
+ *  @brief Times NMEAParser::encode() over a recorded NMEA stream.
+ *
+ *  The capture is fed in 128-byte blocks, as GPS::drain() reads the UART,
+ *  @p passes times through one parser.
+ *
+ *  @param capture Raw bytes from the receiver, loaded before the clock starts.
+ *  @param passes Number of times the capture is fed.
+ *  @return Throughput of the parser.
+ */
+NmeaBenchResult benchmarkNmea(const std::vector<char> &capture, uint32_t passes);
+
+#endif
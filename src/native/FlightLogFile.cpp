@@ -0,0 +1,162 @@
+/** @file FlightLogFile.cpp
+ *  @brief Implementation of the host-side flight log tools.
+ */
+
+#include "FlightLogFile.h"
+
+#include <string.h>
+
+/** @brief File name suffix and CSV header of each record type. */
+static const char *const CSV_NAMES[RECORD_TYPE_COUNT] = {
+    NULL, "imu", "encoder", "tof", "gps", "command", "control", "transition",
+};
+
+static const char *const CSV_HEADERS[RECORD_TYPE_COUNT] = {
+    NULL,
+    "timestamp,pitch,pitch_rate",
+    "timestamp,left,right",
+    "timestamp,count,distance0,status0,signal_rate0,sigma0,distance1,status1,signal_rate1,sigma1,"
+    "distance2,status2,signal_rate2,sigma2,distance3,status3,signal_rate3,sigma3",
+    "timestamp,utc_millis,date,latitude,longitude,altitude,speed,course,hdop,fix_quality,satellites,valid",
+    "timestamp,type,state,stage,value0,value1,value2,value3,received_at",
+    "timestamp,state,left_setpoint,right_setpoint,imu_timestamp,encoder_timestamp,obstacle_timestamp,gps_timestamp",
+    "timestamp,from,to",
+};
+
+FlightLogFile::FlightLogFile(FILE *file) : file(file), blocks(0) {}
+
+bool FlightLogFile::writeBlock(const uint8_t *block) {
+    if (fwrite(block, 1, FLIGHT_LOG_BLOCK_SIZE, file) != FLIGHT_LOG_BLOCK_SIZE) {
+        return false;
+    }
+    blocks++;
+    return true;
+}
+
+uint32_t FlightLogFile::getBlockCount() const {
+    return blocks;
+}
+
+bool loadFlightLog(const char *path, std::vector<FlightRecord> &records, FlightLogReport &report,
+                   std::vector<FlightLogSession> *sessions) {
+    memset(&report, 0, sizeof(report));
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    static uint8_t block[FLIGHT_LOG_BLOCK_SIZE];
+    FlightLogReader reader;
+    FlightRecord record;
+    bool first = true;
+    uint32_t session = 0, sequence = 0;
+    while (fread(block, 1, sizeof(block), file) == sizeof(block)) {
+        report.blocks++;
+        if (!reader.load(block)) {
+            report.badBlocks++;
+            continue;
+        }
+        if (first || reader.getSession() != session) {
+            report.sessions++;
+            if (sessions) {
+                FlightLogSession start = {reader.getSession(), reader.getSequence(), records.size()};
+                sessions->push_back(start);
+            }
+        } else if (reader.getSequence() > sequence + 1) {
+            report.missingBlocks += reader.getSequence() - sequence - 1;
+        }
+        first = false;
+        session = reader.getSession();
+        sequence = reader.getSequence();
+        while (reader.next(record)) {
+            report.records[record.type]++;
+            records.push_back(record);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static void writeCsvRow(FILE *file, const FlightRecord &record) {
+    switch (record.type) {
+        case RECORD_IMU:
+            fprintf(file, "%lld,%.9g,%.9g\n", (long long)record.imu.timestamp, record.imu.pitch,
+                    record.imu.pitchRate);
+            break;
+
+        case RECORD_ENCODER:
+            fprintf(file, "%lld,%lld,%lld\n", (long long)record.encoder.timestamp, (long long)record.encoder.left,
+                    (long long)record.encoder.right);
+            break;
+
+        case RECORD_TOF:
+            fprintf(file, "%lld,%u", (long long)record.tof.timestamp, (unsigned)record.tof.count);
+            for (uint8_t i = 0; i < TOF_MAX_TARGETS; i++) {
+                const TofTarget &target = record.tof.targets[i];
+                if (i < record.tof.count) {
+                    fprintf(file, ",%u,%u,%.9g,%.9g", (unsigned)target.distance, (unsigned)target.status,
+                            target.signalRate, target.sigma);
+                } else {
+                    fputs(",,,,", file);
+                }
+            }
+            fputc('\n', file);
+            break;
+
+        case RECORD_GPS: {
+            const GpsFix &fix = record.gps.fix;
+            fprintf(file, "%lld,%u,%u,%d,%d,%d,%u,%u,%u,%u,%u,%d\n", (long long)record.gps.timestamp,
+                    (unsigned)fix.utcMillis, (unsigned)fix.date, (int)fix.latitude, (int)fix.longitude,
+                    (int)fix.altitude, (unsigned)fix.speed, (unsigned)fix.course, (unsigned)fix.hdop,
+                    (unsigned)fix.fixQuality, (unsigned)fix.satellites, fix.valid ? 1 : 0);
+            break;
+        }
+
+        case RECORD_COMMAND: {
+            const Command &command = record.command.command;
+            fprintf(file, "%lld,%u,%u,%u,%.9g,%.9g,%.9g,%.9g,%lld\n", (long long)record.command.timestamp,
+                    (unsigned)command.type, (unsigned)command.state, (unsigned)command.stage, command.values[0],
+                    command.values[1], command.values[2], command.values[3], (long long)command.receivedAt);
+            break;
+        }
+
+        case RECORD_CONTROL: {
+            const ControlSample &control = record.control;
+            fprintf(file, "%lld,%u,%.9g,%.9g,%lld,%lld,%lld,%lld\n", (long long)control.timestamp,
+                    (unsigned)control.state, control.leftSetpoint, control.rightSetpoint,
+                    (long long)control.imuTimestamp, (long long)control.encoderTimestamp,
+                    (long long)control.obstacleTimestamp, (long long)control.gpsTimestamp);
+            break;
+        }
+
+        case RECORD_TRANSITION:
+            fprintf(file, "%lld,%u,%u\n", (long long)record.transition.timestamp, (unsigned)record.transition.from,
+                    (unsigned)record.transition.to);
+            break;
+    }
+}
+
+bool writeFlightLogCsv(const std::vector<FlightRecord> &records, const char *prefix) {
+    FILE *files[RECORD_TYPE_COUNT] = {};
+    bool ok = true;
+    for (size_t i = 0; i < records.size() && ok; i++) {
+        uint8_t type = records[i].type;
+        if (!files[type]) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s_%s.csv", prefix, CSV_NAMES[type]);
+            files[type] = fopen(path, "w");
+            if (!files[type]) {
+                fprintf(stderr, "Cannot open %s\n", path);
+                ok = false;
+                break;
+            }
+            fprintf(files[type], "%s\n", CSV_HEADERS[type]);
+        }
+        writeCsvRow(files[type], records[i]);
+    }
+    for (int type = 0; type < RECORD_TYPE_COUNT; type++) {
+        if (files[type]) {
+            fclose(files[type]);
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,93 @@
+/** @file FlightLogFile.h
+ *  @brief Host-side writing, reading and CSV conversion of flight logs.
+ */
+
+#ifndef FLIGHT_LOG_FILE_H
+#define FLIGHT_LOG_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "FlightLog.h"
+
+/**
+ *  @class FlightLogFile
+ *  @brief Sink appending each block to a file, the layout of the robot's log files.
+ */
+class FlightLogFile : public FlightLogSink {
+public:
+    /**
+     *  @brief Constructor for the FlightLogFile class.
+     *  @param file Open file the blocks are appended to, kept open by the caller.
+     */
+    FlightLogFile(FILE *file);
+
+    /**
+     *  @brief Appends one block to the file.
+     *  @param block FLIGHT_LOG_BLOCK_SIZE bytes.
+     *  @return False if the write failed.
+     */
+    bool writeBlock(const uint8_t *block) override;
+
+    /**
+     *  @brief Gets the number of blocks written.
+     */
+    uint32_t getBlockCount() const;
+
+private:
+    FILE *file;
+    uint32_t blocks;
+};
+
+/**
+ *  @brief Contents of a log file.
+ */
+struct FlightLogReport {
+    uint32_t blocks;                          /**< Blocks in the file. */
+    uint32_t badBlocks;                       /**< Blocks failing the magic, version or CRC check, skipped. */
+    uint32_t missingBlocks;                   /**< Gaps in the sequence numbers within a session. */
+    uint32_t sessions;                        /**< Sessions, counted at each change of session between blocks. */
+    uint64_t records[RECORD_TYPE_COUNT];      /**< Records decoded, by FlightRecordType. */
+};
+
+/**
+ *  @brief Position of one session in the records of a log file.
+ */
+struct FlightLogSession {
+    uint32_t session;         /**< Session identifier of its blocks. */
+    uint32_t firstSequence;   /**< Sequence number of its first block, 0 if the file holds the session from boot. */
+    size_t firstRecord;       /**< Index of its first record. */
+};
+
+/**
+ *  @brief Reads every record of a log file.
+ *
+ *  The file is a sequence of FLIGHT_LOG_BLOCK_SIZE blocks, as written by
+ *  the robot or FlightLogFile, or the payloads of the "bot/log" messages
+ *  of an upload concatenated in order. Damaged blocks are skipped.
+ *
+ *  @param path File to read.
+ *  @param records Receives the records in file order.
+ *  @param report Receives the block and record counts.
+ *  @param sessions If set, receives each session in file order.
+ *  @return False if the file cannot be read.
+ */
+bool loadFlightLog(const char *path, std::vector<FlightRecord> &records, FlightLogReport &report,
+                   std::vector<FlightLogSession> *sessions = NULL);
+
+/**
+ *  @brief Writes records as one CSV file per record type.
+ *
+ *  The files are named after @p prefix and the type, such as prefix_imu.csv,
+ *  and each starts with a header row. Only types with records get a file.
+ *  Floats are printed with nine significant digits, so they read back to the
+ *  same value.
+ *
+ *  @param records Records to write.
+ *  @param prefix Path prefix of the files.
+ *  @return False if a file cannot be created.
+ */
+bool writeFlightLogCsv(const std::vector<FlightRecord> &records, const char *prefix);
+
+#endif
@@ -0,0 +1,120 @@
+/** @file LogReplay.cpp
+ *  @brief Implementation of the flight log replay.
+ */
+
+#include "LogReplay.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "SimHAL.h"
+
+static int64_t recordTime(const FlightRecord &record) {
+    switch (record.type) {
+        case RECORD_IMU: return record.imu.timestamp;
+        case RECORD_ENCODER: return record.encoder.timestamp;
+        case RECORD_TOF: return record.tof.timestamp;
+        case RECORD_GPS: return record.gps.timestamp;
+        case RECORD_COMMAND: return record.command.timestamp;
+        case RECORD_CONTROL: return record.control.timestamp;
+        default: return record.transition.timestamp;
+    }
+}
+
+/** @brief Records of one type in time order, and the next one to feed. */
+struct ReplayStream {
+    std::vector<const FlightRecord *> records;
+    size_t next;
+
+    const FlightRecord *take(int64_t until) {
+        if (next >= records.size() || recordTime(*records[next]) > until) {
+            return NULL;
+        }
+        return records[next++];
+    }
+};
+
+static bool sameBits(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+ReplayReport replayFlightLog(const std::vector<FlightRecord> &records, size_t first, size_t last,
+                             const BalanceGains &gains, FILE *trace) {
+    ReplayReport report = {};
+    report.firstMismatch = -1;
+
+    // The recorder drains the rings one after another, so only records of one type are in time order
+    ReplayStream streams[RECORD_TYPE_COUNT] = {};
+    for (size_t i = first; i < last; i++) {
+        streams[records[i].type].records.push_back(&records[i]);
+    }
+    const std::vector<const FlightRecord *> &cycles = streams[RECORD_CONTROL].records;
+    if (cycles.empty()) {
+        return report;
+    }
+
+    SensorBus bus;
+    Odometry odometry;
+    ObstacleModel obstacles;
+    BalanceGains replayGains = gains;
+    ConeBotController controller;
+    controller.configure(replayGains, CONTROL_PERIOD_US * 1e-6f);
+    ConeBotFsm fsm((ConeBotState)cycles[0]->control.state);
+    Measurement measurement = {};
+    bool obstacleDetected = false;
+
+    if (trace) {
+        fprintf(trace, "time,logged_state,state,logged_left,left,logged_right,right\n");
+    }
+    for (size_t i = 0; i < cycles.size(); i++) {
+        const ControlSample &logged = cycles[i]->control;
+        setSimTime(logged.timestamp);
+
+        // Producers, up to the sample each input of the cycle came from
+        const FlightRecord *record;
+        while ((record = streams[RECORD_IMU].take(logged.imuTimestamp))) {
+            bus.imu.push(record->imu);
+        }
+        while ((record = streams[RECORD_ENCODER].take(logged.encoderTimestamp))) {
+            odometryStep(record->encoder, odometry, bus);
+        }
+        while ((record = streams[RECORD_TOF].take(logged.obstacleTimestamp))) {
+            obstacleStep(record->tof, obstacles, bus);
+        }
+        while ((record = streams[RECORD_GPS].take(logged.gpsTimestamp))) {
+            bus.gps.push(record->gps);
+        }
+
+        // The motor control cycle, as motorControlCycle() runs it
+        while ((record = streams[RECORD_COMMAND].take(logged.timestamp))) {
+            commandStep(fsm, record->command.command, controller, replayGains);
+        }
+        WheelSetpoint setpoint;
+        readMeasurement(bus, measurement, obstacleDetected);
+        ConeBotState state = motorControlStep(fsm, measurement, obstacleDetected, logged.timestamp, controller,
+                                              setpoint);
+        report.cycles++;
+
+        if (measurement.imuTimestamp != logged.imuTimestamp ||
+            measurement.encoderTimestamp != logged.encoderTimestamp ||
+            measurement.obstacleTimestamp != logged.obstacleTimestamp ||
+            measurement.gpsTimestamp != logged.gpsTimestamp) {
+            report.inputMismatches++;
+        }
+        if ((uint8_t)state != logged.state || !sameBits(setpoint.left, logged.leftSetpoint) ||
+            !sameBits(setpoint.right, logged.rightSetpoint)) {
+            if (report.mismatches++ == 0) {
+                report.firstMismatch = logged.timestamp;
+            }
+        }
+        float error = fmaxf(fabsf(setpoint.left - logged.leftSetpoint), fabsf(setpoint.right - logged.rightSetpoint));
+        if (error > report.maxSetpointError) {
+            report.maxSetpointError = error;
+        }
+        if (trace) {
+            fprintf(trace, "%lld,%u,%u,%.9g,%.9g,%.9g,%.9g\n", (long long)logged.timestamp, (unsigned)logged.state,
+                    (unsigned)state, logged.leftSetpoint, setpoint.left, logged.rightSetpoint, setpoint.right);
+        }
+    }
+    return report;
+}
@@ -0,0 +1,52 @@
+/** @file LogReplay.h
+ *  @brief Replays a flight log through the motor control cycle and checks its outputs against the log.
+ */
+
+#ifndef LOG_REPLAY_H
+#define LOG_REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "ConeBot.h"
+
+/**
+ *  @brief Agreement of a replay with the log.
+ */
+struct ReplayReport {
+    uint64_t cycles;            /**< Control cycles replayed, one per control record. */
+    uint64_t mismatches;        /**< Cycles whose FSM state or wheel setpoints differ from the log in any bit. */
+    uint64_t inputMismatches;   /**< Cycles whose measurement was not built from the samples the log names. */
+    int64_t firstMismatch;      /**< Timestamp of the first mismatching cycle, or -1 if none. */
+    float maxSetpointError;     /**< Largest difference of a wheel setpoint from the log in m/s. */
+};
+
+/**
+ *  @brief Replays one session of a flight log through the motor control cycle.
+ *
+ *  The recorded IMU, encoder, TOF and GPS samples and the applied commands
+ *  are fed through the same odometryStep(), obstacleStep(), commandStep(),
+ *  readMeasurement() and motorControlStep() the robot runs, into a fresh
+ *  sensor bus, odometry, obstacle model and controller. The virtual clock
+ *  is set to each logged control cycle's time, and before the cycle exactly
+ *  the samples up to the ones its control record says it used are pushed,
+ *  so the cycle sees the bus as the robot's did. Its state and setpoints are
+ *  then compared bit for bit with the record. The replay runs as fast as
+ *  the host allows.
+ *
+ *  The state before the first cycle is not logged; it is taken from the
+ *  first control record. The replay matches from the start only if the
+ *  session was logged from boot with no samples lost.
+ *
+ *  @param records Records of the log in file order.
+ *  @param first Index of the session's first record.
+ *  @param last One past the index of the session's last record.
+ *  @param gains Gains the controller starts with, before any logged COMMAND_SET_GAINS.
+ *  @param trace If set, a CSV row of the logged and replayed state and setpoints is written here per cycle.
+ *  @return Agreement with the log.
+ */
+ReplayReport replayFlightLog(const std::vector<FlightRecord> &records, size_t first, size_t last,
+                             const BalanceGains &gains, FILE *trace);
+
+#endif
@@ -0,0 +1,141 @@
+/** @file PendulumSim.cpp
+ *  @brief Implementation of the wheeled inverted pendulum model.
+ */
+
+#include "PendulumSim.h"
+
+#include <math.h>
+
+static const float TWO_PI = 6.28318530718f;
+
+PendulumParams PendulumParams::defaults() {
+    PendulumParams p;
+    p.bodyMass = 0.8f;
+    p.bodyInertia = 0.0027f;
+    p.comHeight = 0.10f;
+    p.wheelMass = 0.05f;
+    p.wheelInertia = 0.00004f;
+    p.wheelRadius = 0.04f;
+    p.trackWidth = 0.15f;
+    p.yawInertia = 0.002f;
+    p.batteryVoltage = 7.4f;
+    p.motorResistance = 2.5f;
+    p.motorKt = 0.3f;
+    p.motorKe = 0.3f;
+    p.motorFriction = 0.001f;
+    p.countsPerRev = 660.0f;
+    p.gravity = 9.81f;
+    return p;
+}
+
+PendulumSim::PendulumSim(const PendulumParams &params) : params(params) {
+    halfTrack = 0.5f * params.trackWidth;
+    float wheelMass = 2.0f * (params.wheelMass + params.wheelInertia / (params.wheelRadius * params.wheelRadius));
+    axleMass = wheelMass + params.bodyMass;
+    bodyMoment = params.bodyMass * params.comHeight;
+    pitchInertia = params.bodyInertia + bodyMoment * params.comHeight;
+    yawInertia = params.yawInertia + wheelMass * halfTrack * halfTrack;
+    countsPerRad = params.countsPerRev / TWO_PI;
+    countsPerMeter = countsPerRad / params.wheelRadius;
+
+    // step() runs every simulated millisecond, so the divisions are done once here
+    inverseRadius = 1.0f / params.wheelRadius;
+    torquePerDuty = params.motorKt * params.batteryVoltage / params.motorResistance;
+    torquePerSpeed = params.motorKt * params.motorKe / params.motorResistance + params.motorFriction;
+    yawGain = halfTrack / (params.wheelRadius * yawInertia);
+    reset(0.0f);
+}
+
+void PendulumSim::reset(float pitch) {
+    state = PendulumState();
+    state.pitch = pitch;
+}
+
+float PendulumSim::motorTorque(float duty, float wheelSpeed) const {
+    duty = duty > 1.0f ? 1.0f : (duty < -1.0f ? -1.0f : duty);
+    return torquePerDuty * duty - torquePerSpeed * wheelSpeed;
+}
+
+void PendulumSim::step(float dt, float dutyLeft, float dutyRight) {
+    const PendulumParams &p = params;
+
+    // Wheel speeds relative to the body, as seen by the motors and encoders
+    float vLeft = state.xDot - state.yawRate * halfTrack;
+    float vRight = state.xDot + state.yawRate * halfTrack;
+    float torqueLeft = motorTorque(dutyLeft, vLeft * inverseRadius - state.pitchRate);
+    float torqueRight = motorTorque(dutyRight, vRight * inverseRadius - state.pitchRate);
+    float torque = torqueLeft + torqueRight;
+
+    // Cart-pole equations of motion, solved for the axle and pitch accelerations
+    float s = sinf(state.pitch);
+    float c = cosf(state.pitch);
+    float a12 = bodyMoment * c;
+    float b1 = torque * inverseRadius + bodyMoment * s * state.pitchRate * state.pitchRate;
+    float b2 = bodyMoment * p.gravity * s - torque;
+    float inverseDet = 1.0f / (axleMass * pitchInertia - a12 * a12);
+    float xAcc = (b1 * pitchInertia - a12 * b2) * inverseDet;
+    float pitchAcc = (axleMass * b2 - a12 * b1) * inverseDet;
+
+    // Differential wheel forces turn the robot
+    float yawAcc = (torqueRight - torqueLeft) * yawGain;
+
+    state.xDot += xAcc * dt;
+    state.pitchRate += pitchAcc * dt;
+    state.yawRate += yawAcc * dt;
+    state.x += state.xDot * dt;
+    state.pitch += state.pitchRate * dt;
+    state.yaw += state.yawRate * dt;
+    state.wheelLeft += (state.xDot - state.yawRate * halfTrack) * dt;
+    state.wheelRight += (state.xDot + state.yawRate * halfTrack) * dt;
+
+    // Past the tipping point the body rests on the ground
+    if (hasFallen()) {
+        state.pitch = state.pitch > 0 ? 1.2f : -1.2f;
+        state.pitchRate = 0;
+        state.xDot = 0;
+        state.yawRate = 0;
+    }
+}
+
+const PendulumState &PendulumSim::getState() const {
+    return state;
+}
+
+double PendulumSim::getEncoderLeft() const {
+    return state.wheelLeft * countsPerMeter - state.pitch * countsPerRad;
+}
+
+double PendulumSim::getEncoderRight() const {
+    return state.wheelRight * countsPerMeter - state.pitch * countsPerRad;
+}
+
+bool PendulumSim::hasFallen() const {
+    return fabsf(state.pitch) >= 1.2f;
+}
+
+SimRandom::SimRandom(uint64_t seed) : stateBits(seed ? seed : 1), hasSpare(false), spare(0) {}
+
+float SimRandom::uniform() {
+    stateBits ^= stateBits >> 12;
+    stateBits ^= stateBits << 25;
+    stateBits ^= stateBits >> 27;
+    uint64_t bits = stateBits * 2685821657736338717ULL;
+    return (float)(bits >> 40) / 16777216.0f;
+}
+
+float SimRandom::gaussian() {
+    if (hasSpare) {
+        hasSpare = false;
+        return spare;
+    }
+    // Box-Muller transform
+    float u1 = uniform();
+    float u2 = uniform();
+    if (u1 < 1e-7f) {
+        u1 = 1e-7f;
+    }
+    float radius = sqrtf(-2.0f * logf(u1));
+    spare = radius * sinf(TWO_PI * u2);
+    hasSpare = true;
+    return radius * cosf(TWO_PI * u2);
+}
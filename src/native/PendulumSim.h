@@ -0,0 +1,155 @@
+/** @file PendulumSim.h
+ *  @brief Inverted-pendulum-on-wheels model of ConeBot for the native build.
+ */
+
+#ifndef PENDULUM_SIM_H
+#define PENDULUM_SIM_H
+
+#include <stdint.h>
+
+/**
+ *  @brief Physical parameters of the robot, drive train and encoders.
+ */
+struct PendulumParams {
+    float bodyMass;         /**< Mass of everything above the axle in kg. */
+    float bodyInertia;      /**< Body moment of inertia about its center of mass in kg m^2. */
+    float comHeight;        /**< Distance from the axle to the body center of mass in m. */
+    float wheelMass;        /**< Mass of one wheel in kg. */
+    float wheelInertia;     /**< Moment of inertia of one wheel in kg m^2. */
+    float wheelRadius;      /**< Wheel radius in m. */
+    float trackWidth;       /**< Distance between the wheel contact points in m. */
+    float yawInertia;       /**< Moment of inertia about the vertical axis in kg m^2. */
+    float batteryVoltage;   /**< Motor supply voltage in V. */
+    float motorResistance;  /**< Motor winding resistance in ohm. */
+    float motorKt;          /**< Torque constant at the wheel in N m / A. */
+    float motorKe;          /**< Back-EMF constant at the wheel in V s / rad. */
+    float motorFriction;    /**< Viscous friction at the wheel in N m s / rad. */
+    float countsPerRev;     /**< Encoder counts per wheel revolution. */
+    float gravity;          /**< Gravitational acceleration in m/s^2. */
+
+    /**
+     *  @brief Gets parameters approximating the ConeBot hardware.
+     */
+    static PendulumParams defaults();
+};
+
+/**
+ *  @brief Continuous state of the simulated robot.
+ */
+struct PendulumState {
+    float x;          /**< Axle position in m, forward positive. */
+    float xDot;       /**< Axle velocity in m/s. */
+    float pitch;      /**< Body pitch from vertical in rad, leaning forward positive. */
+    float pitchRate;  /**< Body pitch rate in rad/s. */
+    float yaw;        /**< Heading in rad, counterclockwise positive. */
+    float yawRate;    /**< Heading rate in rad/s. */
+    float wheelLeft;  /**< Distance rolled by the left wheel in m. */
+    float wheelRight; /**< Distance rolled by the right wheel in m. */
+};
+
+/**
+ *  @class PendulumSim
+ *  @brief Planar wheeled inverted pendulum driven by two DC motors.
+ *
+ *  The body and the axle follow the cart-pole equations of motion, with wheel
+ *  inertia lumped into the axle mass. Each motor produces torque from its PWM
+ *  duty, the supply voltage and the back-EMF of the wheel relative to the
+ *  body, and the encoders measure that relative wheel rotation. The model is
+ *  integrated with semi-implicit Euler steps, so a given sequence of inputs
+ *  always produces the same trajectory.
+ */
+class PendulumSim {
+public:
+    /**
+     *  @brief Constructor for the PendulumSim class.
+     *  @param params Physical parameters of the robot.
+     */
+    PendulumSim(const PendulumParams &params);
+
+    /**
+     *  @brief Places the robot at rest at the origin with the given pitch.
+     *  @param pitch Initial pitch in rad.
+     */
+    void reset(float pitch);
+
+    /**
+     *  @brief Advances the model.
+     *  @param dt Time step in s.
+     *  @param dutyLeft Left motor duty in -1..1, forward positive.
+     *  @param dutyRight Right motor duty in -1..1, forward positive.
+     */
+    void step(float dt, float dutyLeft, float dutyRight);
+
+    /**
+     *  @brief Gets the current state.
+     */
+    const PendulumState &getState() const;
+
+    /**
+     *  @brief Gets the left encoder count.
+     */
+    double getEncoderLeft() const;
+
+    /**
+     *  @brief Gets the right encoder count.
+     */
+    double getEncoderRight() const;
+
+    /**
+     *  @brief Checks if the body has tipped past the point where it rests on the ground.
+     */
+    bool hasFallen() const;
+
+private:
+    PendulumParams params;
+    PendulumState state;
+
+    // Constant terms of the equations of motion, computed once from params
+    float axleMass;       /**< Body plus wheel masses, with wheel inertia reflected to the axle. */
+    float bodyMoment;     /**< Body mass times center of mass height. */
+    float pitchInertia;   /**< Body inertia about the axle. */
+    float yawInertia;     /**< Total inertia about the vertical axis. */
+    float countsPerMeter; /**< Encoder counts per meter rolled. */
+    float countsPerRad;   /**< Encoder counts per radian of wheel rotation. */
+    float halfTrack;      /**< Half the track width in m. */
+    float inverseRadius;  /**< Reciprocal of the wheel radius in 1/m. */
+    float torquePerDuty;  /**< Stall torque of one motor per unit duty in N m. */
+    float torquePerSpeed; /**< Back-EMF and friction torque of one motor per wheel speed in N m s / rad. */
+    float yawGain;        /**< Yaw acceleration per unit of right minus left wheel torque. */
+
+    /**
+     *  @brief Motor torque at the wheel.
+     *  @param duty PWM duty in -1..1.
+     *  @param wheelSpeed Wheel speed relative to the body in rad/s.
+     */
+    float motorTorque(float duty, float wheelSpeed) const;
+};
+
+/**
+ *  @class SimRandom
+ *  @brief Deterministic pseudo-random source (xorshift64*) for sensor noise.
+ *
+ *  Implemented here rather than with <random> distributions so that a seed
+ *  reproduces the same noise sequence on every host and standard library.
+ */
+class SimRandom {
+public:
+    SimRandom(uint64_t seed = 1);
+
+    /**
+     *  @brief Gets a uniformly distributed value in [0, 1).
+     */
+    float uniform();
+
+    /**
+     *  @brief Gets a normally distributed value with zero mean and unit variance.
+     */
+    float gaussian();
+
+private:
+    uint64_t stateBits;
+    bool hasSpare;
+    float spare;
+};
+
+#endif
@@ -0,0 +1,196 @@
+/** @file SimHAL.cpp
+ *  @brief Implementation of the simulated hardware back ends.
+ */
+
+#include "SimHAL.h"
+
+#include <math.h>
+#include <string.h>
+
+// Per thread, for batch runs in parallel
+static thread_local int64_t simTimeMicros = 0;
+static thread_local float simBatteryVoltage = 0.0f;
+
+int64_t nowMicros() {
+    return simTimeMicros;
+}
+
+void setSimTime(int64_t micros) {
+    simTimeMicros = micros;
+}
+
+float readBatteryVoltage() {
+    return simBatteryVoltage;
+}
+
+void setSimBatteryVoltage(float volts) {
+    simBatteryVoltage = volts;
+}
+
+int64_t sampleEncoders(const MotorInterface &left, const MotorInterface &right, int64_t &leftCount,
+                       int64_t &rightCount) {
+    leftCount = left.getPosition();
+    rightCount = right.getPosition();
+    return simTimeMicros;
+}
+
+void driveMotors(MotorInterface &left, MotorInterface &right, float leftDuty, float rightDuty) {
+    left.setDuty(leftDuty);
+    right.setDuty(rightDuty);
+    left.applyDuty();
+    right.applyDuty();
+}
+
+/** @brief Output stage of the robot, without deadband compensation since the plant has no static friction. */
+static MotorOutputParams simOutputParams() {
+    MotorOutputParams p = MotorOutputParams::defaults();
+    p.deadband = 0.0f;
+    return p;
+}
+
+SimMotor::SimMotor() : output(simOutputParams()), pending(0), duty(0), encoder(0), offset(0) {}
+
+void SimMotor::setDuty(float newDuty) {
+    output.update(newDuty, simTimeMicros);
+    pending = output.getDuty();
+}
+
+void SimMotor::applyDuty() {
+    duty = pending;
+}
+
+void SimMotor::stop() {
+    output.reset();
+    pending = 0;
+    duty = 0;
+}
+
+int64_t SimMotor::getPosition() const {
+    return (int64_t)floor(encoder - offset);
+}
+
+void SimMotor::resetPosition() {
+    offset = encoder;
+}
+
+float SimMotor::getDuty() const {
+    return duty;
+}
+
+void SimMotor::setEncoder(double counts) {
+    encoder = counts;
+}
+
+SimIMU::SimIMU(uint32_t latencySamples, float pitchNoise, float rateNoise, uint64_t seed)
+    : latency(latencySamples > MAX_LATENCY_SAMPLES ? MAX_LATENCY_SAMPLES : latencySamples),
+      pitchNoise(pitchNoise), rateNoise(rateNoise), random(seed), head(0), pitch(0), angularVelocity(0) {
+    for (uint32_t i = 0; i <= MAX_LATENCY_SAMPLES; i++) {
+        pitchHistory[i] = 0;
+        rateHistory[i] = 0;
+    }
+}
+
+bool SimIMU::update() {
+    uint32_t index = (head + MAX_LATENCY_SAMPLES + 1 - latency) % (MAX_LATENCY_SAMPLES + 1);
+    pitch = pitchHistory[index] + pitchNoise * random.gaussian();
+    angularVelocity = rateHistory[index] + rateNoise * random.gaussian();
+    return true;
+}
+
+float SimIMU::getPitch() {
+    return pitch;
+}
+
+float SimIMU::getAngularVelocity() {
+    return angularVelocity;
+}
+
+bool SimIMU::isCalibrated() const {
+    return true;
+}
+
+void SimIMU::setState(float newPitch, float newRate) {
+    head = (head + 1) % (MAX_LATENCY_SAMPLES + 1);
+    pitchHistory[head] = newPitch;
+    rateHistory[head] = newRate;
+}
+
+SimTOF::SimTOF() : fresh(false) {
+    memset(&frame, 0, sizeof(frame));
+}
+
+bool SimTOF::update() {
+    bool wasFresh = fresh;
+    fresh = false;
+    return wasFresh;
+}
+
+const TofFrame &SimTOF::getFrame() const {
+    return frame;
+}
+
+void SimTOF::setDistance(uint16_t distance) {
+    TofFrame newFrame = {};
+    newFrame.timestamp = nowMicros();
+    if (distance > 0) {
+        newFrame.count = 1;
+        newFrame.targets[0].distance = distance;
+        newFrame.targets[0].status = 0;
+        newFrame.targets[0].signalRate = 5.0f;
+        newFrame.targets[0].sigma = 5.0f;
+    }
+    setFrame(newFrame);
+}
+
+void SimTOF::setFrame(const TofFrame &newFrame) {
+    frame = newFrame;
+    fresh = true;
+}
+
+SimGPS::SimGPS() : fresh(false) {
+    memset(&fix, 0, sizeof(fix));
+}
+
+bool SimGPS::update() {
+    bool wasFresh = fresh;
+    fresh = false;
+    return wasFresh;
+}
+
+const GpsFix &SimGPS::getFix() const {
+    return fix;
+}
+
+void SimGPS::setFix(const GpsFix &newFix) {
+    fix = newFix;
+    fresh = true;
+}
+
+SimMQTT::SimMQTT() : up(true), messageCount(0), byteCount(0) {}
+
+void SimMQTT::setConnected(bool up) {
+    this->up = up;
+}
+
+bool SimMQTT::connected() {
+    return up;
+}
+
+bool SimMQTT::publish(const char* topic, const uint8_t* payload, size_t length) {
+    (void)topic;
+    (void)payload;
+    if (!up) {
+        return false;
+    }
+    messageCount++;
+    byteCount += length;
+    return true;
+}
+
+uint32_t SimMQTT::getMessageCount() const {
+    return messageCount;
+}
+
+uint64_t SimMQTT::getByteCount() const {
+    return byteCount;
+}
@@ -0,0 +1,179 @@
+/** @file SimHAL.h
+ *  @brief Simulated back ends for the hardware abstraction interfaces, used by the native build.
+ */
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include "HAL.h"
+#include "MotorOutput.h"
+#include "PendulumSim.h"
+
+/**
+ *  @brief Sets the simulated time returned by nowMicros() in the calling thread.
+ *
+ *  Each thread has its own clock and battery voltage, so batch runs can
+ *  simulate side by side.
+ *
+ *  @param micros Simulated time in microseconds.
+ */
+void setSimTime(int64_t micros);
+
+/**
+ *  @brief Sets the battery voltage returned by readBatteryVoltage() in the calling thread.
+ *  @param volts Simulated battery voltage in V.
+ */
+void setSimBatteryVoltage(float volts);
+
+/**
+ *  @class SimMotor
+ *  @brief Motor that hands its duty to a plant model and reports the plant's encoder count.
+ */
+class SimMotor : public MotorInterface {
+public:
+    SimMotor();
+
+    void setDuty(float duty) override;
+    void applyDuty() override;
+    void stop() override;
+    int64_t getPosition() const override;
+    void resetPosition() override;
+
+    /**
+     *  @brief Gets the applied PWM duty in -1..1, after shaping and quantization.
+     */
+    float getDuty() const;
+
+    /**
+     *  @brief Sets the encoder count produced by the plant model.
+     */
+    void setEncoder(double counts);
+
+private:
+    MotorOutput output;
+    float pending;
+    float duty;
+    double encoder;
+    double offset;
+};
+
+/**
+ *  @class SimIMU
+ *  @brief IMU reporting a delayed, noisy copy of the pitch and pitch rate set by the simulation.
+ */
+class SimIMU : public IMUInterface {
+public:
+    static const uint32_t MAX_LATENCY_SAMPLES = 255; /**< Longest supported sensor delay. */
+
+    /**
+     *  @brief Constructor for the SimIMU class.
+     *  @param latencySamples Delay between setState() and update() seeing a value, in setState() calls.
+     *  @param pitchNoise Standard deviation of the pitch noise in degrees.
+     *  @param rateNoise Standard deviation of the pitch rate noise in degrees per second.
+     *  @param seed Seed of the noise generator.
+     */
+    SimIMU(uint32_t latencySamples = 0, float pitchNoise = 0, float rateNoise = 0, uint64_t seed = 1);
+
+    bool update() override;
+    float getPitch() override;
+    float getAngularVelocity() override;
+    bool isCalibrated() const override;
+
+    /**
+     *  @brief Records the true state at the current simulation step; noise is added when it is read.
+     *  @param pitch Pitch in degrees.
+     *  @param angularVelocity Pitch rate in degrees per second.
+     */
+    void setState(float pitch, float angularVelocity);
+
+private:
+    uint32_t latency;
+    float pitchNoise, rateNoise;
+    SimRandom random;
+    float pitchHistory[MAX_LATENCY_SAMPLES + 1];
+    float rateHistory[MAX_LATENCY_SAMPLES + 1];
+    uint32_t head;
+    float pitch, angularVelocity;
+};
+
+/**
+ *  @class SimTOF
+ *  @brief TOF sensor reporting ranges injected by the simulation.
+ */
+class SimTOF : public TOFInterface {
+public:
+    SimTOF();
+
+    bool update() override;
+    const TofFrame &getFrame() const override;
+
+    /**
+     *  @brief Injects a range with one valid target, or no target if distance is 0.
+     *  @param distance Distance to the target in millimeters.
+     */
+    void setDistance(uint16_t distance);
+
+    /**
+     *  @brief Injects a range, reported by the next update().
+     */
+    void setFrame(const TofFrame &newFrame);
+
+private:
+    TofFrame frame;
+    bool fresh;
+};
+
+/**
+ *  @class SimGPS
+ *  @brief GPS receiver reporting fixes injected by the simulation.
+ */
+class SimGPS : public GPSInterface {
+public:
+    SimGPS();
+
+    bool update() override;
+    const GpsFix &getFix() const override;
+
+    /**
+     *  @brief Injects a new fix, reported by the next update().
+     */
+    void setFix(const GpsFix &newFix);
+
+private:
+    GpsFix fix;
+    bool fresh;
+};
+
+/**
+ *  @class SimMQTT
+ *  @brief Broker link that counts published messages instead of sending them.
+ */
+class SimMQTT : public MQTTInterface {
+public:
+    SimMQTT();
+
+    /**
+     *  @brief Takes the link down or brings it back; publish() fails while it is down.
+     */
+    void setConnected(bool up);
+
+    bool connected() override;
+    bool publish(const char* topic, const uint8_t* payload, size_t length) override;
+
+    /**
+     *  @brief Gets the number of messages published.
+     */
+    uint32_t getMessageCount() const;
+
+    /**
+     *  @brief Gets the total payload bytes published.
+     */
+    uint64_t getByteCount() const;
+
+private:
+    bool up;
+    uint32_t messageCount;
+    uint64_t byteCount;
+};
+
+#endif
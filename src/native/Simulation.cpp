@@ -0,0 +1,239 @@
+/** @file Simulation.cpp
+ *  @brief Implementation of the closed-loop ConeBot simulation.
+ */
+
+#include "Simulation.h"
+
+#include <chrono>
+#include <math.h>
+
+#include "SimHAL.h"
+
+static const float RAD_TO_DEG = 57.2957795f;
+
+/** @brief Ranging period of the TOF sensor, set by its 50 ms timing budget. */
+static const int64_t TOF_PERIOD_US = 50000;
+
+/** @brief Time of the position setpoint command, SimConfig::positionSetpoint. */
+static const int64_t SETPOINT_COMMAND_TIME = 5000000;
+
+typedef std::chrono::steady_clock WallClock;
+
+static double secondsSince(WallClock::time_point start) {
+    return std::chrono::duration<double>(WallClock::now() - start).count();
+}
+
+static WallClock::time_point startStep(const SimConfig &config) {
+    return config.profile ? WallClock::now() : WallClock::time_point();
+}
+
+static void endStep(const SimConfig &config, WallClock::time_point start, StepProfile &profile) {
+    if (config.profile) {
+        profile.seconds += secondsSince(start);
+    }
+    profile.calls++;
+}
+
+SimConfig SimConfig::defaults() {
+    SimConfig config;
+    config.params = PendulumParams::defaults();
+    config.seconds = 60.0;
+    config.initialPitch = 0.0f;
+    config.initialState = CORRECTING_TILT;
+    config.gains = DEFAULT_BALANCE_GAINS;
+    config.physicsStepMicros = 1000;
+    config.imuPeriodMicros = IMU_PERIOD_MS * 1000;
+    config.imuLatencyMicros = 10000;
+    config.pitchNoise = 0.1f;
+    config.rateNoise = 0.5f;
+    config.obstacleDistance = 0;
+    config.outageStart = 10.0;
+    config.outageSeconds = 0.0;
+    config.positionSetpoint = 0.0f;
+    config.seed = 1;
+    config.stopWhenFallen = true;
+    config.telemetry = true;
+    config.profile = true;
+    config.trace = NULL;
+    config.log = NULL;
+    return config;
+}
+
+SimResult runSimulation(const SimConfig &config) {
+    SimResult result = {};
+    const int64_t dt = config.physicsStepMicros;
+    const int64_t endMicros = (int64_t)(config.seconds * 1e6);
+    const int64_t imuPeriod = config.imuPeriodMicros;
+    const int64_t wheelPeriod = WHEEL_PERIOD_US;
+    const int64_t controlPeriod = CONTROL_PERIOD_US;
+    const int64_t telemetryPeriod = TELEMETRY_PERIOD_MS * 1000;
+    const int64_t recordPeriod = RECORD_PERIOD_MS * 1000;
+
+    PendulumSim plant(config.params);
+    plant.reset(config.initialPitch / RAD_TO_DEG);
+
+    SimMotor motorLeft, motorRight;
+    SimIMU imu((uint32_t)(config.imuLatencyMicros / dt), config.pitchNoise, config.rateNoise, config.seed);
+    SimTOF tof;
+    SimGPS gps;
+    SimMQTT mqtt;
+    StoreAndForward traceOutbox(mqtt);
+    const int64_t outageStart = (int64_t)(config.outageStart * 1e6);
+    const int64_t outageEnd = outageStart + (int64_t)(config.outageSeconds * 1e6);
+    ObstacleModel obstacles;
+    Odometry odometry;
+    WheelSpeedController leftLoop, rightLoop;
+    WheelSetpoint setpoint = {};
+    setSimBatteryVoltage(config.params.batteryVoltage);
+
+    SensorBus bus;
+    SampleRing<ControlSample, 1024>::Reader traceReader = bus.control.reader();
+    TelemetryBatcher traceBatcher;
+    RecordCursors recordCursors = startRecording(bus);
+    FlightLogBlock logBlock;
+    logBlock.begin((uint32_t)config.seed, 0);
+    Measurement measurement = {};
+    bool obstacleDetected = false;
+    ConeBotFsm fsm(config.initialState);
+    LatencyMonitor latency(1);
+    BalanceGains gains = config.gains;
+    ConeBotController controller;
+    controller.configure(gains, CONTROL_PERIOD_US * 1e-6f);
+    bool setpointCommanded = config.positionSetpoint == 0.0f;
+
+    if (config.trace) {
+        fprintf(config.trace, "time,pitch,pitch_rate,position,measured_pitch,duty_left,duty_right,state\n");
+    }
+
+    double pitchSquares = 0;
+    uint64_t samples = 0;
+    int64_t nextGps = 0, nextTof = 0, nextImu = 0, nextWheel = 0, nextControl = 0, nextTelemetry = 0, nextRecord = 0;
+    // The clock starts one step after boot, so no sample carries the time 0 that means "none yet"
+    int64_t t = dt;
+    WallClock::time_point start = WallClock::now();
+    for (; t < endMicros; t += dt) {
+        setSimTime(t);
+
+        // Sample the plant into the simulated sensors
+        const PendulumState &truth = plant.getState();
+        imu.setState(truth.pitch * RAD_TO_DEG, truth.pitchRate * RAD_TO_DEG);
+        motorLeft.setEncoder(plant.getEncoderLeft());
+        motorRight.setEncoder(plant.getEncoderRight());
+        if (t >= nextGps) {
+            nextGps += 1000000;
+            GpsFix fix = {};
+            fix.utcMillis = (uint32_t)(t / 1000);
+            fix.latitude = (int32_t)(truth.x / 0.0111f);   // 1e-7 degrees of latitude is about 1.11 cm
+            fix.fixQuality = 1;
+            fix.valid = true;
+            gps.setFix(fix);
+        }
+        if (t >= nextTof) {
+            nextTof += TOF_PERIOD_US;
+            float distance = config.obstacleDistance - truth.x * 1000.0f;
+            tof.setDistance(config.obstacleDistance == 0 ? 0 : (uint16_t)(distance < 1.0f ? 1.0f : distance));
+        }
+
+        float absPitch = fabsf(truth.pitch * RAD_TO_DEG);
+        if (absPitch > result.maxAbsPitch) {
+            result.maxAbsPitch = absPitch;
+        }
+        pitchSquares += (double)absPitch * absPitch;
+        samples++;
+
+        if (!result.fell && plant.hasFallen()) {
+            result.fell = true;
+            result.timeToFall = t * 1e-6;
+            if (config.stopWhenFallen) {
+                break;
+            }
+        }
+
+        // Firmware steps at their task periods
+        if (t >= nextImu) {
+            nextImu += imuPeriod;
+            WallClock::time_point stepStart = startStep(config);
+            imuStep(imu, bus);
+            endStep(config, stepStart, result.sensors);
+        }
+        if (tof.update()) {
+            WallClock::time_point stepStart = startStep(config);
+            obstacleStep(tof.getFrame(), obstacles, bus);
+            endStep(config, stepStart, result.sensors);
+        }
+        if (gps.update()) {
+            WallClock::time_point stepStart = startStep(config);
+            gpsStep(gps.getFix(), bus);
+            endStep(config, stepStart, result.sensors);
+        }
+        if (t >= nextWheel) {
+            nextWheel += wheelPeriod;
+            WallClock::time_point stepStart = startStep(config);
+            encoderStep(motorLeft, motorRight, odometry, bus);
+            wheelStep(setpoint, odometry.getState(), readBatteryVoltage(), leftLoop, rightLoop, motorLeft,
+                      motorRight);
+            endStep(config, stepStart, result.wheels);
+        }
+        if (t >= nextControl) {
+            nextControl += controlPeriod;
+            WallClock::time_point stepStart = startStep(config);
+            if (!setpointCommanded && t >= SETPOINT_COMMAND_TIME) {
+                // As the MQTT task would hand it over, applied and logged as motorControlCycle() does
+                Command command = {};
+                command.type = COMMAND_SET_POSITION;
+                command.values[0] = config.positionSetpoint;
+                command.receivedAt = t;
+                commandStep(fsm, command, controller, gains);
+                CommandSample applied = {nowMicros(), command};
+                bus.commands.push(applied);
+                setpointCommanded = true;
+            }
+            readMeasurement(bus, measurement, obstacleDetected);
+            ConeBotState state = motorControlStep(fsm, measurement, obstacleDetected, t, controller, setpoint);
+            controlStep(state, measurement, setpoint, t, bus);
+            if (measurement.imuTimestamp != 0) {
+                latency.record(measurement.imuTimestamp, t);
+            }
+            endStep(config, stepStart, result.control);
+
+            if (config.trace) {
+                fprintf(config.trace, "%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%d\n", t * 1e-6,
+                        truth.pitch * RAD_TO_DEG, truth.pitchRate * RAD_TO_DEG, truth.x, measurement.angle,
+                        motorLeft.getDuty(), motorRight.getDuty(), (int)state);
+            }
+        }
+        if (config.telemetry && t >= nextTelemetry) {
+            nextTelemetry += telemetryPeriod;
+            WallClock::time_point stepStart = startStep(config);
+            mqtt.setConnected(t < outageStart || t >= outageEnd);
+            telemetryStep(readBotState(bus), mqtt);
+            telemetryBatchStep(bus, traceReader, traceBatcher, traceOutbox);
+            traceOutbox.flush(TELEMETRY_REPLAY_PER_PERIOD);
+            endStep(config, stepStart, result.telemetry);
+        }
+        if (config.log && t >= nextRecord) {
+            nextRecord += recordPeriod;
+            result.logBlocks += recordStep(bus, recordCursors, logBlock, *config.log);
+        }
+
+        plant.step(dt * 1e-6f, motorLeft.getDuty(), motorRight.getDuty());
+    }
+    if (config.log) {
+        result.logBlocks += recordStep(bus, recordCursors, logBlock, *config.log);
+        if (!logBlock.isEmpty()) {
+            config.log->writeBlock(logBlock.finish());
+            result.logBlocks++;
+        }
+    }
+    result.wallSeconds = secondsSince(start);
+    result.simulatedSeconds = t * 1e-6;
+    result.pitchRms = samples ? (float)sqrt(pitchSquares / samples) : 0.0f;
+    result.finalPosition = plant.getState().x;
+    result.finalState = fsm.getState();
+    result.fsm = fsm.getStats();
+    result.latency = latency.getStats();
+    result.telemetryMessages = mqtt.getMessageCount();
+    result.telemetryBytes = mqtt.getByteCount();
+    result.outbox = traceOutbox.getStats();
+    return result;
+}
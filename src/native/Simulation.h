@@ -0,0 +1,94 @@
+/** @file Simulation.h
+ *  @brief Closed-loop simulation of the ConeBot firmware pipelines against the pendulum model.
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ConeBot.h"
+#include "LatencyMonitor.h"
+#include "PendulumSim.h"
+#include "StoreAndForward.h"
+
+/**
+ *  @brief Settings of one simulated run.
+ */
+struct SimConfig {
+    PendulumParams params;        /**< Physical parameters of the robot. */
+    double seconds;               /**< Simulated duration in s. */
+    float initialPitch;           /**< Initial pitch in degrees. */
+    ConeBotState initialState;    /**< FSM state at the start of the run. */
+    BalanceGains gains;           /**< Gains of the balance controller. */
+    int64_t physicsStepMicros;    /**< Integration step of the plant model. */
+    int64_t imuPeriodMicros;      /**< Period of imuStep(), IMU_PERIOD_MS by default. */
+    int64_t imuLatencyMicros;     /**< Delay of the IMU output behind the true state. */
+    float pitchNoise;             /**< IMU pitch noise in degrees (1 sigma). */
+    float rateNoise;              /**< IMU pitch rate noise in degrees per second (1 sigma). */
+    uint16_t obstacleDistance;    /**< Distance from the start to a wall ahead in mm, seen by the TOF sensor, 0 for none. */
+    double outageStart;           /**< Time the broker link goes down in s. */
+    double outageSeconds;         /**< Length of the broker link outage in s, 0 for none. */
+    float positionSetpoint;       /**< Position setpoint in m commanded 5 s into the run, 0 for none. */
+    uint64_t seed;                /**< Seed of the sensor noise. */
+    bool stopWhenFallen;          /**< End the run as soon as the robot falls over. */
+    bool telemetry;               /**< Publish telemetry and the control trace to the simulated broker. */
+    bool profile;                 /**< Time each firmware step with the wall clock, for SimResult's StepProfile. */
+    FILE *trace;                  /**< If set, a CSV row is written here every control cycle. */
+    FlightLogSink *log;           /**< If set, the sensor bus is recorded here every RECORD_PERIOD_MS, in session seed. */
+
+    /**
+     *  @brief Gets the default settings: one minute from upright in CORRECTING_TILT.
+     */
+    static SimConfig defaults();
+};
+
+/**
+ *  @brief Accumulated wall time of one pipeline step.
+ */
+struct StepProfile {
+    uint64_t calls;   /**< Number of times the step ran. */
+    double seconds;   /**< Total wall time spent in the step. */
+};
+
+/**
+ *  @brief Outcome of one simulated run.
+ */
+struct SimResult {
+    double simulatedSeconds;   /**< Simulated time actually covered. */
+    double wallSeconds;        /**< Wall time taken by the run. */
+    bool fell;                 /**< True if the robot fell over. */
+    double timeToFall;         /**< Simulated time at which it fell, if it did. */
+    float maxAbsPitch;         /**< Largest absolute pitch seen, in degrees. */
+    float pitchRms;            /**< RMS pitch over the run, in degrees. */
+    float finalPosition;       /**< Axle position at the end of the run, in m. */
+    ConeBotState finalState;   /**< FSM state at the end of the run. */
+    FsmStats fsm;              /**< Time in each FSM state and transitions between them. */
+    StepProfile sensors;       /**< Time spent in imuStep(), obstacleStep() and gpsStep(). */
+    StepProfile wheels;        /**< Time spent in encoderStep() and wheelStep(). */
+    StepProfile control;       /**< Time spent in motorControlStep(). */
+    StepProfile telemetry;     /**< Time spent in telemetryStep() and telemetryBatchStep(). */
+    uint32_t telemetryMessages; /**< MQTT messages published. */
+    uint64_t telemetryBytes;   /**< MQTT payload bytes published. */
+    StoreAndForwardStats outbox; /**< Control trace messages buffered during the outage. */
+    uint32_t logBlocks;        /**< Flight log blocks written to SimConfig::log, the last one partly filled. */
+    LatencyStats latency;      /**< Simulated age of the IMU sample behind each motor command. */
+};
+
+/**
+ *  @brief Runs the firmware steps in closed loop with the pendulum model.
+ *
+ *  The sensor producer, control and telemetry steps are called at the periods
+ *  defined in ConeBot.h (the IMU period can be overridden), exactly as the FreeRTOS tasks call them on the robot,
+ *  and exchange data through a SensorBus as they do there,
+ *  while the plant is integrated at physicsStepMicros with the motor duties held
+ *  between control cycles. The run depends only on the configuration, so the
+ *  same configuration always gives the same result.
+ *
+ *  @param config Settings of the run.
+ *  @return Outcome of the run.
+ */
+SimResult runSimulation(const SimConfig &config);
+
+#endif
@@ -0,0 +1,441 @@
+/**
+ * @file main.cpp
+ * @brief Native entry point that runs the ConeBot firmware steps against the simulated robot.
+ *
+ * Commands:
+ * - sim: one closed-loop run, optionally writing a CSV trace.
+ * - batch: many runs over a spread of initial pitch angles and noise seeds,
+ *   for parameter sweeps.
+ * - bench: time per step of the balance controller in float and fixed point, and
+ *   per update of each attitude filter, and the NMEA parser's throughput over a
+ *   receiver capture (--input).
+ * - estimate: runs every attitude filter over a raw IMU recording (--input) and
+ *   compares it with the recording's reference pitch.
+ * - decode: checks a flight log (--input) and summarizes it, optionally
+ *   converting it to one CSV file per record type (--output).
+ * - replay: feeds each session of a flight log (--input) through the motor
+ *   control cycle and checks its state and wheel setpoints against the log bit
+ *   for bit, optionally writing both to a CSV trace (--trace).
+ *
+ * Options:
+ *   --seconds S     simulated duration of each run (default 60)
+ *   --pitch DEG     initial pitch for sim, largest initial pitch for batch (default 2)
+ *   --state N       initial FSM state as a ConeBotState value (default CORRECTING_TILT)
+ *   --seed N        noise seed for sim, first seed for batch (default 1)
+ *   --latency US    IMU latency in microseconds (default 10000)
+ *   --imu-period US IMU step period in microseconds (default IMU_PERIOD_MS)
+ *   --noise DEG     IMU pitch noise in degrees (default 0.1)
+ *   --obstacle MM   distance to a wall ahead of the start in millimeters, 0 for none (default 0)
+ *   --outage S      seconds the broker link is down, from 10 s into the run (default 0)
+ *   --runs N        number of batch runs (default 1000), or millions of bench steps (default 10)
+ *   --jobs N        batch runs simulated in parallel (default: one per hardware thread)
+ *   --trace FILE    CSV trace of every control cycle (sim, replay), or of every estimate (estimate)
+ *   --input FILE    raw IMU recording: time, gyro x y z (deg/s), accel x y z (m/s^2)[, reference pitch],
+ *                   flight log (decode, replay), or raw NMEA capture (bench)
+ *   --filter N      attitude filter traced by estimate as an AttitudeFilter value (default ATTITUDE_MAHONY)
+ *   --record FILE   flight log of the sensor bus (sim)
+ *   --setpoint M    position setpoint commanded 5 s into the run, logged as a command (sim, default 0)
+ *   --output PREFIX path prefix of the CSV files written by decode
+ *
+ * Usage: program [sim|batch|bench|estimate|decode|replay] [options]
+ */
+
+// The unit tests link the native sources with their own main()
+#ifndef PIO_UNIT_TESTING
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "AttitudeReplay.h"
+#include "Benchmark.h"
+#include "FlightLogFile.h"
+#include "LogReplay.h"
+#include "Simulation.h"
+
+static void printProfile(const char *name, const StepProfile &profile) {
+    printf("  %-12s %10llu calls %10.1f ns/call\n", name, (unsigned long long)profile.calls,
+           profile.calls ? profile.seconds * 1e9 / profile.calls : 0.0);
+}
+
+static int runSingle(SimConfig config, const char *tracePath, const char *recordPath) {
+    if (tracePath) {
+        config.trace = fopen(tracePath, "w");
+        if (!config.trace) {
+            fprintf(stderr, "Cannot open %s\n", tracePath);
+            return 1;
+        }
+    }
+    FILE *record = NULL;
+    if (recordPath) {
+        record = fopen(recordPath, "wb");
+        if (!record) {
+            fprintf(stderr, "Cannot open %s\n", recordPath);
+            return 1;
+        }
+    }
+    FlightLogFile log(record);
+    config.log = record ? &log : NULL;
+    SimResult result = runSimulation(config);
+    if (config.trace) {
+        fclose(config.trace);
+    }
+    if (record) {
+        fclose(record);
+    }
+
+    printf("Simulated %.2f s in %.4f s wall time (%.0fx real time)\n", result.simulatedSeconds, result.wallSeconds,
+           result.wallSeconds > 0 ? result.simulatedSeconds / result.wallSeconds : 0.0);
+    if (result.fell) {
+        printf("  fell over after %.3f s\n", result.timeToFall);
+    } else {
+        printf("  stayed up\n");
+    }
+    printf("  max |pitch| %.2f deg, rms pitch %.2f deg, final position %.3f m, final state %d\n",
+           result.maxAbsPitch, result.pitchRms, result.finalPosition, (int)result.finalState);
+    printf("  time in state:");
+    for (int state = 0; state < CONEBOT_STATE_COUNT; state++) {
+        if (result.fsm.dwellMicros[state] > 0) {
+            printf(" %s %.2f s", getStateName(state), result.fsm.dwellMicros[state] * 1e-6);
+        }
+    }
+    printf("\n");
+    for (int from = 0; from < CONEBOT_STATE_COUNT; from++) {
+        for (int to = 0; to < CONEBOT_STATE_COUNT; to++) {
+            if (result.fsm.transitions[from][to] > 0) {
+                printf("  %u transitions %s -> %s\n", (unsigned)result.fsm.transitions[from][to],
+                       getStateName(from), getStateName(to));
+            }
+        }
+    }
+    printProfile("sensors", result.sensors);
+    printProfile("wheels", result.wheels);
+    printProfile("control", result.control);
+    printProfile("telemetry", result.telemetry);
+    printf("  published %u telemetry messages, %llu bytes\n", (unsigned)result.telemetryMessages,
+           (unsigned long long)result.telemetryBytes);
+    if (result.outbox.stored > 0) {
+        printf("  trace outbox: %u messages buffered, %u replayed, %u dropped, %u still pending\n",
+               (unsigned)result.outbox.stored, (unsigned)result.outbox.replayed, (unsigned)result.outbox.dropped,
+               (unsigned)result.outbox.pending);
+    }
+    printf("  IMU sample age at actuation %u..%u us (mean %u)\n", (unsigned)result.latency.minLatency,
+           (unsigned)result.latency.maxLatency, (unsigned)result.latency.meanLatency);
+    if (record) {
+        printf("  recorded %u flight log blocks, %u bytes, to %s\n", (unsigned)result.logBlocks,
+               (unsigned)(result.logBlocks * FLIGHT_LOG_BLOCK_SIZE), recordPath);
+    }
+    return 0;
+}
+
+/** @brief Runs of one batch, shared by its worker threads. */
+struct BatchWork {
+    SimConfig config;                   /**< Settings every run starts from. */
+    std::vector<SimResult> results;     /**< Outcome of each run, by run index. */
+    std::atomic<int> next;              /**< Index of the next run to simulate. */
+};
+
+static void batchWorker(BatchWork *work) {
+    const int runs = (int)work->results.size();
+    const float maxPitch = work->config.initialPitch;
+    for (int i; (i = work->next.fetch_add(1)) < runs;) {
+        SimConfig config = work->config;
+        config.initialPitch = runs > 1 ? -maxPitch + 2.0f * maxPitch * i / (runs - 1) : maxPitch;
+        config.seed = work->config.seed + (uint64_t)i;
+        work->results[i] = runSimulation(config);
+    }
+}
+
+static int runBatch(SimConfig config, int runs, int jobs) {
+    double simulated = 0, fallTime = 0, rms = 0;
+    int falls = 0;
+    float maxPitch = config.initialPitch;
+    // Sweeps only look at the dynamics, so leave out the MQTT path and the step timing
+    config.telemetry = false;
+    config.profile = false;
+
+    // Runs are independent, so they are spread over threads; each result depends only on its run index
+    BatchWork work;
+    work.config = config;
+    work.results.resize(runs);
+    work.next = 0;
+    std::vector<std::thread> workers;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int j = 1; j < jobs; j++) {
+        workers.emplace_back(batchWorker, &work);
+    }
+    batchWorker(&work);
+    for (size_t j = 0; j < workers.size(); j++) {
+        workers[j].join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i < runs; i++) {
+        const SimResult &result = work.results[i];
+        simulated += result.simulatedSeconds;
+        rms += result.pitchRms;
+        if (result.fell) {
+            falls++;
+            fallTime += result.timeToFall;
+        }
+    }
+
+    printf("%d runs, initial pitch -%.1f..%.1f deg: simulated %.1f s in %.3f s wall time on %d threads "
+           "(%.0fx real time)\n",
+           runs, maxPitch, maxPitch, simulated, wall, jobs, wall > 0 ? simulated / wall : 0.0);
+    printf("  %d fell (mean time to fall %.3f s), mean rms pitch %.2f deg\n", falls,
+           falls ? fallTime / falls : 0.0, runs ? rms / runs : 0.0);
+    return 0;
+}
+
+static const char *const filterNames[] = {"complementary", "mahony", "madgwick"};
+
+/** @brief Time from the start of a recording before the estimate is compared with the reference. */
+static const double ESTIMATE_SETTLE_SECONDS = 1.0;
+
+/** @brief Characters of NMEA fed per bench run, repeating the capture as needed. */
+static const uint64_t NMEA_BENCH_BYTES = 64000000;
+
+static int runBench(uint64_t calls, const char *inputPath) {
+    static const char *const modeNames[] = {"cascaded", "lqr"};
+    printf("Balance controller step, %llu calls each (period %u us at %u Hz):\n", (unsigned long long)calls,
+           (unsigned)CONTROL_PERIOD_US, (unsigned)CONTROL_RATE_HZ);
+    for (int mode = BALANCE_CASCADED; mode <= BALANCE_LQR; mode++) {
+        for (int fixedPoint = 0; fixedPoint <= 1; fixedPoint++) {
+            BenchResult result = benchmarkController((BalanceMode)mode, fixedPoint != 0, calls);
+            printf("  %-8s %-5s %8.1f ns/step %8.4f%% of the period\n", modeNames[mode], fixedPoint ? "Q16" : "float",
+                   result.nanosPerCall, result.nanosPerCall * 100.0 / (CONTROL_PERIOD_US * 1000.0));
+        }
+    }
+    printf("Attitude estimator update, %llu calls each:\n", (unsigned long long)calls);
+    for (int filter = ATTITUDE_COMPLEMENTARY; filter <= ATTITUDE_MADGWICK; filter++) {
+        BenchResult result = benchmarkEstimator((AttitudeFilter)filter, calls);
+        printf("  %-13s %8.1f ns/update\n", filterNames[filter], result.nanosPerCall);
+    }
+    if (!inputPath) {
+        return 0;
+    }
+
+    FILE *file = fopen(inputPath, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", inputPath);
+        return 1;
+    }
+    std::vector<char> capture;
+    char chunk[4096];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        capture.insert(capture.end(), chunk, chunk + length);
+    }
+    fclose(file);
+    if (capture.empty()) {
+        fprintf(stderr, "%s is empty\n", inputPath);
+        return 1;
+    }
+    uint32_t passes = (uint32_t)(NMEA_BENCH_BYTES / capture.size() + 1);
+    NmeaBenchResult result = benchmarkNmea(capture, passes);
+    printf("NMEA parser, %s fed %u times (%zu bytes, %llu sentences, %u bad checksums, %u overflows each):\n",
+           inputPath, (unsigned)passes, capture.size(), (unsigned long long)(result.sentences / passes),
+           (unsigned)result.checksumErrors, (unsigned)result.overflows);
+    printf("  %.0f sentences/s, %.1f MB/s, %.1f ns/byte\n", result.seconds > 0 ? result.sentences / result.seconds : 0.0,
+           result.seconds > 0 ? result.bytes / result.seconds * 1e-6 : 0.0,
+           result.bytes ? result.seconds * 1e9 / result.bytes : 0.0);
+    return 0;
+}
+
+static int runEstimate(const char *inputPath, AttitudeFilter tracedFilter, const char *tracePath) {
+    std::vector<AttitudeRecord> records;
+    if (!inputPath || !loadAttitudeRecording(inputPath, records)) {
+        fprintf(stderr, "Cannot read a recording from %s\n", inputPath ? inputPath : "(no --input)");
+        return 1;
+    }
+    printf("%zu samples over %.2f s, errors against the reference after %.1f s:\n", records.size(),
+           records.back().time - records.front().time, ESTIMATE_SETTLE_SECONDS);
+    for (int filter = ATTITUDE_COMPLEMENTARY; filter <= ATTITUDE_MADGWICK; filter++) {
+        AttitudeParams params = AttitudeParams::defaults();
+        params.filter = (AttitudeFilter)filter;
+        FILE *trace = NULL;
+        if (tracePath && filter == tracedFilter) {
+            trace = fopen(tracePath, "w");
+            if (!trace) {
+                fprintf(stderr, "Cannot open %s\n", tracePath);
+                return 1;
+            }
+        }
+        AttitudeReport report = replayAttitude(records, params, ESTIMATE_SETTLE_SECONDS, trace);
+        if (trace) {
+            fclose(trace);
+        }
+        if (report.compared == 0) {
+            printf("  %-13s no reference pitch to compare with\n", filterNames[filter]);
+        } else {
+            printf("  %-13s mean %+.3f deg, rms %.3f deg, max %.3f deg\n", filterNames[filter], report.meanError,
+                   report.rmsError, report.maxError);
+        }
+    }
+    return 0;
+}
+
+static int runDecode(const char *inputPath, const char *outputPrefix) {
+    static const char *const typeNames[RECORD_TYPE_COUNT] = {
+        NULL, "imu", "encoder", "tof", "gps", "command", "control", "transition",
+    };
+    std::vector<FlightRecord> records;
+    FlightLogReport report;
+    if (!inputPath || !loadFlightLog(inputPath, records, report)) {
+        fprintf(stderr, "Cannot read a flight log from %s\n", inputPath ? inputPath : "(no --input)");
+        return 1;
+    }
+    printf("%u blocks in %u sessions, %u damaged, %u missing\n", (unsigned)report.blocks,
+           (unsigned)report.sessions, (unsigned)report.badBlocks, (unsigned)report.missingBlocks);
+    for (int type = RECORD_IMU; type < RECORD_TYPE_COUNT; type++) {
+        printf("  %-10s %10llu records\n", typeNames[type], (unsigned long long)report.records[type]);
+    }
+    if (outputPrefix && !writeFlightLogCsv(records, outputPrefix)) {
+        return 1;
+    }
+    return 0;
+}
+
+static int runReplay(const char *inputPath, const char *tracePath) {
+    std::vector<FlightRecord> records;
+    std::vector<FlightLogSession> sessions;
+    FlightLogReport report;
+    if (!inputPath || !loadFlightLog(inputPath, records, report, &sessions)) {
+        fprintf(stderr, "Cannot read a flight log from %s\n", inputPath ? inputPath : "(no --input)");
+        return 1;
+    }
+    FILE *trace = NULL;
+    if (tracePath) {
+        trace = fopen(tracePath, "w");
+        if (!trace) {
+            fprintf(stderr, "Cannot open %s\n", tracePath);
+            return 1;
+        }
+    }
+    if (report.badBlocks > 0 || report.missingBlocks > 0) {
+        printf("%u damaged and %u missing blocks, expect mismatches after them\n", (unsigned)report.badBlocks,
+               (unsigned)report.missingBlocks);
+    }
+    uint64_t mismatches = 0;
+    for (size_t i = 0; i < sessions.size(); i++) {
+        size_t last = i + 1 < sessions.size() ? sessions[i + 1].firstRecord : records.size();
+        auto start = std::chrono::steady_clock::now();
+        ReplayReport replay = replayFlightLog(records, sessions[i].firstRecord, last, DEFAULT_BALANCE_GAINS, trace);
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Session %08x: %llu cycles replayed in %.3f s wall time\n", (unsigned)sessions[i].session,
+               (unsigned long long)replay.cycles, wall);
+        if (sessions[i].firstSequence != 0) {
+            printf("  log starts at block %u, not at boot, expect mismatches until the controller settles\n",
+                   (unsigned)sessions[i].firstSequence);
+        }
+        if (replay.mismatches == 0) {
+            printf("  every state and wheel setpoint matches the log bit for bit\n");
+        } else {
+            printf("  %llu cycles differ, the first at %lld us, max setpoint error %.9g m/s\n",
+                   (unsigned long long)replay.mismatches, (long long)replay.firstMismatch, replay.maxSetpointError);
+        }
+        if (replay.inputMismatches > 0) {
+            printf("  %llu cycles read a sample missing from the log\n", (unsigned long long)replay.inputMismatches);
+        }
+        mismatches += replay.mismatches;
+    }
+    if (trace) {
+        fclose(trace);
+    }
+    return mismatches == 0 ? 0 : 2;
+}
+
+int main(int argc, char **argv) {
+    SimConfig config = SimConfig::defaults();
+    config.initialPitch = 2.0f;
+    const char *command = "sim";
+    const char *tracePath = NULL;
+    const char *inputPath = NULL;
+    const char *recordPath = NULL;
+    const char *outputPrefix = NULL;
+    AttitudeFilter filter = ATTITUDE_MAHONY;
+    int runs = 0;
+    int jobs = 0;
+
+    int i = 1;
+    if (i < argc && argv[i][0] != '-') {
+        command = argv[i++];
+    }
+    for (; i < argc; i++) {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", option);
+            return 1;
+        }
+        i++;
+        if (strcmp(option, "--seconds") == 0) {
+            config.seconds = atof(value);
+        } else if (strcmp(option, "--pitch") == 0) {
+            config.initialPitch = (float)atof(value);
+        } else if (strcmp(option, "--state") == 0) {
+            config.initialState = (ConeBotState)atoi(value);
+        } else if (strcmp(option, "--seed") == 0) {
+            config.seed = strtoull(value, NULL, 10);
+        } else if (strcmp(option, "--latency") == 0) {
+            config.imuLatencyMicros = atoll(value);
+        } else if (strcmp(option, "--imu-period") == 0) {
+            config.imuPeriodMicros = atoll(value);
+        } else if (strcmp(option, "--noise") == 0) {
+            config.pitchNoise = (float)atof(value);
+        } else if (strcmp(option, "--obstacle") == 0) {
+            config.obstacleDistance = (uint16_t)atoi(value);
+        } else if (strcmp(option, "--outage") == 0) {
+            config.outageSeconds = atof(value);
+        } else if (strcmp(option, "--runs") == 0) {
+            runs = atoi(value);
+        } else if (strcmp(option, "--jobs") == 0) {
+            jobs = atoi(value);
+        } else if (strcmp(option, "--trace") == 0) {
+            tracePath = value;
+        } else if (strcmp(option, "--input") == 0) {
+            inputPath = value;
+        } else if (strcmp(option, "--filter") == 0) {
+            filter = (AttitudeFilter)atoi(value);
+        } else if (strcmp(option, "--record") == 0) {
+            recordPath = value;
+        } else if (strcmp(option, "--setpoint") == 0) {
+            config.positionSetpoint = (float)atof(value);
+        } else if (strcmp(option, "--output") == 0) {
+            outputPrefix = value;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", option);
+            return 1;
+        }
+    }
+
+    if (strcmp(command, "sim") == 0) {
+        return runSingle(config, tracePath, recordPath);
+    }
+    if (strcmp(command, "batch") == 0) {
+        if (jobs <= 0) {
+            jobs = std::thread::hardware_concurrency() > 0 ? (int)std::thread::hardware_concurrency() : 1;
+        }
+        return runBatch(config, runs > 0 ? runs : 1000, jobs);
+    }
+    if (strcmp(command, "bench") == 0) {
+        return runBench(runs > 0 ? (uint64_t)runs * 1000000 : 10000000, inputPath);
+    }
+    if (strcmp(command, "estimate") == 0) {
+        return runEstimate(inputPath, filter, tracePath);
+    }
+    if (strcmp(command, "decode") == 0) {
+        return runDecode(inputPath, outputPrefix);
+    }
+    if (strcmp(command, "replay") == 0) {
+        return runReplay(inputPath, tracePath);
+    }
+    fprintf(stderr, "Unknown command %s\n", command);
+    return 1;
+}
+#endif
@@ -0,0 +1,169 @@
+/** @file test_nmea.cpp
+ *  @brief Native tests of NMEAParser: checksum rejection, buffer overflow, truncated sentences, long numeric fields and GGA, RMC and VTG field extraction.
+ *
+ *  Run with: pio test -e native -f test_nmea
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "NMEAParser.h"
+
+static const char *const GGA = "$GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*69\r\n";
+static const char *const RMC = "$GNRMC,123520.00,A,4807.038,S,01131.000,W,022.4,084.4,230394,003.1,W*5F\r\n";
+static const char *const VTG = "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n";
+static const char *const VTG_KNOTS_ONLY = "$GPVTG,054.7,T,034.4,M,005.5,N,,K*65\r\n";
+static const char *const GSA = "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n";
+
+static NMEAParser parser;
+
+static size_t feed(const char *text) {
+    return parser.encode(text, strlen(text));
+}
+
+/** Feed "$<body>*<checksum>\r\n" with a correct checksum. */
+static size_t feedBody(const char *body) {
+    uint8_t checksum = 0;
+    for (const char *c = body; *c != '\0'; c++) {
+        checksum ^= (uint8_t)*c;
+    }
+    char line[NMEAParser::MAX_SENTENCE + 8];
+    snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+    return feed(line);
+}
+
+void setUp() {
+    parser.reset();
+}
+
+void tearDown() {}
+
+static void test_gga_fields() {
+    TEST_ASSERT_EQUAL(1, feed(GGA));
+    const GpsFix &fix = parser.getFix();
+    TEST_ASSERT_EQUAL_UINT32(((12 * 60 + 35) * 60 + 19) * 1000, fix.utcMillis);
+    TEST_ASSERT_EQUAL_INT32(481173000, fix.latitude);   // 48 deg 7.038 min
+    TEST_ASSERT_EQUAL_INT32(115166667, fix.longitude);  // 11 deg 31 min, rounded to 1e-7 deg
+    TEST_ASSERT_EQUAL_INT32(545400, fix.altitude);
+    TEST_ASSERT_EQUAL_UINT16(90, fix.hdop);
+    TEST_ASSERT_EQUAL_UINT8(1, fix.fixQuality);
+    TEST_ASSERT_EQUAL_UINT8(8, fix.satellites);
+    TEST_ASSERT_TRUE(fix.valid);
+    TEST_ASSERT_EQUAL_UINT32(1, parser.getSentenceCount());
+}
+
+static void test_rmc_fields() {
+    TEST_ASSERT_EQUAL(1, feed(RMC));
+    const GpsFix &fix = parser.getFix();
+    TEST_ASSERT_EQUAL_UINT32(((12 * 60 + 35) * 60 + 20) * 1000, fix.utcMillis);
+    TEST_ASSERT_EQUAL_INT32(-481173000, fix.latitude);
+    TEST_ASSERT_EQUAL_INT32(-115166667, fix.longitude);
+    TEST_ASSERT_EQUAL_UINT32(11524, fix.speed);         // 22.4 kn
+    TEST_ASSERT_EQUAL_UINT16(8440, fix.course);
+    TEST_ASSERT_EQUAL_UINT32(230394, fix.date);
+    TEST_ASSERT_TRUE(fix.valid);
+}
+
+static void test_vtg_fields() {
+    TEST_ASSERT_EQUAL(1, feed(VTG));
+    TEST_ASSERT_EQUAL_UINT16(5470, parser.getFix().course);
+    TEST_ASSERT_EQUAL_UINT32(2833, parser.getFix().speed); // 10.2 km/h
+
+    // Without the km/h field the speed comes from knots
+    TEST_ASSERT_EQUAL(1, feed(VTG_KNOTS_ONLY));
+    TEST_ASSERT_EQUAL_UINT32(2829, parser.getFix().speed); // 5.5 kn
+}
+
+static void test_unsupported_sentence_passes_checksum_only() {
+    TEST_ASSERT_EQUAL(0, feed(GSA));
+    TEST_ASSERT_EQUAL_UINT32(1, parser.getSentenceCount());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getChecksumErrors());
+    TEST_ASSERT_FALSE(parser.getFix().valid);
+}
+
+static void test_truncated_sentence_does_not_update() {
+    // Too few fields for the sentence type: counted, but not reported as a fix update
+    TEST_ASSERT_EQUAL(0, feedBody("GPGGA,123519.00,4807.038,N"));
+    TEST_ASSERT_EQUAL(0, feedBody("GNRMC,123520.00,A,4807.038,S"));
+    TEST_ASSERT_EQUAL(0, feedBody("GPVTG,054.7,T,034.4"));
+    TEST_ASSERT_EQUAL_UINT32(3, parser.getSentenceCount());
+    TEST_ASSERT_EQUAL_INT32(0, parser.getFix().latitude);
+    TEST_ASSERT_FALSE(parser.getFix().valid);
+}
+
+static void test_long_digit_run_rejected() {
+    // A 20-digit altitude would overflow the scaled value; the field is dropped and the rest decoded
+    TEST_ASSERT_EQUAL(1, feedBody("GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,12345678901234567890,M,46.9,M,,"));
+    TEST_ASSERT_EQUAL_INT32(0, parser.getFix().altitude);
+    TEST_ASSERT_EQUAL_INT32(481173000, parser.getFix().latitude);
+
+    // Long degree and speed fields are rejected rather than wrapped
+    TEST_ASSERT_EQUAL(1, feedBody("GPVTG,054.7,T,034.4,M,99999999999999999999,N,,K"));
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getFix().speed);
+    TEST_ASSERT_EQUAL(1, feedBody("GPGGA,123519.00,123454807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,"));
+    TEST_ASSERT_EQUAL_INT32(481173000, parser.getFix().latitude);
+}
+
+static void test_checksum_rejection() {
+    char corrupted[96];
+
+    // Wrong checksum digits
+    strcpy(corrupted, GGA);
+    strchr(corrupted, '*')[2] = 'A';
+    TEST_ASSERT_EQUAL(0, feed(corrupted));
+
+    // One flipped body character
+    strcpy(corrupted, GGA);
+    corrupted[20] = '9';
+    TEST_ASSERT_EQUAL(0, feed(corrupted));
+
+    // Missing checksum, and a checksum that is not hexadecimal
+    TEST_ASSERT_EQUAL(0, feed("$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K\r\n"));
+    TEST_ASSERT_EQUAL(0, feed("$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*4G\r\n"));
+
+    TEST_ASSERT_EQUAL_UINT32(4, parser.getChecksumErrors());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getSentenceCount());
+    TEST_ASSERT_EQUAL_INT32(0, parser.getFix().latitude);
+    TEST_ASSERT_FALSE(parser.getFix().valid);
+}
+
+static void test_line_buffer_overflow() {
+    // A body one character longer than the buffer is dropped, and the parser resynchronizes on the next '$'
+    char line[NMEAParser::MAX_SENTENCE + 8] = "$GPTXT,";
+    size_t length = strlen(line);
+    while (length < NMEAParser::MAX_SENTENCE + 2) {
+        line[length++] = 'X';
+    }
+    line[length] = '\0';
+    TEST_ASSERT_EQUAL(0, feed(line));
+    TEST_ASSERT_EQUAL(0, feed("*00\r\n"));
+    TEST_ASSERT_EQUAL_UINT32(1, parser.getOverflowCount());
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getChecksumErrors());
+
+    TEST_ASSERT_EQUAL(1, feed(GGA));
+    TEST_ASSERT_EQUAL_INT32(481173000, parser.getFix().latitude);
+}
+
+static void test_start_resynchronizes() {
+    // Line noise and a sentence cut short by a new '$' do not hide the following sentence
+    TEST_ASSERT_EQUAL(0, feed("\x7f\x13garbage,*12"));
+    TEST_ASSERT_EQUAL(0, feed("$GPGGA,1235"));
+    TEST_ASSERT_EQUAL(1, feed(GGA));
+    TEST_ASSERT_EQUAL_UINT32(0, parser.getChecksumErrors());
+    TEST_ASSERT_EQUAL_UINT32(1, parser.getSentenceCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_gga_fields);
+    RUN_TEST(test_rmc_fields);
+    RUN_TEST(test_vtg_fields);
+    RUN_TEST(test_unsupported_sentence_passes_checksum_only);
+    RUN_TEST(test_truncated_sentence_does_not_update);
+    RUN_TEST(test_long_digit_run_rejected);
+    RUN_TEST(test_checksum_rejection);
+    RUN_TEST(test_line_buffer_overflow);
+    RUN_TEST(test_start_resynchronizes);
+    return UNITY_END();
+}
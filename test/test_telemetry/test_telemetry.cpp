@@ -0,0 +1,323 @@
+/** @file test_telemetry.cpp
+ *  @brief Native round-trip tests of the telemetry state frame and of TelemetryBatcher and decodeTelemetryBatch().
+ *
+ *  Run with: pio test -e native -f test_telemetry
+ */
+
+#include <string.h>
+#include <unity.h>
+
+#include "Crc16.h"
+#include "Telemetry.h"
+
+// Offsets into a frame, from Telemetry.h
+static const size_t VERSION_OFFSET = 1;
+static const size_t LENGTH_OFFSET = 3;
+static const size_t BATCH_ENCODING_OFFSET = TELEMETRY_HEADER_SIZE;
+static const size_t BATCH_COUNT_OFFSET = TELEMETRY_HEADER_SIZE + 1;
+
+/** @brief Rewrites the CRC of a frame after a test changed its header or payload. */
+static void resealFrame(uint8_t *frame, size_t length) {
+    uint16_t crc = crc16(frame, length - TELEMETRY_TRAILER_SIZE);
+    frame[length - 2] = (uint8_t)crc;
+    frame[length - 1] = (uint8_t)(crc >> 8);
+}
+
+/** @brief A state with every field set, each a whole number of its wire unit. */
+static BotState sampleState() {
+    BotState state = {};
+    state.timestamp = 123456000;
+    state.state = 3;
+    state.tilt_angle = -1234 * 0.01f;
+    state.pitchRate = 4567 * 0.1f;
+    state.position = -1234567 * 0.001f;
+    state.velocity = 890 * 0.001f;
+    state.x = 2000001 * 0.001f;
+    state.y = -3000002 * 0.001f;
+    state.heading = -31415 * 0.0001f;
+    state.yawRate = 1500 * 0.001f;
+    state.leftVelocity = -250 * 0.001f;
+    state.rightVelocity = 251 * 0.001f;
+    state.leftSetpoint = -300 * 0.001f;
+    state.rightSetpoint = 301 * 0.001f;
+    state.obstacleDetected = true;
+    state.obstacleDistance = 412;
+    state.gpsValid = true;
+    state.latitude = -481173000;
+    state.longitude = 115166667;
+    return state;
+}
+
+static void assertSameState(const BotState &expected, const BotState &actual) {
+    TEST_ASSERT_EQUAL_INT64(expected.timestamp, actual.timestamp);
+    TEST_ASSERT_EQUAL_UINT8(expected.state, actual.state);
+    TEST_ASSERT_EQUAL_FLOAT(expected.tilt_angle, actual.tilt_angle);
+    TEST_ASSERT_EQUAL_FLOAT(expected.pitchRate, actual.pitchRate);
+    TEST_ASSERT_EQUAL_FLOAT(expected.position, actual.position);
+    TEST_ASSERT_EQUAL_FLOAT(expected.velocity, actual.velocity);
+    TEST_ASSERT_EQUAL_FLOAT(expected.x, actual.x);
+    TEST_ASSERT_EQUAL_FLOAT(expected.y, actual.y);
+    TEST_ASSERT_EQUAL_FLOAT(expected.heading, actual.heading);
+    TEST_ASSERT_EQUAL_FLOAT(expected.yawRate, actual.yawRate);
+    TEST_ASSERT_EQUAL_FLOAT(expected.leftVelocity, actual.leftVelocity);
+    TEST_ASSERT_EQUAL_FLOAT(expected.rightVelocity, actual.rightVelocity);
+    TEST_ASSERT_EQUAL_FLOAT(expected.leftSetpoint, actual.leftSetpoint);
+    TEST_ASSERT_EQUAL_FLOAT(expected.rightSetpoint, actual.rightSetpoint);
+    TEST_ASSERT_EQUAL(expected.obstacleDetected, actual.obstacleDetected);
+    TEST_ASSERT_EQUAL_UINT16(expected.obstacleDistance, actual.obstacleDistance);
+    TEST_ASSERT_EQUAL(expected.gpsValid, actual.gpsValid);
+    TEST_ASSERT_EQUAL_INT32(expected.latitude, actual.latitude);
+    TEST_ASSERT_EQUAL_INT32(expected.longitude, actual.longitude);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_state_round_trip() {
+    BotState state = sampleState();
+    uint8_t frame[TELEMETRY_STATE_FRAME_SIZE];
+    TEST_ASSERT_EQUAL_size_t(TELEMETRY_STATE_FRAME_SIZE, encodeTelemetry(state, frame, sizeof(frame)));
+
+    BotState decoded;
+    memset(&decoded, 0xA5, sizeof(decoded));
+    TEST_ASSERT_TRUE(decodeTelemetry(frame, sizeof(frame), decoded));
+    assertSameState(state, decoded);
+
+    // What was decoded encodes to the same bytes
+    uint8_t again[TELEMETRY_STATE_FRAME_SIZE];
+    TEST_ASSERT_EQUAL_size_t(sizeof(again), encodeTelemetry(decoded, again, sizeof(again)));
+    TEST_ASSERT_EQUAL_MEMORY(frame, again, sizeof(frame));
+}
+
+static void test_state_resolution_and_saturation() {
+    BotState state = sampleState();
+    state.timestamp = 123456789;  // Sent in whole ms
+    state.tilt_angle = 400.0f;    // Beyond the i16 range of 0.01 deg
+    state.velocity = -50.0f;      // Beyond the i16 range of mm/s
+    uint8_t frame[TELEMETRY_STATE_FRAME_SIZE];
+    encodeTelemetry(state, frame, sizeof(frame));
+
+    BotState decoded;
+    TEST_ASSERT_TRUE(decodeTelemetry(frame, sizeof(frame), decoded));
+    TEST_ASSERT_EQUAL_INT64(123456000, decoded.timestamp);
+    TEST_ASSERT_EQUAL_FLOAT(32767 * 0.01f, decoded.tilt_angle);
+    TEST_ASSERT_EQUAL_FLOAT(-32768 * 0.001f, decoded.velocity);
+}
+
+static void test_state_rejects_damage() {
+    uint8_t frame[TELEMETRY_STATE_FRAME_SIZE];
+    encodeTelemetry(sampleState(), frame, sizeof(frame));
+    BotState decoded;
+
+    // Every single bit flip, in the CRC bytes as well, is caught
+    for (size_t byte = 0; byte < sizeof(frame); byte++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            frame[byte] ^= (uint8_t)(1 << bit);
+            TEST_ASSERT_FALSE(decodeTelemetry(frame, sizeof(frame), decoded));
+            frame[byte] ^= (uint8_t)(1 << bit);
+        }
+    }
+
+    // A truncated frame, and a buffer too small to encode into
+    TEST_ASSERT_FALSE(decodeTelemetry(frame, sizeof(frame) - 1, decoded));
+    TEST_ASSERT_EQUAL_size_t(0, encodeTelemetry(sampleState(), frame, sizeof(frame) - 1));
+}
+
+static void test_state_rejects_other_versions() {
+    uint8_t frame[TELEMETRY_STATE_FRAME_SIZE];
+    encodeTelemetry(sampleState(), frame, sizeof(frame));
+    BotState decoded;
+
+    // The CRC is correct, so only the version rejects it
+    frame[VERSION_OFFSET] = TELEMETRY_VERSION + 1;
+    resealFrame(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(decodeTelemetry(frame, sizeof(frame), decoded));
+    frame[VERSION_OFFSET] = TELEMETRY_VERSION - 1;
+    resealFrame(frame, sizeof(frame));
+    TEST_ASSERT_FALSE(decodeTelemetry(frame, sizeof(frame), decoded));
+}
+
+static void test_state_skips_appended_fields() {
+    // A newer sender may append fields to the payload without a new version
+    uint8_t frame[TELEMETRY_STATE_FRAME_SIZE + 4];
+    encodeTelemetry(sampleState(), frame, sizeof(frame));
+    memset(frame + TELEMETRY_STATE_FRAME_SIZE - TELEMETRY_TRAILER_SIZE, 0x5A, 4);
+    frame[LENGTH_OFFSET] = (uint8_t)(TELEMETRY_STATE_PAYLOAD_SIZE + 4);
+    resealFrame(frame, sizeof(frame));
+
+    BotState decoded;
+    TEST_ASSERT_TRUE(decodeTelemetry(frame, sizeof(frame), decoded));
+    assertSameState(sampleState(), decoded);
+}
+
+/** @brief A control sample whose fields are whole numbers of their wire units, varied by @p n. */
+static ControlSample batchSample(int n) {
+    ControlSample sample = {};
+    sample.timestamp = 5000000000LL + n * 2000 + (n % 3) * 7; // Beyond 32 bits, with uneven intervals
+    sample.state = (uint8_t)(n % 7);
+    sample.pitch = (n % 2 ? -1 : 1) * (100 + 37 * n) * 0.01f;
+    sample.pitchRate = (n % 3 - 1) * (900 + n) * 0.1f;
+    sample.position = (5000 - 400 * n) * 0.001f;           // Falls through zero
+    sample.velocity = (n % 2 ? 1 : -1) * (300 + n) * 0.001f;
+    sample.leftSetpoint = (200 - 90 * n) * 0.001f;
+    sample.rightSetpoint = (-200 + 60 * n) * 0.001f;
+    return sample;
+}
+
+/** @brief A control sample at the ends of every field's range, so delta samples take the most bytes. */
+static ControlSample extremeSample(int n) {
+    ControlSample sample = {};
+    int sign = n % 2 ? -1 : 1;
+    sample.timestamp = n * (int64_t)INT32_MAX;
+    sample.state = n % 2 ? 255 : 0;
+    sample.pitch = sign * 32767 * 0.01f;
+    sample.pitchRate = sign * 32767 * 0.1f;
+    sample.position = sign * 1000000 * 0.001f;
+    sample.velocity = sign * 32767 * 0.001f;
+    sample.leftSetpoint = sign * 32767 * 0.001f;
+    sample.rightSetpoint = -sign * 32767 * 0.001f;
+    return sample;
+}
+
+static void assertSameSample(const ControlSample &expected, const ControlSample &actual) {
+    TEST_ASSERT_EQUAL_INT64(expected.timestamp, actual.timestamp);
+    TEST_ASSERT_EQUAL_UINT8(expected.state, actual.state);
+    TEST_ASSERT_EQUAL_FLOAT(expected.pitch, actual.pitch);
+    TEST_ASSERT_EQUAL_FLOAT(expected.pitchRate, actual.pitchRate);
+    TEST_ASSERT_EQUAL_FLOAT(expected.position, actual.position);
+    TEST_ASSERT_EQUAL_FLOAT(expected.velocity, actual.velocity);
+    TEST_ASSERT_EQUAL_FLOAT(expected.leftSetpoint, actual.leftSetpoint);
+    TEST_ASSERT_EQUAL_FLOAT(expected.rightSetpoint, actual.rightSetpoint);
+}
+
+static TelemetryBatchParams batchParams(bool deltaEncoding, uint16_t maxSamples) {
+    TelemetryBatchParams params = TelemetryBatchParams::defaults();
+    params.deltaEncoding = deltaEncoding;
+    params.maxSamples = maxSamples;
+    return params;
+}
+
+/** @brief Batches samples until the batcher is full and checks that they decode unchanged. */
+static void assertBatchRoundTrip(TelemetryBatcher &batcher, ControlSample (*makeSample)(int), int samples) {
+    static const size_t CAPACITY = 64;
+    ControlSample sent[CAPACITY];
+    int added = 0;
+    while (added < samples && added < (int)CAPACITY && !batcher.isFull()) {
+        sent[added] = makeSample(added);
+        batcher.add(sent[added]);
+        added++;
+    }
+    size_t length = batcher.finish(1234);
+    TEST_ASSERT_GREATER_THAN(0, length);
+    TEST_ASSERT_LESS_OR_EQUAL(TELEMETRY_BATCH_FRAME_CAPACITY, length);
+
+    ControlSample received[CAPACITY];
+    size_t count = 0;
+    uint32_t dropped = 0;
+    TEST_ASSERT_TRUE(decodeTelemetryBatch(batcher.getFrame(), length, received, CAPACITY, count, dropped));
+    TEST_ASSERT_EQUAL_size_t(added, count);
+    TEST_ASSERT_EQUAL_UINT32(1234, dropped);
+    for (int i = 0; i < added; i++) {
+        assertSameSample(sent[i], received[i]);
+    }
+}
+
+static void test_raw_batch_round_trip() {
+    TelemetryBatcher batcher(batchParams(false, 20));
+    assertBatchRoundTrip(batcher, batchSample, 20);
+    TEST_ASSERT_EQUAL_UINT16(20, batcher.getCount());
+    TEST_ASSERT_TRUE(batcher.isFull());
+}
+
+static void test_delta_batch_round_trip() {
+    // Every field both rises and falls between samples, so the deltas take both signs
+    TelemetryBatcher batcher(batchParams(true, 20));
+    assertBatchRoundTrip(batcher, batchSample, 20);
+    TEST_ASSERT_EQUAL_UINT16(20, batcher.getCount());
+
+    // Swings from one end of each range to the other
+    batcher.clear();
+    assertBatchRoundTrip(batcher, extremeSample, 4);
+    TEST_ASSERT_EQUAL_UINT16(4, batcher.getCount());
+}
+
+static void test_batches_stop_at_the_frame_capacity() {
+    // With no sample limit the frame fills up first, in either encoding
+    TelemetryBatcher raw(batchParams(false, 1000));
+    assertBatchRoundTrip(raw, batchSample, 1000);
+    TEST_ASSERT_TRUE(raw.isFull());
+    TEST_ASSERT_LESS_OR_EQUAL(53, raw.getCount()); // 19 bytes a sample
+
+    TelemetryBatcher delta(batchParams(true, 1000));
+    assertBatchRoundTrip(delta, extremeSample, 1000);
+    TEST_ASSERT_TRUE(delta.isFull());
+    TEST_ASSERT_GREATER_THAN(30, delta.getCount());
+}
+
+static void test_batch_timing() {
+    TelemetryBatcher batcher(batchParams(true, 50));
+    TEST_ASSERT_FALSE(batcher.isDue(0));
+    TEST_ASSERT_EQUAL_size_t(0, batcher.finish(0));
+
+    ControlSample sample = batchSample(0);
+    batcher.add(sample);
+    TEST_ASSERT_FALSE(batcher.isDue(sample.timestamp + 99999));
+    TEST_ASSERT_TRUE(batcher.isDue(sample.timestamp + 100000));
+}
+
+static void test_batch_rejects_damage() {
+    TelemetryBatcher batcher(batchParams(true, 10));
+    for (int i = 0; i < 10; i++) {
+        batcher.add(batchSample(i));
+    }
+    size_t length = batcher.finish(0);
+    uint8_t frame[TELEMETRY_BATCH_FRAME_CAPACITY];
+    memcpy(frame, batcher.getFrame(), length);
+    ControlSample samples[10];
+    size_t count;
+    uint32_t dropped;
+
+    for (size_t byte = 0; byte < length; byte++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            frame[byte] ^= (uint8_t)(1 << bit);
+            TEST_ASSERT_FALSE(decodeTelemetryBatch(frame, length, samples, 10, count, dropped));
+            frame[byte] ^= (uint8_t)(1 << bit);
+        }
+    }
+    TEST_ASSERT_FALSE(decodeTelemetryBatch(frame, length - 1, samples, 10, count, dropped));
+
+    // Too many samples for the caller's buffer
+    TEST_ASSERT_FALSE(decodeTelemetryBatch(frame, length, samples, 9, count, dropped));
+
+    // Intact CRC, but an unknown encoding, a sample count beyond the payload, or another version
+    frame[BATCH_ENCODING_OFFSET] = 2;
+    resealFrame(frame, length);
+    TEST_ASSERT_FALSE(decodeTelemetryBatch(frame, length, samples, 10, count, dropped));
+    memcpy(frame, batcher.getFrame(), length);
+    frame[BATCH_COUNT_OFFSET] = 11;
+    resealFrame(frame, length);
+    TEST_ASSERT_FALSE(decodeTelemetryBatch(frame, length, samples, 20, count, dropped));
+    memcpy(frame, batcher.getFrame(), length);
+    frame[VERSION_OFFSET] = TELEMETRY_VERSION + 1;
+    resealFrame(frame, length);
+    TEST_ASSERT_FALSE(decodeTelemetryBatch(frame, length, samples, 10, count, dropped));
+
+    // The untouched frame still decodes
+    TEST_ASSERT_TRUE(decodeTelemetryBatch(batcher.getFrame(), length, samples, 10, count, dropped));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_state_round_trip);
+    RUN_TEST(test_state_resolution_and_saturation);
+    RUN_TEST(test_state_rejects_damage);
+    RUN_TEST(test_state_rejects_other_versions);
+    RUN_TEST(test_state_skips_appended_fields);
+    RUN_TEST(test_raw_batch_round_trip);
+    RUN_TEST(test_delta_batch_round_trip);
+    RUN_TEST(test_batches_stop_at_the_frame_capacity);
+    RUN_TEST(test_batch_timing);
+    RUN_TEST(test_batch_rejects_damage);
+    return UNITY_END();
+}